@@ -34,34 +34,17 @@
  * Variable globales
  */
 
-/* Indica si se ha empezado una partida */
-int HasGameInit = 0;
-/* Tamao mitad de un tile del escenario actual, utilizado frecuentemente */
-int AuxMidSize = 0;
-/* Estrellas que quedan por comer */
-Uint32 StarsCount = 0;
-/* Vidas que quedan */
-Uint8 * LifesCount;
-/* Puntuacin total */
-Uint32 * Score;
-/* Tiempo restante */
-Sint32 GameTime = 0;
-/* Cadenas que guardan la informacin anterior en modo texto */
-char InfoText[4][32];
 /* Grficos del comecocos */
 creMGf * MGfCoco = NULL;
 /* Grficos de las estrellas */
 creMGf * MGfStar = NULL;
 /* Grficos de los fantasmas */
 creMGf * MGfGhost = NULL;
-/* Escenario actual */
-creMSc * MScScen = NULL;
 /* Fuente de texto  grande*/
 TTF_Font * TTFCoco = NULL;
 /* Fuente de texto pequea */
 TTF_Font * TTFCocoSmall = NULL;
-/* Puntero a la nica instancia que puede haber del comecocos */
-creProcess * CurrentCoco = NULL;
+/* El estado de la partida es de cada mundo de procesos (COCO_GetState) */
 
 
 /*
@@ -82,27 +65,28 @@ creProcess PDownBar = {0, TYPE_PDBAR, CRE_PS_CLASS, "Barra de info", NULL,
 /* Constructor */
 creProcess * PDownBar_New()
 {
+    GameState * Game = COCO_GetState();
     creProcess * This;
 
     /* Creamos la instancia del proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PDownBar;
+    This = CRE_AllocProcess(&PDownBar, 0);
     This->State = CRE_PS_DEFAULT;
     /* Le asignamos el grfico y su posicin */
-    This->Graph = MGfMisc->Gfx[IND_DBAR];
-    This->Y = 600 - MGfMisc->Gfx[1]->h / 2;
+    This->Graph = COCO_GFX(MGfMisc, IND_DBAR);
+    if(This->Graph != NULL)
+        This->Y = 600 - This->Graph->h / 2;
     /* Aadimos la instancia a la lista de procesos */
     CRE_AddProcess(This);
 
     /* Creamos los textos de informacin */
-    PText.New("Vidas",     360, 555, TTFCocoSmall, TEXT_CONST);
-    PText.New(InfoText[0], 400, 575, TTFCoco,      TEXT_VAR);
-    PText.New("Puntos",    750, 545, TTFCocoSmall, TEXT_CONST);
-    PText.New(InfoText[1], 720, 575, TTFCoco,      TEXT_VAR);
-    PText.New("Estrellas",  50, 540, TTFCocoSmall, TEXT_CONST);
-    PText.New(InfoText[2],  50, 570, TTFCoco,      TEXT_VAR);
-    PText.New("Tiempo",    160, 545, TTFCocoSmall, TEXT_CONST);
-    PText.New(InfoText[3], 160, 575, TTFCoco,      TEXT_VAR);
+    PText.New("Vidas",           360, 555, TTFCocoSmall, TEXT_CONST);
+    PText.New(Game->InfoText[0], 400, 575, TTFCoco,      TEXT_VAR);
+    PText.New("Puntos",          750, 545, TTFCocoSmall, TEXT_CONST);
+    PText.New(Game->InfoText[1], 720, 575, TTFCoco,      TEXT_VAR);
+    PText.New("Estrellas",        50, 540, TTFCocoSmall, TEXT_CONST);
+    PText.New(Game->InfoText[2],  50, 570, TTFCoco,      TEXT_VAR);
+    PText.New("Tiempo",          160, 545, TTFCocoSmall, TEXT_CONST);
+    PText.New(Game->InfoText[3], 160, 575, TTFCoco,      TEXT_VAR);
 
     return This;
 }
@@ -110,17 +94,19 @@ creProcess * PDownBar_New()
 /* Bucle */
 void PDownBar_Loop(creProcess * This)
 {
+    GameState * Game = COCO_GetState();
+
     /* Actualizamos los textos en pantalla */
-    sprintf(InfoText[0], "%d", *LifesCount);
-    sprintf(InfoText[1], "%d", *Score);
-    sprintf(InfoText[2], "%d", StarsCount);
-    sprintf(InfoText[3], "%d", GameTime);
+    sprintf(Game->InfoText[0], "%d", *Game->LifesCount);
+    sprintf(Game->InfoText[1], "%d", *Game->Score);
+    sprintf(Game->InfoText[2], "%d", Game->StarsCount);
+    sprintf(Game->InfoText[3], "%d", Game->GameTime);
 }
 
 /* Destructor */
 void PDownBar_Free(creProcess * This)
 {
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -136,28 +122,29 @@ creProcess PCoco = {0, TYPE_PCOCO, CRE_PS_CLASS, "Comecocos", NULL, PCoco_New,
 /* Constructor */
 creProcess * PCoco_New()
 {
+    GameState * Game = COCO_GetState();
+    crePoint * Start = &Game->MScScen->KeyPoints[IND_KP_START];
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = (creProcess) PCoco;
+    This = CRE_AllocProcess(&PCoco, sizeof(PCocoData));
     This->State = CRE_PS_DEFAULT;
 
     /* Cargamos el grfico por defecto */
-    This->Graph = MGfCoco->Gfx[IND_COCO_FRONT];
+    This->Graph = COCO_GFX(MGfCoco, IND_COCO_FRONT);
 
     /* Calculamos la posicin inicial */
-    This->X = MScScen->KeyPoints[IND_KP_START].X * MScScen->Size + AuxMidSize;
-    This->Y = MScScen->KeyPoints[IND_KP_START].Y * MScScen->Size + AuxMidSize;
+    This->X = Start->X * Game->MScScen->Size + Game->AuxMidSize;
+    This->Y = Start->Y * Game->MScScen->Size + Game->AuxMidSize;
 
-    /* Asignamos memoria para los datos y los inicializamos */
-    This->Data = malloc(sizeof(PCocoData));
-    *((PCocoData *)This->Data) = (PCocoData){MScScen->KeyPoints[IND_KP_START].X,
-        MScScen->KeyPoints[IND_KP_START].Y, 0, IN_SUGAR, IND_COCO_FRONT,
-        SDL_GetTicks(), TO_FRONT, 1, 0};
+    /* Inicializamos los datos */
+    *((PCocoData *)This->Data) = (PCocoData){Start->X, Start->Y, 0, IN_SUGAR,
+        IND_COCO_FRONT, CRE_GetTicks(), TO_FRONT, 1, 0};
 
-    /* Aadimos el proceso */
+    /* Aadimos el proceso y lo registramos en su casilla */
     CRE_AddProcess(This);
+    ((PCocoData *)This->Data)->Cell = CRE_GridAdd(Game->Grid, This, Start->X,
+      Start->Y, NULL);
 
     return This;
 }
@@ -165,7 +152,9 @@ creProcess * PCoco_New()
 /* Bucle */
 void PCoco_Loop(creProcess * This)
 {
+    GameState * Game = COCO_GetState();
     PCocoData * Info = (PCocoData *) This->Data;
+    Uint8 Moves;
 
     /* Gestionamos los eventos de teclado */
     for(creEList.CurrentEvent = 0; creEList.CurrentEvent < creEList.Size;
@@ -193,13 +182,13 @@ void PCoco_Loop(creProcess * This)
      * Si no hay ninguna animacin en marcha, y el usuario nos ha indicado que
      * que nos deplazemos, lo hacemos, siempre que sea posible
      */
-    if(Info->Enable)
+    if(Info->Enable) {
+        Moves = CRE_NavMoves(Game->Nav, NAV_COCO, Info->X, Info->Y);
         switch(Info->NextDir) {
             /* Desplazamiento a la izquierda */
             case TO_LEFT:
                 /* Comprobamos si es posible el desplazamiento */
-                if(MScScen->Map[MAX(0,(Info->X - 1)) + Info->Y *
-                  MScScen->W] == 0) {
+                if(Moves & TO_LEFT) {
                     /* Si lo es, preparamos la animacin */
                     Info->Enable = Info->Loop = 0;
                     Info->Frame = IND_COCO_LEFT;
@@ -217,8 +206,7 @@ void PCoco_Loop(creProcess * This)
 
             /* Desplazamiento a la derecha */
             case TO_RIGHT:
-                if(MScScen->Map[MIN(MScScen->W + 1, Info->X + 1) + Info->Y *
-                  MScScen->W] == 0) {
+                if(Moves & TO_RIGHT) {
                     Info->Enable = Info->Loop = 0;
                     Info->Frame = IND_COCO_RIGHT;
                     Info->Dir = TO_RIGHT;
@@ -231,8 +219,7 @@ void PCoco_Loop(creProcess * This)
 
             /* Desplazamiento hacia arriba */
             case TO_UP:
-                if(MScScen->Map[Info->X + (MAX(0, (Info->Y - 1)) *
-                  MScScen->W)] == 0) {
+                if(Moves & TO_UP) {
                     Info->Enable = Info->Loop = 0;
                     Info->Frame = IND_COCO_UP;
                     Info->Dir = TO_UP;
@@ -245,8 +232,7 @@ void PCoco_Loop(creProcess * This)
 
             /* Desplazamiento hacia abajo */
             case TO_DOWN:
-                if(MScScen->Map[Info->X + (MIN((MScScen->H - 1), (Info->Y + 1))
-                  * MScScen->W)] == 0) {
+                if(Moves & TO_DOWN) {
                     Info->Enable = Info->Loop = 0;
                     Info->Frame = IND_COCO_DOWN;
                     Info->Dir = TO_DOWN;
@@ -257,6 +243,7 @@ void PCoco_Loop(creProcess * This)
                 }
                 break;
         }
+    }
 
     /* Gestionamos las animaciones */
     switch(Info->Dir) {
@@ -382,100 +369,44 @@ void PCoco_Loop(creProcess * This)
      * un parpadeo temporal.
      */
     if(Info->State == IN_SUGAR) {
-        if((SDL_GetTicks() - Info->SugarTime) >= 2000)
+        /* Al acabar, los fantasmas de nuestra casilla ya pueden tocarnos */
+        if((CRE_GetTicks() - Info->SugarTime) >= 2000) {
             Info->State = IN_NONE;
+            CRE_GridTouch(Game->Grid, Info->Cell);
+        }
 
         if(Info->Frame % 2)
             This->Graph = NULL;
         else
-            This->Graph = MGfCoco->Gfx[Info->Frame];
+            This->Graph = COCO_GFX(MGfCoco, Info->Frame);
     /* Si no esta en este estado mostramos su grfico normalmente */
     } else
-        This->Graph = MGfCoco->Gfx[Info->Frame];
-}
-
-/* Destructor */
-void PCoco_Free(creProcess * This)
-{
-    /* Liberamos memoria */
-    if (This->Data != NULL)
-      free(This->Data);
+        This->Graph = COCO_GFX(MGfCoco, Info->Frame);
 
-    free(This);
-}
+    /* Actualizamos nuestra casilla, avisando a los que haya en ella */
+    CRE_GridMove(Game->Grid, Info->Cell, Info->X, Info->Y);
 
+    /* Los fantasmas se guan por la distancia a nuestra casilla */
+    CRE_NavSetTarget(Game->CocoField, Info->X, Info->Y);
 
-/*
- * PStar
- * Proceso que representa una estrella (comida del comecocos)
- */
-
-/* Defincin de clase */
-creProcess PStar = {0, TYPE_PSTAR, CRE_PS_CLASS, "Estrella", NULL, PStar_New,
-    PStar_Loop, PStar_Free, NULL, 0, 0, Z_STAR, 255, 0, 100, 100, NULL};
-
-/* Constructor */
-creProcess * PStar_New(Sint32 X, Sint32 Y)
-{
-    creProcess * This;
-
-    /* Creamos la instancia del proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PStar;
-    This->State = CRE_PS_DEFAULT;
-
-    /* Le asignamos su grficco */
-    This->Graph = MGfStar->Gfx[IND_STAR];
-
-    /* Calculamos su posicin en pantalla */
-    This->X = X * MScScen->Size + AuxMidSize;
-    This->Y = Y * MScScen->Size + AuxMidSize;
-
-    /* Creamos e inicializamos los datos de la instancia */
-    This->Data = malloc(sizeof(PStarData));
-    *((PStarData *)This->Data) = (PStarData) {X, Y,
-      IND_STAR + random() % IND_STAR_SIZE};
-
-    /* Aadimos la instancia a la lista */
-    CRE_AddProcess(This);
-
-    /* Indicamos que se ha creado un estrella */
-    StarsCount++;
-
-    return This;
-}
-
-/* Bucle */
-void PStar_Loop(creProcess * This)
-{
-    PStarData * Info = (PStarData *) This->Data;
-    PCocoData * CInfo = (PCocoData *) CurrentCoco->Data;
-
-    /* En el caso de que el comecocos este sobre la estrella actual */
-    if(Info->X == CInfo->X && Info->Y == CInfo->Y) {
-        /* Eliminamos la estrella */
-        This->State = CRE_PS_DEAD;
+    /* Si hay una estrella en la casilla en la que estamos, nos la comemos */
+    if(COCO_TakePickup(Info->X, Info->Y) == ITEM_STAR) {
         /* Aadimos puntos a la puntuacin del jugador */
-        *Score += GameTime;
+        *Game->Score += Game->GameTime;
         /* Indicamos que ha desaparecido una estrella */
-        StarsCount--;
+        Game->StarsCount--;
     }
-
-    /* Actualizamos el estado de la animacin */
-    Info->Frame = (++Info->Frame) % IND_STAR_SIZE;
-    This->Graph = MGfStar->Gfx[Info->Frame];
-
 }
 
 /* Destructor */
-void PStar_Free(creProcess * This)
+void PCoco_Free(creProcess * This)
 {
-    /* Liberamos memoria */
-  if (This->Data != NULL)
-    free(This->Data);
-  free(This);
-}
+    GameState * Game = COCO_GetState();
 
+    /* Lo quitamos de la rejilla y liberamos memoria */
+    CRE_GridRemove(Game->Grid, ((PCocoData *)This->Data)->Cell);
+    CRE_FreeProcess(This);
+}
 
 
 /*
@@ -491,29 +422,35 @@ creProcess PGhost = {0, TYPE_PGHOST, CRE_PS_CLASS, "Fantasma", NULL, PGhost_New,
 /* Constructor */
 creProcess * PGhost_New(Sint32 X, Sint32 Y)
 {
+    GameState * Game = COCO_GetState();
     creProcess * This;
+    Sint32 Graph;
 
     /* Creamos la instancia */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PGhost;
+    This = CRE_AllocProcess(&PGhost, sizeof(PGhostData));
     This->State = CRE_PS_DEFAULT;
 
-    /* Le asignamos un grfico aleatoriamente */
-    This->Graph = MGfGhost->Gfx[IND_GHOST + (random() % IND_GHOST_SIZE)];
+    /*
+     * Le asignamos un grfico aleatoriamente. El nmero se saca aunque no haya
+     * pantalla, para que la partida siga la misma secuencia aleatoria.
+     */
+    Graph = IND_GHOST + (CRE_Random() % IND_GHOST_SIZE);
+    This->Graph = COCO_GFX(MGfGhost, Graph);
 
     /* Calculamos su posicin */
-    This->X = X * MScScen->Size + AuxMidSize;
-    This->Y = Y * MScScen->Size + AuxMidSize;
+    This->X = X * Game->MScScen->Size + Game->AuxMidSize;
+    This->Y = Y * Game->MScScen->Size + Game->AuxMidSize;
 
     /* Le asignamos un nivel de transparencia aleatorio */
-    This->Alpha = A_GHOSTN + random() % (A_GHOSTN - A_GHOSTN_MAX);
+    This->Alpha = A_GHOSTN + CRE_Random() % (A_GHOSTN - A_GHOSTN_MAX);
 
     /* Incializamos la informacin de la instancia */
-    This->Data = malloc(sizeof(PGhostData));
     *((PGhostData *)This->Data) = (PGhostData) {X, Y, 0, TO_FRONT, 1, 0};
 
-    /* Aadimos el proceso a lista */
+    /* Aadimos el proceso a lista y lo registramos en su casilla */
     CRE_AddProcess(This);
+    ((PGhostData *)This->Data)->Cell = CRE_GridAdd(Game->Grid, This, X, Y,
+      PGhost_Touch);
 
     return This;
 }
@@ -521,62 +458,47 @@ creProcess * PGhost_New(Sint32 X, Sint32 Y)
 /* Bucle */
 void PGhost_Loop(creProcess * This)
 {
-    Uint8 Moves[4] = {0, 0, 0, 0}, MCount = 0, Tmp;
+    GameState * Game = COCO_GetState();
+    Uint8 Moves, Best;
     PGhostData * Info = (PGhostData *) This->Data;
-    PCocoData * CInfo = (PCocoData *) CurrentCoco->Data;
-
-    /* Comprobamos los movimientos disponibles */
-    /* Izquierda */
-    Tmp = MScScen->Map[MAX(0,(Info->X - 1)) + Info->Y * MScScen->W];
-    if(Tmp == 0 || Tmp == 11) Moves[MCount++] = TO_LEFT;
-    /* Derecha */
-    Tmp = MScScen->Map[MIN(MScScen->W + 1, Info->X + 1) + Info->Y * MScScen->W];
-    if(Tmp == 0 || Tmp == 11) Moves[MCount++] = TO_RIGHT;
-    /* Arriba */
-    Tmp = MScScen->Map[Info->X + (MAX(0, (Info->Y - 1)) * MScScen->W)];
-    if(Tmp == 0 || Tmp == 11) Moves[MCount++] = TO_UP;
-    /* Abajo */
-    Tmp = MScScen->Map[Info->X + (MIN((MScScen->H - 1), (Info->Y + 1))
-      * MScScen->W)];
-    if(Tmp == 0 || Tmp == 11) Moves[MCount++] = TO_DOWN;
+    creProcess * Coco = CRE_GetProcess(Game->CurrentCoco);
+    PCocoData * CInfo;
 
+    /* Sin comecocos (fin de la partida) no hay nada que hacer */
+    if(Coco == NULL)
+        return;
+    CInfo = (PCocoData *) Coco->Data;
 
     /* Implementacin de la IA */
     if(Info->Enabled) {
+        /* Movimientos disponibles (los bordes del mapa no se cruzan) */
+        Moves = CRE_NavMoves(Game->Nav, NAV_GHOST, Info->X, Info->Y);
+
+        /*
+         * Parte de las decisiones siguen el campo de distancias al comecocos:
+         * nos acercamos a l o, si est en estado de shock, huimos.
+         */
+        Best = CRE_NAV_NONE;
+        if(Moves != TO_FRONT && CRE_Random() % 100 < GHOST_SMART)
+            Best = Moves & CRE_NavBest(Game->CocoField, Info->X, Info->Y,
+              CInfo->State == IN_SHOCK);
+
+        if(Moves == TO_FRONT)
+            Info->Dir = TO_FRONT;
+        else if(Best != CRE_NAV_NONE)
+            Info->Dir = COCO_RandomDir(Best);
+        /* El resto, seguimos en la misma direccin o paramos un momento */
+        else if(Info->Dir != TO_FRONT && CRE_Random() % 100 >= 90)
+            Info->Dir = TO_FRONT;
+        else if(Info->Dir == TO_FRONT || !(Moves & Info->Dir) ||
+          CRE_Random() % 100 >= 98)
+            Info->Dir = COCO_RandomDir(Moves);
 
-        if(MCount != 0)
-            if(Info->Dir != TO_FRONT)
-                if(random() % 100 < 90)
-                    if(random() % 100 < 98)
-                        goto IA_MOV;
-                    else
-                        goto IA_RANDOM_MOV;
-                else
-                    goto IA_NOMOV;
-            else
-                goto IA_RANDOM_MOV;
-        else
-            goto IA_NOMOV;
-
-        IA_RANDOM_MOV:
-            Info->Dir = Moves[random() % MCount];
+        if(Info->Dir != TO_FRONT) {
             Info->Frame = 0;
             Info->Enabled = 0;
-            goto IA_END;
-
-        IA_MOV:
-            for(Tmp = 0; Tmp < MCount; Tmp++)
-                if(Moves[Tmp] == Info->Dir) {
-                    Info->Frame = 0;
-                    Info->Enabled = 0;
-                    goto IA_END;
-                }
-            goto IA_RANDOM_MOV;
-
-        IA_NOMOV:
-            Info->Dir = TO_FRONT;
+        }
     }
-    IA_END:
 
     /* Animacin de movimiento */
     if(Info->Dir != TO_FRONT) {
@@ -584,7 +506,7 @@ void PGhost_Loop(creProcess * This)
             case TO_LEFT:
                 This->X -= 4;
                 Info->Frame += 4;
-                if(Info->Frame >= MScScen->Size) {
+                if(Info->Frame >= Game->MScScen->Size) {
                     Info->X--;
                     Info->Enabled = 1;
                 }
@@ -592,7 +514,7 @@ void PGhost_Loop(creProcess * This)
             case TO_RIGHT:
                 This->X += 4;
                 Info->Frame += 4;
-                if(Info->Frame >= MScScen->Size) {
+                if(Info->Frame >= Game->MScScen->Size) {
                     Info->X++;
                     Info->Enabled = 1;
                 }
@@ -600,7 +522,7 @@ void PGhost_Loop(creProcess * This)
             case TO_UP:
                 This->Y -= 4;
                 Info->Frame += 4;
-                if(Info->Frame >= MScScen->Size) {
+                if(Info->Frame >= Game->MScScen->Size) {
                     Info->Y--;
                     Info->Enabled = 1;
                 }
@@ -608,7 +530,7 @@ void PGhost_Loop(creProcess * This)
             case TO_DOWN:
                 This->Y += 4;
                 Info->Frame += 4;
-                if(Info->Frame >= MScScen->Size) {
+                if(Info->Frame >= Game->MScScen->Size) {
                     Info->Y++;
                     Info->Enabled = 1;
                 }
@@ -623,49 +545,62 @@ void PGhost_Loop(creProcess * This)
             if(This->Alpha < A_GHOSTN)
                 Info->Alp = ~Info->Alp;
             else
-                This->Alpha -= random() % 5;
+                This->Alpha -= CRE_Random() % 5;
         } else {
             if(This->Alpha > A_GHOSTN_MAX)
                 Info->Alp = ~Info->Alp;
             else
-                This->Alpha += random() % 5;
+                This->Alpha += CRE_Random() % 5;
         }
     } else {
         This->Z = Z_GHOSTF;
         This->Alpha = A_GHOSTF;
     }
 
-    /* Comprobamos si estamos tocando al coco, y lo matamos */
-    if(Info->X == CInfo->X && Info->Y == CInfo->Y)
-        switch(CInfo->State) {
-            case IN_NONE:
-                (*LifesCount)--;
-                CRE_TSetState(TYPE_PCOCO, CRE_PS_DEAD);
-		/* Si quedan vidas, creamos un nuevo comecocos */
-		if(*LifesCount > 0)
-		  CurrentCoco = PCoco.New();
-		/* Sino, mostramos el mensaje de 'game over' */
-		else
-		  PEndWindows.New(IND_GAMEOVER);
+    /* Actualizamos nuestra casilla, avisando a los que haya en ella */
+    CRE_GridMove(Game->Grid, Info->Cell, Info->X, Info->Y);
+}
 
-                break;
+/* Al coincidir con otro proceso en una casilla */
+void PGhost_Touch(creProcess * This, creProcess * Other)
+{
+    GameState * Game = COCO_GetState();
+    PCocoData * CInfo;
+
+    /* Solo nos interesa el comecocos */
+    if(Other->Type != TYPE_PCOCO)
+        return;
+    CInfo = (PCocoData *) Other->Data;
+
+    /* Si estamos tocando al coco, lo matamos */
+    switch(CInfo->State) {
+        case IN_NONE:
+            (*Game->LifesCount)--;
+            CRE_TSetState(TYPE_PCOCO, CRE_PS_DEAD);
+            /* Si quedan vidas, creamos un nuevo comecocos */
+            if(*Game->LifesCount > 0)
+                Game->CurrentCoco = PCoco.New()->Id;
+            /* Sino, mostramos el mensaje de 'game over' */
+            else
+                PEndWindows.New(IND_GAMEOVER);
+            break;
 
-            /* Si va ciego el coco, nos cargamos al fantasma */
-            case IN_SHOCK:
-                This->State = CRE_PS_DEAD;
-                *Score += 5000;
-                break;
-        }
+        /* Si va ciego el coco, nos cargamos al fantasma */
+        case IN_SHOCK:
+            This->State = CRE_PS_DEAD;
+            *Game->Score += 5000;
+            break;
+    }
 }
 
 /* Destructor */
 void PGhost_Free(creProcess * This)
 {
-    /* Liberamos memoria */
-    if (This->Data != NULL)
-      free(This->Data);
+    GameState * Game = COCO_GetState();
 
-    free(This);
+    /* Lo quitamos de la rejilla y liberamos memoria */
+    CRE_GridRemove(Game->Grid, ((PGhostData *)This->Data)->Cell);
+    CRE_FreeProcess(This);
 }
 
 
@@ -681,23 +616,25 @@ creProcess PGlint = {0, TYPE_GLINT, CRE_PS_CLASS, "Brillo", NULL, PGlint_New,
 /* Constructor */
 creProcess * PGlint_New()
 {
-    creProcess * This;
+    GameState * Game = COCO_GetState();
+    creProcess * This, * Coco;
 
     /* Creamos la instancia */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PGlint;
+    This = CRE_AllocProcess(&PGlint, sizeof(Uint32));
     This->State = CRE_PS_DEFAULT;
 
     /* Asignamos el grfico indicado */
-    This->Graph = MGfCoco->Gfx[IND_GLINT];
+    This->Graph = COCO_GFX(MGfCoco, IND_GLINT);
 
     /* Damos a la instancia la misma posicin que la del comecocos */
-    This->X = CurrentCoco->X;
-    This->Y = CurrentCoco->Y;
+    Coco = CRE_GetProcess(Game->CurrentCoco);
+    if(Coco != NULL) {
+        This->X = Coco->X;
+        This->Y = Coco->Y;
+    }
 
     /* Creamos e incializamos los datos de la instancia */
-    This->Data = malloc(sizeof(Uint32));
-    *((Uint32 *) This->Data) = SDL_GetTicks();
+    *((Uint32 *) This->Data) = CRE_GetTicks();
 
     /* Aadimos la instancia a la lista de procesos */
     CRE_AddProcess(This);
@@ -708,28 +645,35 @@ creProcess * PGlint_New()
 /* Bucle */
 void PGlint_Loop(creProcess * This)
 {
-    PCocoData * CInfo = (PCocoData *) CurrentCoco->Data;
+    GameState * Game = COCO_GetState();
+    creProcess * Coco = CRE_GetProcess(Game->CurrentCoco);
+    PCocoData * CInfo;
+
+    /* Sin comecocos (fin de la partida) no hay nada que hacer */
+    if(Coco == NULL)
+        return;
+    CInfo = (PCocoData *) Coco->Data;
 
     /* Actualizamos la posicin del proceso */
-    This->X = CurrentCoco->X;
-    This->Y = CurrentCoco->Y;
+    This->X = Coco->X;
+    This->Y = Coco->Y;
 
     /* Giramos el grfico 5 */
-    This->Angle += 5000;
+    This->Angle = (This->Angle + GLINT_STEP) % 360000;
 
     /*
      * Si quedan menos de 3 segundo para que acabe el estado de shock, hacemos
      * que el grfico se ponga intermintente.
      */
-    if(SDL_GetTicks() - *((Uint32 *) This->Data) >= COCO_SHOCKTIME - 3000) {
+    if(CRE_GetTicks() - *((Uint32 *) This->Data) >= COCO_SHOCKTIME - 3000) {
         if(This->Graph != NULL)
             This->Graph = NULL;
         else
-            This->Graph = MGfCoco->Gfx[IND_GLINT];
+            This->Graph = COCO_GFX(MGfCoco, IND_GLINT);
     }
 
     /* Si el tiempo se ha agotado, terminamos el estado de shock */
-    if(SDL_GetTicks() - *((Uint32 *) This->Data) >= COCO_SHOCKTIME) {
+    if(CRE_GetTicks() - *((Uint32 *) This->Data) >= COCO_SHOCKTIME) {
         This->State = CRE_PS_DEAD;
         CInfo->State = IN_NONE;
     }
@@ -740,9 +684,7 @@ void PGlint_Loop(creProcess * This)
 void PGlint_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    if (This->Data != NULL)
-      free(This->Data); 
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -753,61 +695,66 @@ void PGlint_Free(creProcess * This)
 
 /* Defincin de clase */
 creProcess PCandy = {0, TYPE_CANDY, CRE_PS_CLASS, "Caramelo", NULL, PCandy_New,
-    PCandy_Loop, PCandy_Free,   NULL, 0, 0, Z_CANDY, 255, 0, 100, 100, NULL};
+    NULL, PCandy_Free,   NULL, 0, 0, Z_CANDY, 255, 0, 100, 100, NULL};
 
 /* Constructor */
 creProcess * PCandy_New(Sint32 X, Sint32 Y)
 {
+    GameState * Game = COCO_GetState();
     creProcess * This;
 
     /* Creamos la instancia */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PCandy;
+    This = CRE_AllocProcess(&PCandy, sizeof(PCandyData));
     This->State = CRE_PS_DEFAULT;
 
     /* Asignamos el grfico indicado */
-    This->Graph = MGfMisc->Gfx[IND_CANDY];
+    This->Graph = COCO_GFX(MGfMisc, IND_CANDY);
 
     /* Asignamos la posicin indicada */
-    This->X = X * MScScen->Size + AuxMidSize;
-    This->Y = Y * MScScen->Size + AuxMidSize;
+    This->X = X * Game->MScScen->Size + Game->AuxMidSize;
+    This->Y = Y * Game->MScScen->Size + Game->AuxMidSize;
 
     /* Creamos e inicializamos los datos del proceso */
-    This->Data = malloc(sizeof(PCandyData));
     *((PCandyData *)This->Data) = (PCandyData) {X, Y};
 
-    /* Lo aadimos a la lista de procesos */
+    /* Lo aadimos a la lista de procesos y lo registramos en su casilla; no
+       se mueve, as que no necesita bucle */
     CRE_AddProcess(This);
+    ((PCandyData *)This->Data)->Cell = CRE_GridAdd(Game->Grid, This, X, Y,
+      PCandy_Touch);
 
     return This;
 }
 
-/* Bucle */
-void PCandy_Loop(creProcess * This)
+/* Al coincidir con otro proceso en una casilla */
+void PCandy_Touch(creProcess * This, creProcess * Other)
 {
-    PStarData * Info = (PStarData *) This->Data;
-    PCocoData * CInfo = (PCocoData *) CurrentCoco->Data;
-
-    /* En caso de que el comecocos este encima  */
-    if(Info->X == CInfo->X && Info->Y == CInfo->Y) {
-        /* Eliminamos el caramelo */
-        This->State = CRE_PS_DEAD;
-        /* SI el comecocos tenia un destello (Shock) lo eliminamos */
-        CRE_TSetState(TYPE_GLINT, CRE_PS_DEAD);
-        /* Damos puntos, inciamos el destello y el estado de shock */
-        *Score += 2500;
-        PGlint.New();
-        CInfo->State = IN_SHOCK;
-    }
+    GameState * Game = COCO_GetState();
+    PCocoData * CInfo;
+
+    /* Solo nos interesa el comecocos, que nos acaba de pisar */
+    if(Other->Type != TYPE_PCOCO)
+        return;
+    CInfo = (PCocoData *) Other->Data;
+
+    /* Eliminamos el caramelo */
+    This->State = CRE_PS_DEAD;
+    /* SI el comecocos tenia un destello (Shock) lo eliminamos */
+    CRE_TSetState(TYPE_GLINT, CRE_PS_DEAD);
+    /* Damos puntos, inciamos el destello y el estado de shock */
+    *Game->Score += 2500;
+    PGlint.New();
+    CInfo->State = IN_SHOCK;
 }
 
 /* Destructor */
 void PCandy_Free(creProcess * This)
 {
-    /* Liberamos memoria */
-    if (This->Data != NULL)
-      free(This->Data);
-    free(This);
+    GameState * Game = COCO_GetState();
+
+    /* Lo quitamos de la rejilla y liberamos memoria */
+    CRE_GridRemove(Game->Grid, ((PCandyData *)This->Data)->Cell);
+    CRE_FreeProcess(This);
 }
 
 
@@ -824,29 +771,64 @@ creProcess PGame = {0, TYPE_PGAME, CRE_PS_CLASS, "CTRL (Escenario)", NULL,
 /* Constructor */
 creProcess * PGame_New()
 {
+    GameState * Game = COCO_GetState();
+    creMSc * Scen = Game->MScScen;
     creProcess * This;
+    creTileAnim Star = {IND_STAR, IND_STAR_SIZE, STAR_PERIOD};
+    PGameData * Info;
+    creTileMap * Map;
+    Sint32 i, j, k;
 
     /* Si no hay otro en lista */
-    if(!HasGameInit) {
+    if(!Game->HasGameInit) {
         /* Creamos ela instancia */
-        This = (creProcess *) malloc(sizeof(creProcess));
-        *This = PGame;
+        This = CRE_AllocProcess(&PGame, sizeof(PGameData));
         This->State = CRE_PS_DEFAULT;
 
-        /* Construimos el mapa de tiles */
-        This->Graph = CRE_DrawMSc(MScScen);
-
         /* Creamo e inicializamos la informacin del proceso */
-        This->Data = malloc(sizeof(PGameData));
-        *((PGameData *)This->Data) = (PGameData)
-          {MScScen->KeyPoints[IND_KP_GHOST_TIMES].X, SDL_GetTicks(),
-          SDL_GetTicks()};
+        Info = (PGameData *) This->Data;
+        *Info = (PGameData) {Scen->KeyPoints[IND_KP_GHOST_TIMES].X,
+          CRE_GetTicks(), CRE_GetTicks(), NULL, 0, 0};
+
+        /* Sin pantalla, el mapa y su capa de objetos no tienen grficos */
+        Map = Info->Map = CRE_NewTileMap(Scen, 0);
+        if(Map == NULL || CRE_NewPickupLayer(Map, MGfStar, &Star, 1) == NULL) {
+            CRE_FreeTileMap(Map);
+            CRE_FreeProcess(This);
+            return NULL;
+        }
+
+        /* Ponemos una estrella en cada hueco del mapa, salvo en los puntos
+           clave */
+        for(j = 0; j < Scen->H; j++)
+            for(i = 0; i < Scen->W; i++)
+                if(Scen->Map[i + j * Scen->W] == 0)
+                    CRE_SetPickup(Map, i, j, ITEM_STAR);
+        for(k = 0; k < Scen->KPCount; k++)
+            CRE_SetPickup(Map, Scen->KeyPoints[k].X, Scen->KeyPoints[k].Y, 0);
+        Game->StarsCount = Map->Pickups->Count;
+
+        if(!CRE_IsHeadless()) {
+            /* El grfico es solo la zona visible del escenario, que se dibuja
+               desde el mapa de tiles por trozos */
+            This->Graph = SDL_CreateRGBSurface(SDL_SWSURFACE,
+              MIN(Scen->W * Scen->Size, GAME_VIEW_W),
+              MIN(Scen->H * Scen->Size, GAME_VIEW_H),
+              creScreen->format->BitsPerPixel, creScreen->format->Rmask,
+              creScreen->format->Gmask, creScreen->format->Bmask,
+              creScreen->format->Amask);
+            This->X = This->Graph->w / 2;
+            This->Y = This->Graph->h / 2;
+            CRE_SetCamera(0, 0);
+            CRE_DrawTileMap(Map, This->Graph, 0, 0);
+        }
 
         /* Lo aadimos a la lista de procesos */
         CRE_AddProcess(This);
 
         /* Indicamos que se ha iniciado una partida */
-        HasGameInit = 1;
+        Game->HasGameInit = 1;
+        Game->CurrentGame = This->Id;
 
         return This;
 
@@ -858,7 +840,42 @@ creProcess * PGame_New()
 /* Bucle */
 void PGame_Loop(creProcess * This)
 {
+    GameState * Game = COCO_GetState();
+    creMSc * Scen = Game->MScScen;
     PGameData * Info = (PGameData *) This->Data;
+    creProcess * Coco = CRE_GetProcess(Game->CurrentCoco);
+    Sint32 CamX, CamY;
+    Uint32 i;
+
+    /* Sin pantalla no hay escenario que animar ni cmara que mover */
+    if(!CRE_IsHeadless()) {
+        /* Avanzamos los tiles animados y marcamos las zonas que cambian */
+        if(CRE_AnimateTileMap(Info->Map, CRE_GetTicks(), This->Graph,
+          Info->CamX, Info->CamY))
+            for(i = 0; i < Info->Map->ChangedCount; i++)
+                CRE_AddDirtyRect(This->X - This->Graph->w / 2 +
+                  Info->Map->Changed[i].x, This->Y - This->Graph->h / 2 +
+                  Info->Map->Changed[i].y, Info->Map->Changed[i].w,
+                  Info->Map->Changed[i].h);
+
+        /* La cmara sigue al comecocos sin salirse del escenario */
+        if(Coco != NULL) {
+            CamX = MIN(MAX(0, Coco->X - This->Graph->w / 2),
+              Scen->W * Scen->Size - This->Graph->w);
+            CamY = MIN(MAX(0, Coco->Y - This->Graph->h / 2),
+              Scen->H * Scen->Size - This->Graph->h);
+            CRE_SetCamera(CamX, CamY);
+        }
+
+        /* Si la cmara se ha movido, redibujamos la zona visible */
+        CRE_GetCamera(&CamX, &CamY);
+        if(CamX != Info->CamX || CamY != Info->CamY) {
+            CRE_DrawTileMap(Info->Map, This->Graph, CamX, CamY);
+            Info->CamX = CamX;
+            Info->CamY = CamY;
+            This->State |= CRE_PS_CHANGED;
+        }
+    }
 
     /* Comprobamos los eventos */
     for(creEList.CurrentEvent = 0; creEList.CurrentEvent < creEList.Size;
@@ -875,53 +892,56 @@ void PGame_Loop(creProcess * This)
         /* Truco que salta al siguiente nivel */
         if(creEList.Events[creEList.CurrentEvent].type == SDL_KEYDOWN &&
           creEList.Events[creEList.CurrentEvent].key.keysym.sym == SDLK_F9)
-            StarsCount = 0;
+            Game->StarsCount = 0;
       }
 
     /* Creamos nuevos fantasmas cuando pase el tiempo establecido */
-    if((SDL_GetTicks() - Info->Time) >= Info->WaitTime) {
+    if((CRE_GetTicks() - Info->Time) >= Info->WaitTime) {
 
         /* Actualizamos el tiempo de espera de creacin de fantasmas */
         if(Info->WaitTime > GHOST_MIN_WAITTIME)
-            Info->WaitTime -= MScScen->KeyPoints[IND_KP_GHOST_TIMES].Y;
+            Info->WaitTime -= Scen->KeyPoints[IND_KP_GHOST_TIMES].Y;
         else
            Info->WaitTime = GHOST_MIN_WAITTIME;
 
         /* Creamos el moustro :D */
-        PGhost.New(RANDOM(MScScen->KeyPoints[IND_KP_ULBOX].X,
-          MScScen->KeyPoints[IND_KP_DRBOX].X + 1), RANDOM(MScScen->KeyPoints
-          [IND_KP_ULBOX].Y, MScScen->KeyPoints[IND_KP_DRBOX].Y + 1));
+        PGhost.New(RANDOM(Scen->KeyPoints[IND_KP_ULBOX].X,
+          Scen->KeyPoints[IND_KP_DRBOX].X + 1), RANDOM(Scen->KeyPoints
+          [IND_KP_ULBOX].Y, Scen->KeyPoints[IND_KP_DRBOX].Y + 1));
 
         /* Actualizamos el reloj y volvemos a esperar */
-        Info->Time = SDL_GetTicks();
+        Info->Time = CRE_GetTicks();
     }
 
     /* Controlamos el tiempo global */
-    if((SDL_GetTicks() - Info->GTime) >= 1000) {
-        GameTime--;
-        Info->GTime = SDL_GetTicks();
+    if((CRE_GetTicks() - Info->GTime) >= 1000) {
+        Game->GameTime--;
+        Info->GTime = CRE_GetTicks();
     }
 
     /* Observamos si el tiempo se ha acabado */
-    if(GameTime <= 0)
+    if(Game->GameTime <= 0)
         PEndWindows.New(IND_GAMEOVER);
 
     /* Si el comecocos ha conseguido la victoria */
-    if(StarsCount == 0)
+    if(Game->StarsCount == 0)
         PEndWindows.New(IND_LEVELUP);
 }
 
 /* Destructor */
 void PGame_Free(creProcess * This)
 {
-    /* Liberamos memoria */
-    SDL_FreeSurface(This->Graph);
-    if (This->Data != NULL)
-      free(This->Data);
-    free(This);
+    GameState * Game = COCO_GetState();
+    PGameData * Info = (PGameData *) This->Data;
+
+    /* Liberamos memoria; sin pantalla no hay grfico */
+    if(This->Graph != NULL)
+        SDL_FreeSurface(This->Graph);
+    CRE_FreeTileMap(Info->Map);
+    CRE_FreeProcess(This);
 
     /* Indicamos que se ha terminado la partida */
-    HasGameInit = 0;
+    Game->HasGameInit = 0;
 }
 
 
@@ -929,6 +949,29 @@ void PGame_Free(creProcess * This)
  * Implementacin de funciones
  */
 
+/*
+ * COCO_EndLevel
+ * Libera el escenario de la partida, su rejilla y su mapa de navegacin, y
+ * devuelve la cmara a su sitio.
+ */
+void COCO_EndLevel(void)
+{
+    GameState * Game = COCO_GetState();
+
+    CRE_FreeMSc(Game->MScScen);
+    Game->MScScen = NULL;
+    CRE_FreeGrid(Game->Grid);
+    Game->Grid = NULL;
+    CRE_FreeNavField(Game->CocoField);
+    Game->CocoField = NULL;
+    CRE_FreeNavMap(Game->Nav);
+    Game->Nav = NULL;
+    /* La cmara es del dibujado, que comparten todos los mundos */
+    if(!CRE_IsHeadless())
+        CRE_SetCamera(0, 0);
+}
+
+
 /*
  * COCO_StartLevel
  * Inicia una partida del archivo escenario indicado. Si por algn motivo no a
@@ -937,63 +980,194 @@ void PGame_Free(creProcess * This)
  */
 int COCO_StartLevel(char * FileName, Uint8 * Lifes, Uint32 * Score_ )
 {
-    Sint32 i, j, k, p;
+    GameState * Game = COCO_GetState();
+    creMSc * Scen;
+    Sint32 i;
 
     /* Cargamos el escenario */
-    MScScen = CRE_LoadMSc(FileName);
+    Scen = Game->MScScen = CRE_LoadMSc(FileName);
 
     /* Sino existe devolvemos un error */
-    if(MScScen == NULL)
+    if(Scen == NULL)
         return -1;
 
     /* Inicializamos el tamao de ajuste de los grficos */
-    AuxMidSize = MScScen->Size / 2;
+    Game->AuxMidSize = Scen->Size / 2;
 
     /* Eliminamos todos los procesos anteriores */
     CRE_LetPrcsAlone(0);
 
-    /* Creamos el juego y empezamos el bucle (si no lo estaba antes) */
-    PGame.New();
+    /* Creamos la rejilla de ocupacin del escenario */
+    Game->Grid = CRE_NewGrid(Scen->W, Scen->H);
+
+    /*
+     * Y su mapa de navegacin: el comecocos solo pasa por los tiles vacos y
+     * los fantasmas, adems, por los de su caja
+     */
+    memset(Game->NavMasks, 0, sizeof(Game->NavMasks));
+    Game->NavMasks[0] = NAV_COCO | NAV_GHOST;
+    Game->NavMasks[11] = NAV_GHOST;
+    Game->Nav = CRE_NewNavMap(Scen->W, Scen->H, Scen->Map, Game->NavMasks);
+    Game->CocoField = CRE_NewNavField(Game->Nav, NAV_GHOST);
+
+    /* Creamos el juego; sin l no hay partida */
+    if(PGame.New() == NULL) {
+        COCO_EndLevel();
+        return -1;
+    }
 
     /* Creamos procesos asociado al juego */
     PDownBar.New();
-    CurrentCoco = PCoco.New();
-
-    /* Creamos las estrellas en los huecos del mapa */
-    StarsCount = 0;
-    for(j = 0; j < MScScen->H; j++)
-        for(i = 0; i < MScScen->W; i++) {
-            p = 1;
-            for(k = 0; k < MScScen->KPCount; k++)
-                if(MScScen->KeyPoints[k].X == i && MScScen->KeyPoints[k].Y == j)
-                    p = 0;
-
-            if(p && MScScen->Map[i + j *MScScen->W] == 0)
-                PStar.New(i, j);
-        }
+    Game->CurrentCoco = PCoco.New()->Id;
 
     /* Creamos los fantasmas en el mapa */
     for(i = 0; i < INIT_GHOSTS_NUMBER; i++) {
-        PGhost.New(RANDOM(MScScen->KeyPoints[IND_KP_ULBOX].X,
-          MScScen->KeyPoints[IND_KP_DRBOX].X + 1), RANDOM(MScScen->KeyPoints
-          [IND_KP_ULBOX].Y, MScScen->KeyPoints[IND_KP_DRBOX].Y + 1));
+        PGhost.New(RANDOM(Scen->KeyPoints[IND_KP_ULBOX].X,
+          Scen->KeyPoints[IND_KP_DRBOX].X + 1), RANDOM(Scen->KeyPoints
+          [IND_KP_ULBOX].Y, Scen->KeyPoints[IND_KP_DRBOX].Y + 1));
     }
 
     /* Creamos los caramelos */
-    for(i = IND_KP_BONUSP_START; i < MScScen->KPCount; i++)
-        PCandy.New(MScScen->KeyPoints[i].X, MScScen->KeyPoints[i].Y);
+    for(i = IND_KP_BONUSP_START; i < Scen->KPCount; i++)
+        PCandy.New(Scen->KeyPoints[i].X, Scen->KeyPoints[i].Y);
 
     /* Actualizamos variables */
-    Score = Score_;
-    LifesCount = Lifes;
-    GameTime = MScScen->KeyPoints[IND_KP_GLOBAL_TIME].X;
+    Game->Score = Score_;
+    Game->LifesCount = Lifes;
+    Game->GameTime = Scen->KeyPoints[IND_KP_GLOBAL_TIME].X;
 
     /* Comenzamos el bucle principal y la partida */
     CRE_StartLoop();
-
-    /* Liberamos memoria del mapa */
-    CRE_FreeMSc(MScScen);
+    COCO_EndLevel();
 
     /* Devolvemos si el jugador ha tenido xito */
-    return (StarsCount == 0);
+    return (Game->StarsCount == 0);
+}
+
+
+/*
+ * COCO_PlayWorld
+ * Juega la partida del LevelRun del mundo actual y guarda cmo ha acabado.
+ */
+void COCO_PlayWorld(Uint32 Index, void * Arg)
+{
+    LevelRun * Run = (LevelRun *) Arg + Index;
+
+    Run->Result = COCO_StartLevel(Run->FileName, &Run->Lifes, &Run->Score);
+    Run->Stars = COCO_GetState()->StarsCount;
+}
+
+
+/*
+ * COCO_RedrawTile
+ * Copia una casilla del mapa de tiles a la zona visible del escenario y marca
+ * esa zona de la pantalla para redibujarla.
+ */
+void COCO_RedrawTile(creProcess * Process, Sint32 X, Sint32 Y)
+{
+    creMSc * Scen = COCO_GetState()->MScScen;
+    PGameData * Info = (PGameData *) Process->Data;
+    SDL_Rect Rect;
+
+    /* Sin pantalla no hay nada que redibujar */
+    if(CRE_IsHeadless())
+        return;
+
+    /* La copiamos a la zona visible, recortando a la casilla */
+    Rect.x = X * Scen->Size - Info->CamX;
+    Rect.y = Y * Scen->Size - Info->CamY;
+    Rect.w = Rect.h = Scen->Size;
+    SDL_SetClipRect(Process->Graph, &Rect);
+    CRE_DrawTileMap(Info->Map, Process->Graph, Info->CamX, Info->CamY);
+    SDL_SetClipRect(Process->Graph, NULL);
+
+    /* Y marcamos esa zona de la pantalla para redibujarla */
+    CRE_AddDirtyRect(Process->X - Process->Graph->w / 2 + Rect.x,
+      Process->Y - Process->Graph->h / 2 + Rect.y, Rect.w, Rect.h);
+}
+
+
+/*
+ * COCO_SetTile
+ * Cambia un tile del escenario de la partida actual y redibuja solo esa zona
+ * de la pantalla.
+ */
+int COCO_SetTile(Sint32 X, Sint32 Y, char Tile)
+{
+    GameState * Game = COCO_GetState();
+    creProcess * Process = CRE_GetProcess(Game->CurrentGame);
+
+    if(Process == NULL)
+        return -1;
+
+    /* Cambiamos el tile en el mapa y en su trozo */
+    if(CRE_SetTile(((PGameData *) Process->Data)->Map, X, Y, Tile) != 0)
+        return -1;
+
+    /* Quin puede pasar por ella tambin cambia */
+    CRE_NavSetCell(Game->Nav, X, Y, Game->NavMasks[(Uint8) Tile]);
+
+    COCO_RedrawTile(Process, X, Y);
+    return 0;
+}
+
+
+/*
+ * COCO_TakePickup
+ * Recoge el objeto de una casilla del escenario de la partida actual y
+ * redibuja esa zona de la pantalla.
+ */
+Uint8 COCO_TakePickup(Sint32 X, Sint32 Y)
+{
+    GameState * Game = COCO_GetState();
+    creProcess * Process = CRE_GetProcess(Game->CurrentGame);
+    Uint8 Item;
+
+    if(Process == NULL)
+        return 0;
+
+    /* Una sola consulta a la capa de objetos */
+    Item = CRE_TakePickup(((PGameData *) Process->Data)->Map, X, Y);
+    if(Item != 0)
+        COCO_RedrawTile(Process, X, Y);
+
+    return Item;
+}
+
+
+/*
+ * COCO_GetState
+ * Devuelve el estado de la partida del mundo actual, crendolo la primera
+ * vez. Se libera con el mundo.
+ */
+GameState * COCO_GetState(void)
+{
+    GameState * State = (GameState *) CRE_GetWorldData();
+
+    if(State == NULL) {
+        State = (GameState *) calloc(1, sizeof(GameState));
+        if(State != NULL)
+            CRE_SetWorldData(State, free);
+    }
+
+    return State;
+}
+
+
+/*
+ * COCO_RandomDir
+ * Elige al azar una de las direcciones de una combinacin de ellas.
+ */
+Uint8 COCO_RandomDir(Uint8 Dirs)
+{
+    Uint8 Opts[4], Count = 0;
+
+    if(Dirs & TO_LEFT) Opts[Count++] = TO_LEFT;
+    if(Dirs & TO_RIGHT) Opts[Count++] = TO_RIGHT;
+    if(Dirs & TO_UP) Opts[Count++] = TO_UP;
+    if(Dirs & TO_DOWN) Opts[Count++] = TO_DOWN;
+
+    if(Count == 0)
+        return TO_FRONT;
+    return Opts[CRE_Random() % Count];
 }
@@ -41,12 +41,22 @@
 #define MGFGHOST_PATH "gfx/ghost.mGf"
 #define TTFCOCO_PATH  "ttf/0001.ttf"
 
-/* Direcciones de los personajes */
-#define TO_FRONT 0x00
-#define TO_LEFT  0x01
-#define TO_RIGHT 0x02
-#define TO_UP    0x04
-#define TO_DOWN  0x08
+/*
+ * Grfico de un fichero de grficos, o NULL en el modo sin pantalla, en el
+ * que no se cargan. El ndice se evala solo si hay pantalla.
+ */
+#define COCO_GFX(MGf, Index) (CRE_IsHeadless() ? NULL : (MGf)->Gfx[Index])
+
+/* Direcciones de los personajes (las mismas que las de navegacin) */
+#define TO_FRONT CRE_NAV_NONE
+#define TO_LEFT  CRE_NAV_LEFT
+#define TO_RIGHT CRE_NAV_RIGHT
+#define TO_UP    CRE_NAV_UP
+#define TO_DOWN  CRE_NAV_DOWN
+
+/* Tipos de agente para la navegacin por el escenario */
+#define NAV_COCO  0x01
+#define NAV_GHOST 0x02
 
 /* Estado de los personajes */
 #define IN_NONE  0x00
@@ -77,6 +87,30 @@ extern TTF_Font * TTFCoco;
 extern TTF_Font * TTFCocoSmall;
 
 
+/*
+ * Estado de la partida
+ * Es de cada mundo de procesos (CRE_SetWorldData), de modo que en cada uno
+ * puede jugarse una partida distinta. Se obtiene con COCO_GetState.
+ */
+typedef struct GameState {
+    int HasGameInit;              /* Indica si se ha empezado una partida */
+    int AuxMidSize;              /* Tamao mitad de un tile del escenario */
+    Uint32 StarsCount;                  /* Estrellas que quedan por comer */
+    Uint8 * LifesCount;                               /* Vidas que quedan */
+    Uint32 * Score;                                   /* Puntuacin total */
+    Sint32 GameTime;                                   /* Tiempo restante */
+    char InfoText[4][32];           /* Informacin anterior en modo texto */
+    creMSc * MScScen;                                 /* Escenario actual */
+    Uint32 CurrentCoco;         /* Id de la nica instancia del comecocos */
+    Uint32 CurrentGame;            /* Id del proceso de la partida actual */
+    creGrid * Grid;                 /* Rejilla de ocupacin del escenario */
+    creNavMap * Nav;                  /* Mapa de navegacin del escenario */
+    creNavField * CocoField;   /* Distancias de cada casilla al comecocos */
+    Uint8 NavMasks[256];        /* Agentes que pueden pasar por cada tile */
+    Uint8 MenuOption;                  /* Opcin que va elegir el usuario */
+} GameState;
+
+
 /*
  * Definicin de procesos
  */
@@ -145,37 +179,22 @@ typedef struct PCocoData {
     Sint32 Frame;           /* Frame en el que se encuentra la animacin */
     Uint32 SugarTime;                   /* Tiempo en el que invulnerable */
     Uint8  NextDir, Enable, Loop; /* Variables auxilizar de la animacin */
+    Sint32 Cell;                   /* Entrada en la rejilla de ocupacin */
 } PCocoData;
 
 
 /*
- * PStar
- * Proceso que representa una estrella (comida del comecocos). Se considera
- * como objetivo de todos los escenario que no quede ninguna estrella en juego.
+ * Estrellas
+ * Comida del comecocos. Se considera como objetivo de todos los escenario que
+ * no quede ninguna estrella en juego. No son procesos: estn en la capa de
+ * objetos recogibles del mapa de tiles de la partida.
  */
 
-/* Definicin de constates y macros asociados al proceso */
-#define TYPE_PSTAR     5 /* Identificador de tipo */
-#define Z_STAR        50 /* Profundidad del proceso */
+/* Definicin de constates y macros asociados a las estrellas */
+#define ITEM_STAR      1 /* Tipo de objeto recogible */
 #define IND_STAR       0 /* Indice del grfico inicial de la animacin */
 #define IND_STAR_SIZE 40 /* Tamao de la animacin */
-
-/* Definicin de mtodos */
-/* Constructor */
-extern creProcess * PStar_New();
-/* Bucle */
-extern void PStar_Loop(creProcess * This);
-/*  Destructor*/
-extern void PStar_Free(creProcess * This);
-
-/* Defincin de clase */
-extern creProcess PStar;
-
-/* Definicin de datos de la clase */
-typedef struct PStarData {
-    Uint16 X, Y;  /* Posicin en tiles de la estrella */
-    Sint32 Frame; /* Frame en que se encuentra la animacin */
-} PStarData;
+#define STAR_PERIOD   24 /* Milisegundos de cada grfico de la animacin */
 
 
 
@@ -196,6 +215,7 @@ typedef struct PStarData {
 #define IND_GHOST_SIZE     5 /* Tamao de la animacin (nmero de fantasmas) */
 #define INIT_GHOSTS_NUMBER 4 /* Fantasmas inciales en el escenario */
 #define GHOST_MIN_WAITTIME 5000 /* Tiempo min entre nuevos fantasmas */
+#define GHOST_SMART       60 /* % de decisiones que persiguen o huyen */
 
 /* Definicin de mtodos */
 /* Constructor */
@@ -204,6 +224,8 @@ extern creProcess * PGhost_New();
 extern void PGhost_Loop(creProcess * This);
 /* Destructor */
 extern void PGhost_Free(creProcess * This);
+/* Al coincidir con otro proceso en una casilla */
+extern void PGhost_Touch(creProcess * This, creProcess * Other);
 
 /* Defincin de clase */
 extern creProcess PGhost;
@@ -212,6 +234,7 @@ extern creProcess PGhost;
 typedef struct PGhostData {
     Uint16 X, Y;                    /* Posicin del fantasma */
     Sint8 Alp, Dir, Enabled, Frame; /* Informacin de la animacin */
+    Sint32 Cell;                  /* Entrada en la rejilla de ocupacin */
 } PGhostData;
 
 
@@ -224,6 +247,8 @@ typedef struct PGhostData {
 #define TYPE_GLINT  8 /* Identificador de tipo */
 #define Z_GLINT    98 /* Profundidad del proceso */
 #define IND_GLINT   0 /* Indice del grfico 'destello' */
+#define GLINT_STEP  5000 /* Giro por frame del destello (miligrados) */
+#define GLINT_ROTS  (360000 / GLINT_STEP) /* Rotaciones precalculadas */
 
 /* Definicin de mtodos */
 /* Constuctor */
@@ -250,10 +275,10 @@ extern creProcess PGlint;
 /* Definicin de mtodos */
 /* Constructor */
 extern creProcess * PCandy_New();
-/* Bucle */
-extern void PCandy_Loop(creProcess * This);
 /* Destructor */
 extern void PCandy_Free(creProcess * This);
+/* Al coincidir con otro proceso en una casilla */
+extern void PCandy_Touch(creProcess * This, creProcess * Other);
 
 /* Defincin de clase */
 extern creProcess PCandy;
@@ -261,6 +286,7 @@ extern creProcess PCandy;
 /* Definicin de datos de la clase */
 typedef struct PCandyData{
     Uint16 X, Y; /* Posicin actual en tiles */
+    Sint32 Cell; /* Entrada en la rejilla de ocupacin */
 } PCandyData;
 
 
@@ -274,6 +300,8 @@ typedef struct PCandyData{
 /* Definicin de constates y macros asociados al proceso */
 #define TYPE_PGAME  3 /* Identificador de tipo */
 #define Z_GAME      5 /* Profundidad del proceso */
+#define GAME_VIEW_W 800 /* Ancho mximo de la zona visible del escenario */
+#define GAME_VIEW_H 536 /* Alto mximo de la zona visible del escenario */
 
 /* Definicin de mtodos */
 /* Constructor */
@@ -289,6 +317,8 @@ extern creProcess PGame;
 /* Definicin de datos de la clase */
 typedef struct PGameData {
     Sint32 WaitTime, Time, GTime; /* Tiempos de la partida */
+    creTileMap * Map; /* Escenario dibujado por trozos */
+    Sint32 CamX, CamY; /* Cmara con la que se ha dibujado el escenario */
 } PGameData;
 
 
@@ -310,4 +340,51 @@ typedef struct PGameData {
 
 extern int COCO_StartLevel(char * FileName, Uint8 * Lifes, Uint32 * Score_ );
 
+/*
+ * COCO_PlayWorld
+ * Entrada de CRE_RunWorlds que juega una partida en cada mundo. Arg es un
+ * array de LevelRun con uno por mundo; el de la posicin Index dice el
+ * escenario, las vidas y la puntuacin de partida, y recoge el resultado.
+ * Los mundos tienen que estar en modo sin pantalla y tener una fuente de
+ * eventos (CRE_SetEventSource) que haga de jugador.
+ */
+typedef struct LevelRun {
+    char * FileName;                            /* Escenario que se juega */
+    Uint8 Lifes;                          /* Vidas al empezar y al acabar */
+    Uint32 Score;                    /* Puntuacin al empezar y al acabar */
+    Uint32 Stars;                       /* Estrellas que quedan al acabar */
+    int Result;                    /* Final de la partida (LVL_PLAYER...) */
+} LevelRun;
+
+extern void COCO_PlayWorld(Uint32 Index, void * Arg);
+
+/*
+ * COCO_SetTile
+ * Cambia un tile del escenario de la partida actual y redibuja solo esa zona
+ * de la pantalla. Devuelve -1 si no hay partida o el tile no es vlido.
+ */
+extern int COCO_SetTile(Sint32 X, Sint32 Y, char Tile);
+
+/*
+ * COCO_TakePickup
+ * Recoge el objeto de una casilla del escenario de la partida actual y
+ * redibuja esa zona de la pantalla. Devuelve el tipo del objeto, o 0 si no
+ * haba ninguno.
+ */
+extern Uint8 COCO_TakePickup(Sint32 X, Sint32 Y);
+
+/*
+ * COCO_GetState
+ * Devuelve el estado de la partida del mundo de procesos actual. Lo crea la
+ * primera vez, y se libera con el mundo.
+ */
+extern GameState * COCO_GetState(void);
+
+/*
+ * COCO_RandomDir
+ * Elige al azar una de las direcciones de una combinacin de ellas. Devuelve
+ * TO_FRONT si no hay ninguna.
+ */
+extern Uint8 COCO_RandomDir(Uint8 Dirs);
+
 #endif
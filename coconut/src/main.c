@@ -24,6 +24,7 @@
  * de algunas tareas principales.
  */
 
+#include <string.h>
 #include <core.h>
 #include <SDL/SDL_ttf.h>
 #include "misc.h"
@@ -45,64 +46,138 @@ int main(int argc, char * argv[])
     Uint8 Option = 0; /* Opciones elejidas en el menu */
     Sint32   End = 0; /* Indica si el jugador ha terminado de jugar */
     Uint8  Level = 1; /* Nivel actual */
+    int   Result;     /* Final de la ltima partida */
     Uint32 Mode;
     /* Cadena temporal donde se escribe la ruta del escenario */
     char LevelPath[32];
+    /* Opciones de la lnea de comandos */
+    char * RecordPath = NULL, * ReplayPath = NULL;
+    Uint8 Fast = 0, FullScreen = 0, Headless = 0;
+    Uint32 Seed;
+    int i;
+
+    /*
+     * Leemos las opciones: "-record fichero" graba la sesin, "-replay
+     * fichero" reproduce una grabada ("-fast" sin esperas, "-headless" sin
+     * pantalla ni esperas) y cualquier otra activa la pantalla completa
+     */
+    for(i = 1; i < argc; i++)
+        if(strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+            RecordPath = argv[++i];
+        else if(strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+            ReplayPath = argv[++i];
+        else if(strcmp(argv[i], "-fast") == 0)
+            Fast = 1;
+        else if(strcmp(argv[i], "-headless") == 0)
+            Headless = 1;
+        else
+            FullScreen = 1;
+
+    /* Sin pantalla no hay teclado: solo se puede reproducir una grabacin */
+    if(Headless && ReplayPath == NULL) {
+        fprintf(stderr, "-headless needs a replay file (-replay)\n");
+        exit(6);
+    }
 
     /* Nos aseguramos de que siempre se descargen las librerias */
     atexit(SDL_Quit);
     atexit(TTF_Quit);
 
-    /* Inicializamos la SDL */
-    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0) {
+    /* Inicializamos la SDL; sin pantalla basta con el temporizador */
+    if(SDL_Init(Headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_TIMER)
+      < 0) {
         fprintf(stderr, "Couldn't init SDL: %s \n", SDL_GetError());
         exit(1);
     }
 
     /* Inicializamos la SDL_TTF */
-    if(TTF_Init()) {
+    if(!Headless && TTF_Init()) {
         fprintf(stderr, "Couldn't init TTF: %s \n", TTF_GetError());
         exit(2);
     }
 
-    /* Activamos el modo de vdeo */
-
-    if (argc>1) 
-      Mode = SDL_SWSURFACE | SDL_FULLSCREEN;
-    else
-      Mode = SDL_HWSURFACE;
-      
-    creScreen = SDL_SetVideoMode(800, 600, 32, Mode);
-    if(creScreen == NULL) {
-        fprintf(stderr, "Couldn't init video mode: %s\n", SDL_GetError());
-        exit(3);
+    /* Activamos el modo de vdeo, o el modo sin pantalla */
+    if(Headless)
+        CRE_SetHeadless(1);
+    else {
+        if (FullScreen) 
+          Mode = SDL_SWSURFACE | SDL_FULLSCREEN;
+        else
+          Mode = SDL_HWSURFACE;
+          
+        creScreen = SDL_SetVideoMode(800, 600, 32, Mode);
+        if(creScreen == NULL) {
+            fprintf(stderr, "Couldn't init video mode: %s\n", SDL_GetError());
+            exit(3);
+        }
+        SDL_WM_SetCaption("COCONUT", "coconut");
+        SDL_ShowCursor(SDL_DISABLE);
     }
 
     /* Inicializacin de variables y opciones generales */
-    SDL_WM_SetCaption("COCONUT", "coconut");
-    SDL_ShowCursor(SDL_DISABLE);
-    srandom(time(NULL));
     CRE_SetFPS(42);
-
-    /* Cargamos todos los ficheros grficos y fuentes */
-    MGfMisc      = CRE_LoadMGf(MGFMISC_PATH);
-    MGfCoco      = CRE_LoadMGf(MGFCOCO_PATH);
-    MGfGhost     = CRE_LoadMGf(MGFGHOST_PATH);
-    MGfStar      = CRE_LoadMGf(MGFSTAR_PATH);
-    TTFCoco      = TTF_OpenFont(TTFCOCO_PATH, 40);
-    TTFCocoSmall = TTF_OpenFont(TTFCOCO_PATH, 20);
-
-    /* Comprobamos que todos han sido cargados correctamente */
-    if(MGfMisc == NULL || MGfStar == NULL || MGfCoco == NULL || MGfGhost == NULL
-      || TTFCoco == NULL) {
-        fprintf(stderr, "Couldn't load some resource file.");
-        exit(4);
+    /* La lgica avanza a 42 pasos por segundo aunque un frame se retrase */
+    CRE_SetTimestep(CRE_TIMESTEP_FIXED);
+    /*
+     * La semilla de los nmeros aleatorios es la de la sesin que se
+     * reproduce o, si no, la hora actual, que se graba si se pide
+     */
+    Seed = (Uint32) time(NULL);
+    if(ReplayPath != NULL) {
+        if(CRE_StartReplay(ReplayPath, Fast) != 0) {
+            fprintf(stderr, "Couldn't load replay file: %s\n", ReplayPath);
+            exit(5);
+        }
+    } else if(RecordPath != NULL) {
+        if(CRE_StartRecord(RecordPath, Seed) != 0) {
+            fprintf(stderr, "Couldn't create record file: %s\n", RecordPath);
+            exit(5);
+        }
+        /* La grabacin se cierra al salir, acabe como acabe el programa */
+        atexit(CRE_StopRecord);
+    } else
+        CRE_SeedRandom(Seed);
+    /* Solo redibujamos las zonas de pantalla que cambian en cada frame */
+    CRE_SetRenderMode(CRE_RENDER_DIRTY);
+    /* Los caramelos nunca se solapan: se dibujan por lotes */
+    CRE_SetLayerBatching(Z_CANDY, 1);
+    /* El escenario dibuja l mismo la zona visible; el marcador y las
+       ventanas no se mueven con la cmara */
+    CRE_SetLayerFixed(Z_GAME, 1);
+    CRE_SetLayerFixed(Z_DBAR, 1);
+    CRE_SetLayerFixed(Z_PTEXT, 1);
+    CRE_SetLayerFixed(Z_PEXIT, 1);
+    CRE_SetLayerFixed(Z_PEND, 1);
+
+    /* Cargamos todos los ficheros grficos y fuentes, si hay pantalla */
+    if(!Headless) {
+        MGfMisc      = CRE_LoadMGf(MGFMISC_PATH);
+        MGfCoco      = CRE_LoadMGf(MGFCOCO_PATH);
+        MGfGhost     = CRE_LoadMGf(MGFGHOST_PATH);
+        MGfStar      = CRE_LoadMGf(MGFSTAR_PATH);
+        TTFCoco      = TTF_OpenFont(TTFCOCO_PATH, 40);
+        TTFCocoSmall = TTF_OpenFont(TTFCOCO_PATH, 20);
+
+        /* Comprobamos que todos han sido cargados correctamente */
+        if(MGfMisc == NULL || MGfStar == NULL || MGfCoco == NULL ||
+          MGfGhost == NULL || TTFCoco == NULL) {
+            fprintf(stderr, "Couldn't load some resource file.");
+            exit(4);
+        }
+
+        /* Precalculamos las rotaciones del destello, que gira continuamente */
+        CRE_PrebakeRotations(MGfCoco->Gfx[IND_GLINT], GLINT_ROTS, 100);
     }
 
-    /* Empezamos el juego */
+    /*
+     * Empezamos el juego. Sin pantalla se sigue el mismo camino que en la
+     * sesin grabada, mens incluidos, hasta que se acaba la grabacin
+     */
     while(1) {
         /* Mostramos el menu */
         Option = COCO_MainMenu();
+        if(Headless && !CRE_IsReplaying())
+            break;
 
         /* Si el usuario a elejido comenzar una nueva partida */
         if(Option == OP_NEWGAME) {
@@ -115,7 +190,10 @@ int main(int argc, char * argv[])
             while(!End) {
                 /* Obtenemos la ruta del nivel actual */
                 sprintf(LevelPath, LEVELS_PATH, Level);
-                switch(COCO_StartLevel(LevelPath, &Lifes, &Score)) {
+                Result = COCO_StartLevel(LevelPath, &Lifes, &Score);
+                if(Headless && !CRE_IsReplaying())
+                    break;
+                switch(Result) {
                     /* Indica que no quedan ms niveles */
                     case LVL_MAPERROR:
                         End = 1;
@@ -135,9 +213,17 @@ int main(int argc, char * argv[])
         /* Sino significa que quiere salir */
         } else
             break;
+
+        if(Headless && !CRE_IsReplaying())
+            break;
     }
 
+    /* Sin pantalla, el resultado de la partida reproducida */
+    if(Headless)
+        printf("Level %d, lifes %d, score %u\n", Level, Lifes, Score);
+
     /* Descargamos todos los grficos y funetes */
+    CRE_FreeRotations(NULL);
     CRE_FreeMGf(MGfMisc);
     CRE_FreeMGf(MGfCoco);
     CRE_FreeMGf(MGfStar);
@@ -35,9 +35,6 @@
  * Variable globales
  */
 
-/* Opcin que va elegir el usuario */
-Uint8 MenuOption = OP_NEWGAME;
-
 /* Graficos asociados a los procesos de este archivo */
 creMGf * MGfMisc = NULL;
 
@@ -63,17 +60,18 @@ creProcess * PText_New(char * Str, Sint32 X, Sint32 Y, TTF_Font * Font,
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PText;
+    This = CRE_AllocProcess(&PText, Type ? 0 : sizeof(PTextData));
     This->State = CRE_PS_DEFAULT;
     This->X = X; This->Y = Y;
 
-    if(Type) {
+    /* Sin pantalla no hay fuentes con las que dibujar el texto */
+    if(CRE_IsHeadless())
+        This->Loop = NULL;
+    else if(Type) {
         This->Graph = This->Graph = TTF_RenderText_Blended(Font, Str,
           (SDL_Color){255, 255, 255, 0});
         This->Loop = NULL;
     } else {
-        This->Data = malloc(sizeof(PTextData));
         *((PTextData *) This->Data) = (PTextData) {Str, Font};
     }
     CRE_AddProcess(This);
@@ -92,6 +90,8 @@ void PText_Loop(creProcess * This)
 
     This->Graph = TTF_RenderText_Solid(Text->Font, Text->String,
       (SDL_Color){255, 255, 255, 0});
+    /* El nuevo grfico puede ocupar la misma direccin que el anterior */
+    This->State |= CRE_PS_CHANGED;
 
     return;
 }
@@ -102,9 +102,7 @@ void PText_Free(creProcess * This)
     if(This->Graph == NULL)
         SDL_FreeSurface(This->Graph);
     /* Liberamos memoria */
-    if (This->Data != NULL)
-      free(This->Data);
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -125,12 +123,11 @@ creProcess * PExitWindows_New()
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PExitWindows;
+    This = CRE_AllocProcess(&PExitWindows, 0);
     This->State = CRE_PS_DEFAULT;
 
     /* Asociamos al proceso su imagen */
-    This->Graph = MGfMisc->Gfx[IND_EXITWINDOWS];
+    This->Graph = COCO_GFX(MGfMisc, IND_EXITWINDOWS);
 
     /*
      * Limpiamos la lista de eventos ya que la ventana espera recibir qualquier
@@ -148,6 +145,8 @@ creProcess * PExitWindows_New()
 /* Bucle */
 void PExitWindows_Loop(creProcess * This)
 {
+    GameState * Game = COCO_GetState();
+
     if(This->Alpha < 255) {
         This->Alpha += 10;
     }
@@ -156,7 +155,7 @@ void PExitWindows_Loop(creProcess * This)
       creEList.CurrentEvent++) {
         if(creEList.Events[creEList.CurrentEvent].type == SDL_QUIT) {
             CRE_LetPrcsAlone(0);
-            MenuOption = OP_EXIT;
+            Game->MenuOption = OP_EXIT;
         }
 
         if(creEList.Events[creEList.CurrentEvent].type == SDL_KEYDOWN) {
@@ -166,13 +165,13 @@ void PExitWindows_Loop(creProcess * This)
                 CRE_TSetState(0, CRE_PS_WAKEUP);
                 This->State = CRE_PS_DEAD;
                 creEList.Size = 0;
-                MenuOption = OP_NEWGAME;
+                Game->MenuOption = OP_NEWGAME;
             }
 
             if(creEList.Events[creEList.CurrentEvent].key.keysym.sym ==
               SDLK_s) {
                 CRE_LetPrcsAlone(0);
-                MenuOption = OP_EXIT;
+                Game->MenuOption = OP_EXIT;
             }
         }
     }
@@ -183,7 +182,7 @@ void PExitWindows_Loop(creProcess * This)
 void PExitWindows_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -203,11 +202,10 @@ creProcess * PMainMenu_New()
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PMainMenu;
+    This = CRE_AllocProcess(&PMainMenu, 0);
     This->State = CRE_PS_DEFAULT;
 
-    This->Graph = MGfMisc->Gfx[IND_MENUBG];
+    This->Graph = COCO_GFX(MGfMisc, IND_MENUBG);
 
     CRE_AddProcess(This);
 
@@ -233,7 +231,7 @@ void PMainMenu_Loop(creProcess * This)
 void PMainMenu_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -253,13 +251,11 @@ creProcess * PArrow_New()
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PArrow;
+    This = CRE_AllocProcess(&PArrow, sizeof(PArrowData));
     This->State = CRE_PS_DEFAULT;
 
-    This->Graph = MGfMisc->Gfx[IND_ARROW];
+    This->Graph = COCO_GFX(MGfMisc, IND_ARROW);
 
-    This->Data = malloc(sizeof(PArrowData));
     *((PArrowData *) This->Data) = (PArrowData) {0, 0};
 
     CRE_AddProcess(This);
@@ -270,6 +266,7 @@ creProcess * PArrow_New()
 /* Bucle */
 void PArrow_Loop(creProcess * This)
 {
+    GameState * Game = COCO_GetState();
     PArrowData * Info = (PArrowData *) This->Data;
 
     /* Comprobamos los eventos */
@@ -278,14 +275,15 @@ void PArrow_Loop(creProcess * This)
         if(creEList.Events[creEList.CurrentEvent].type == SDL_KEYDOWN) {
             if(creEList.Events[creEList.CurrentEvent].key.keysym.sym ==
               SDLK_UP)
-                MenuOption = (!MenuOption) ? OP_COUNT - 1 : MenuOption - 1;
+                Game->MenuOption = (!Game->MenuOption) ? OP_COUNT - 1 :
+                  Game->MenuOption - 1;
             if(creEList.Events[creEList.CurrentEvent].key.keysym.sym ==
               SDLK_DOWN)
-                MenuOption =  (MenuOption + 1) % OP_COUNT;
+                Game->MenuOption =  (Game->MenuOption + 1) % OP_COUNT;
             if(creEList.Events[creEList.CurrentEvent].key.keysym.sym ==
               SDLK_SPACE || creEList.Events[creEList.CurrentEvent].key.keysym.
               sym == SDLK_RETURN)
-                switch(MenuOption) {
+                switch(Game->MenuOption) {
                     case OP_NEWGAME:
                     default:
                         CRE_EndLoop();
@@ -300,7 +298,7 @@ void PArrow_Loop(creProcess * This)
         }
 
     /* Gestin de la posicin (Seleccin del menu) */
-    switch(MenuOption) {
+    switch(Game->MenuOption) {
         case OP_NEWGAME:
         default:
             This->Y = 485;
@@ -337,7 +335,7 @@ void PArrow_Loop(creProcess * This)
 void PArrow_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -357,14 +355,12 @@ creProcess * PCredits_New()
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PCredits;
+    This = CRE_AllocProcess(&PCredits, sizeof(Uint8));
     This->State = CRE_PS_DEFAULT;
 
     /* Inicializamos las variables del proceso */
-    This->Graph = MGfMisc->Gfx[IND_CREDITS];
+    This->Graph = COCO_GFX(MGfMisc, IND_CREDITS);
     This->X = -GOTO_X;
-    This->Data = malloc(sizeof(Uint8));
     *((Uint8 *) This->Data) = CSTATE_ON;
 
     /* Lo ejecutamos y pausamos todos los dems procesos */
@@ -425,7 +421,7 @@ void PCredits_Loop(creProcess * This)
 void PCredits_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -446,11 +442,10 @@ creProcess * PEndWindows_New(Sint32 GraphId)
     creProcess * This;
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PEndWindows;
+    This = CRE_AllocProcess(&PEndWindows, 0);
     This->State = CRE_PS_DEFAULT;
 
-    This->Graph = MGfMisc->Gfx[GraphId];
+    This->Graph = COCO_GFX(MGfMisc, GraphId);
 
     /* Lo ejecutamos y pausamos todos los dems procesos */
     CRE_TSetState(0, CRE_PS_PAUSE);
@@ -476,7 +471,7 @@ void PEndWindows_Loop(creProcess * This)
 void PEndWindows_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -498,11 +493,10 @@ creProcess * PWinScreen_New(Uint32 Score)
     char Tmp[64];
 
     /* Creamos el proceso */
-    This = (creProcess *) malloc(sizeof(creProcess));
-    *This = PWinScreen;
+    This = CRE_AllocProcess(&PWinScreen, 0);
     This->State = CRE_PS_DEFAULT;
     /* Asignamos su grfico */
-    This->Graph = MGfMisc->Gfx[IND_WINBG];
+    This->Graph = COCO_GFX(MGfMisc, IND_WINBG);
     /* Lo ejecutamos y pausamos todos los dems procesos */
     CRE_LetPrcsAlone(0);
     /* Mostramos la puntuacin */
@@ -527,7 +521,7 @@ void PWinScreen_Loop(creProcess * This)
 void PWinScreen_Free(creProcess * This)
 {
     /* Liberamos memoria */
-    free(This);
+    CRE_FreeProcess(This);
 }
 
 
@@ -540,12 +534,13 @@ void PWinScreen_Free(creProcess * This)
  * Muestra el menu principal y devuelve la opcin que ha elegido el usuario.
  */
 Uint8 COCO_MainMenu(void) {
+    GameState * Game = COCO_GetState();
 
     /* Eliminamos todos los procesos anteriores */
     CRE_LetPrcsAlone(0);
 
     /* Creamos el menu principal y la flecha de selceccin */
-    MenuOption = OP_NEWGAME;
+    Game->MenuOption = OP_NEWGAME;
     PMainMenu.New();
     PArrow.New();
 
@@ -553,6 +548,6 @@ Uint8 COCO_MainMenu(void) {
     CRE_StartLoop();
 
     /* Devolvemos la opcin escogida por el usuario */
-    return MenuOption;
+    return Game->MenuOption;
 }
 
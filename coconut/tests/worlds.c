@@ -0,0 +1,185 @@
+/*
+ * coconut - A nowadays Pacman remake.
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * worlds.c
+ * Prueba de las partidas en mundos paralelos. Juega, sin pantalla, varias
+ * partidas con su semilla y un jugador guionizado en cada mundo mediante
+ * CRE_RunWorlds y COCO_PlayWorld, primero en un solo hilo y despus en
+ * varios: el final de cada partida, las vidas, la puntuacin y las
+ * estrellas que quedan deben coincidir. Se ejecuta desde bin, donde estn
+ * los escenarios. Devuelve 0 si no hay diferencias.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <core.h>
+#include <SDL/SDL_ttf.h>
+#include "game.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Nmero de mundos, de escenarios distintos y de hilos de la segunda vuelta */
+#define WORLDS 8
+#define LEVELS 7
+#define THREADS 4
+
+/* Velocidad de las partidas */
+#define FPS 42
+
+/* Vidas al empezar cada partida */
+#define INIT_LIFES 5
+
+/* Paso a partir del cual el jugador cierra la ventana final */
+#define END_STEP 4000
+
+
+/*
+ * Definicin de tipos
+ */
+
+/* Jugador guionizado de un mundo */
+typedef struct Player {
+    Uint32 Seed;                   /* Estado de su generador de nmeros */
+    Uint32 Steps;                                      /* Pasos jugados */
+} Player;
+
+
+/*
+ * Variables globales al fichero
+ */
+
+/* Nombres de los escenarios de cada mundo */
+char Levels[WORLDS][32];
+
+/* Nmero de comprobaciones y de fallos */
+Uint32 Checks = 0, Failures = 0;
+
+
+/*
+ * Check
+ * Cuenta una comprobacin y avisa si el valor no es el esperado. Index es
+ * el mundo o el nmero de hilos de lo comprobado.
+ */
+void Check(const char * What, Uint32 Index, Uint32 Found, Uint32 Expected)
+{
+    Checks++;
+    if(Found == Expected)
+        return;
+    Failures++;
+    fprintf(stderr, "%s (%u): da %u, se esperaba %u\n", What, Index, Found,
+      Expected);
+}
+
+
+/*
+ * Script
+ * Fuente de eventos del jugador: mueve el comecocos al azar con su propio
+ * generador y, pasado END_STEP, pulsa intro para cerrar la ventana final.
+ */
+Uint32 Script(SDL_Event * Events, Uint32 Max, void * Arg)
+{
+    static const SDLKey Dirs[4] = {SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_DOWN};
+    Player * This = (Player *) Arg;
+    SDLKey Key = SDLK_UNKNOWN;
+
+    This->Steps++;
+    This->Seed ^= This->Seed << 13;
+    This->Seed ^= This->Seed >> 17;
+    This->Seed ^= This->Seed << 5;
+    if(This->Seed % 8 == 0)
+        Key = Dirs[(This->Seed >> 8) % 4];
+    if(This->Steps > END_STEP && This->Steps % 2 == 0)
+        Key = SDLK_RETURN;
+
+    if(Key == SDLK_UNKNOWN || Max == 0)
+        return 0;
+    memset(Events, 0, sizeof(SDL_Event));
+    Events->type = SDL_KEYDOWN;
+    Events->key.keysym.sym = Key;
+    return 1;
+}
+
+
+/*
+ * PlayAll
+ * Crea los mundos con sus partidas, los juega con los hilos indicados y los
+ * libera.
+ */
+void PlayAll(Uint32 Threads, LevelRun * Runs, Player * Players)
+{
+    creWorld * Worlds[WORLDS];
+    Uint32 i;
+
+    for(i = 0; i < WORLDS; i++) {
+        Runs[i].FileName = Levels[i];
+        Runs[i].Lifes = INIT_LIFES;
+        Runs[i].Score = 0;
+        Runs[i].Stars = 0;
+        Runs[i].Result = LVL_MAPERROR;
+        Players[i].Seed = (i + 1) * 2654435761u | 1;
+        Players[i].Steps = 0;
+
+        Worlds[i] = CRE_NewWorld();
+        CRE_SetWorld(Worlds[i]);
+        CRE_SetHeadless(1);
+        CRE_SetFPS(FPS);
+        CRE_SetTimestep(CRE_TIMESTEP_FIXED);
+        CRE_SeedRandom(i + 1);
+        CRE_SetEventSource(Script, &Players[i]);
+    }
+    CRE_SetWorld(NULL);
+
+    Check("Mundos jugados", Threads, CRE_RunWorlds(Worlds, WORLDS, Threads,
+      COCO_PlayWorld, Runs), WORLDS);
+
+    for(i = 0; i < WORLDS; i++)
+        CRE_FreeWorld(Worlds[i]);
+}
+
+
+int main(int argc, char * argv[])
+{
+    LevelRun Single[WORLDS], Pool[WORLDS];
+    Player SinglePlayers[WORLDS], PoolPlayers[WORLDS];
+    Uint32 i;
+
+    for(i = 0; i < WORLDS; i++)
+        sprintf(Levels[i], "sce/level%u.mSc", 1 + i % LEVELS);
+
+    PlayAll(1, Single, SinglePlayers);
+    PlayAll(THREADS, Pool, PoolPlayers);
+
+    for(i = 0; i < WORLDS; i++) {
+        Check("Escenario", i, Single[i].Result != LVL_MAPERROR, 1);
+        Check("Final", i, Pool[i].Result, Single[i].Result);
+        Check("Vidas", i, Pool[i].Lifes, Single[i].Lifes);
+        Check("Puntuacin", i, Pool[i].Score, Single[i].Score);
+        Check("Estrellas", i, Pool[i].Stars, Single[i].Stars);
+        Check("Pasos", i, PoolPlayers[i].Steps, SinglePlayers[i].Steps);
+    }
+
+    printf("%u comprobaciones, %u fallos\n", Checks, Failures);
+    return Failures != 0;
+}
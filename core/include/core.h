@@ -66,7 +66,7 @@
 #endif
 
 #ifndef RANDOM
-    #define RANDOM(A, B)  (MIN(A, B) + (random() % (MAX(A, B) - MIN(A, B))))
+    #define RANDOM(A, B) (MIN(A, B) + (CRE_Random() % (MAX(A, B) - MIN(A, B))))
 #endif
 
 /* Definicin de mascaras de 32 bits */
@@ -109,6 +109,16 @@ typedef struct crePoint {
  */
 #include "process.h"
 
+/*
+ * Funciones de apoyo al dibujado de procesos
+ */
+#include "render.h"
+
+/*
+ * Medidas de tiempo del bucle de procesos
+ */
+#include "profiler.h"
+
 /*
  * Funciones de tratamiento de ficheros minGxf (mGx/mGf)
  */
@@ -119,4 +129,19 @@ typedef struct crePoint {
  */
 #include "tiler.h"
 
+/*
+ * Rejilla de ocupacin por tiles
+ */
+#include "grid.h"
+
+/*
+ * Navegacin y campos de distancias
+ */
+#include "nav.h"
+
+/*
+ * Nmeros aleatorios y grabacin de partidas
+ */
+#include "replay.h"
+
 #endif
@@ -49,6 +49,22 @@
 /** Indica que el filtro de suavizado debe aplicarse */
 #define CRE_GFX_SMOOTH_ON 1
 
+/* Modos de mezcla de los grficos de 32 bits */
+/** Mezcla normal: el origen se dibuja sobre el destino segn su alpha */
+#define CRE_GFX_BLEND_OVER 0
+/** Mezcla aditiva: el origen, escalado por su alpha, se suma al destino */
+#define CRE_GFX_BLEND_ADD 1
+
+/* Juegos de instrucciones que pueden usar los kernels de mezcla y suavizado */
+/** Selecciona el mejor juego de instrucciones disponible en la CPU */
+#define CRE_GFX_SIMD_AUTO -1
+/** Kernels escritos en C, disponibles en cualquier plataforma */
+#define CRE_GFX_SIMD_NONE 0
+/** Kernels SSE2 (4 pixels por iteracin) */
+#define CRE_GFX_SIMD_SSE2 1
+/** Kernels AVX2 (8 pixels por iteracin) */
+#define CRE_GFX_SIMD_AVX2 2
+
 
 /*
  * Definicin de tipos
@@ -70,14 +86,68 @@ typedef struct creGfxColorY {
 } creGfxColorY;
 
 
+/**
+ * Kernel que mezcla una fila de pixels de 32 bits (Dst, Src, Count, Alpha,
+ * Ashift, Keep). Ver CRE_GfxBlendRow.
+ **/
+typedef void (* creGfxBlendFunc)(Uint32 *, Uint32 *, Sint32, Uint32, Uint32,
+    Uint32);
+
+
 /**
  * Aplica un blit entre dos superficies con el canal alpha indicado.
- * Si el grfico es de 32 bits, har un blit pixel a pixel y calcular las
- * diferencias entre los canales alpha indicados.
- **/
+ * Si el grfico es de 32 bits, el canal alpha de cada pixel se escala por el
+ * indicado y, cuando los formatos lo permiten, se mezcla directamente sobre
+ * el destino sin superficies intermedias.
+ **/
 extern int CRE_GfxAlphaBlit(SDL_Surface * Src, SDL_Surface * Trg,
     SDL_Rect * Rect, Uint8 Alpha);
 
+/**
+ * Mezcla un grfico de 32 bits con canal alpha sobre un destino de 32 bits
+ * con el mismo formato RGB, escalando el alpha de cada pixel por Alpha.
+ * Recorta con el rea de recorte del destino y deja en Rect la zona dibujada.
+ * Mode indica el modo de mezcla (CRE_GFX_BLEND_*).
+ * @return 0 si se ha hecho la mezcla, -1 si los formatos no lo permiten.
+ **/
+extern int CRE_GfxBlendBlit(SDL_Surface * Src, SDL_Surface * Trg,
+    SDL_Rect * Rect, Uint8 Alpha, Uint8 Mode);
+
+/**
+ * Como CRE_GfxBlendBlit, pero dibuja el mismo grfico en los Count
+ * rectngulos de Rects. Los formatos, el kernel de mezcla y el bloqueo del
+ * destino se resuelven una sola vez para todos ellos.
+ * @return 0 si se ha hecho la mezcla, -1 si los formatos no lo permiten.
+ **/
+extern int CRE_GfxBlendBlitBatch(SDL_Surface * Src, SDL_Surface * Trg,
+    SDL_Rect * Rects, Uint32 Count, Uint8 Alpha, Uint8 Mode);
+
+/**
+ * Mezcla una fila de Count pixels de 32 bits sobre el destino con el kernel
+ * del modo indicado. Los bits del destino indicados en Keep no se modifican.
+ **/
+extern void CRE_GfxBlendRow(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint8 Alpha, Uint8 Mode, Uint32 Ashift, Uint32 Keep);
+
+/**
+ * Selecciona el juego de instrucciones de los kernels de mezcla y de la
+ * interpolacin bilineal del zoom y la rotacin con suavizado.
+ * Por defecto se usa el mejor que soporte la CPU. Si el indicado no est
+ * disponible se usa el mejor de los inferiores. Todos los kernels producen
+ * exactamente el mismo resultado.
+ * @param Level Juego de instrucciones (CRE_GFX_SIMD_*)
+ * @return Juego de instrucciones seleccionado.
+ **/
+extern int CRE_GfxSetSIMD(int Level);
+
+/**
+ * Selecciona el mejor juego de instrucciones si todava no se ha elegido
+ * ninguno. Las funciones de grficos lo hacen la primera vez que lo
+ * necesitan; antes de usarlas desde varios hilos hay que llamarla para que
+ * no lo hagan a la vez.
+ **/
+extern void CRE_GfxInitSIMD(void);
+
 /**
  * Aplica a un grfico un zoom y una rotacin.
  * @author A. Schiffler
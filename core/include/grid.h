@@ -0,0 +1,177 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file grid.h
+ * Rejilla de ocupacin por tiles. Los procesos se registran en la casilla en
+ * la que estn y la actualizan al moverse, de modo que saber quin hay en una
+ * casilla, o cerca de ella, no depende del nmero de procesos. Al entrar en
+ * una casilla se avisa, mediante una funcin, a los procesos que ya estaban en
+ * ella y al que entra.
+ **/
+
+
+#ifndef CORE_GRID_H
+#define CORE_GRID_H
+
+#include <SDL/SDL.h>
+#include "process.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/** Nmero mximo de procesos a los que se avisa al entrar en una casilla */
+#ifndef CRE_GRID_TOUCHES
+    #define CRE_GRID_TOUCHES 32
+#endif
+
+
+/*
+ * Definicin de tipos
+ */
+
+/**
+ * Funcin a la que se llama cuando dos procesos coinciden en una casilla
+ * porque uno de ellos ha entrado en ella. This es el proceso registrado con
+ * la funcin y Other el otro.
+ **/
+typedef void (* creGridTouch)(creProcess * This, creProcess * Other);
+
+/**
+ * Entrada de un proceso en la rejilla
+ **/
+typedef struct creGridEntry {
+    /** Proceso y su Id (0 si la entrada est libre) */
+    creProcess * Process;
+    Uint32 Id;
+    /** Casilla en la que est */
+    Sint32 X, Y;
+    /** Enlaces de la lista de su casilla, o de la lista de entradas libres */
+    Sint32 Prev, Next;
+    /** Funcin a la que se avisa al coincidir con otro proceso, o NULL */
+    creGridTouch Touch;
+} creGridEntry;
+
+/**
+ * Rejilla de ocupacin
+ **/
+typedef struct creGrid {
+    /** Ancho y alto (en casillas) */
+    Sint32 W, H;
+    /** Primera entrada de cada casilla (-1 si est vaca), por filas */
+    Sint32 * Cells;
+    /** Entradas, su nmero y la primera libre (-1 si no hay) */
+    creGridEntry * Entries;
+    Uint32 Size;
+    Sint32 FreeFirst;
+} creGrid;
+
+
+/*
+ * Declaracin de funciones
+ */
+
+/**
+ * @brief Crea una rejilla de ocupacin vaca
+ * @param W Ancho en casillas
+ * @param H Alto en casillas
+ * @return La rejilla, o NULL si ha ocurrido algn error.
+ **/
+extern creGrid * CRE_NewGrid(Sint32 W, Sint32 H);
+
+/**
+ * @brief Elimina una rejilla de ocupacin
+ * @param Grid Rejilla a eliminar
+ **/
+extern void CRE_FreeGrid(creGrid * Grid);
+
+/**
+ * @brief Registra un proceso en una casilla
+ * @param Grid Rejilla
+ * @param Process Proceso a registrar
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @param Touch Funcin a la que avisar al coincidir con otro proceso, o NULL
+ * El proceso entra en la casilla, por lo que se avisa a los que ya estaban.
+ * @return Entrada del proceso en la rejilla, o -1 si ha ocurrido algn error.
+ **/
+extern Sint32 CRE_GridAdd(creGrid * Grid, creProcess * Process, Sint32 X,
+    Sint32 Y, creGridTouch Touch);
+
+/**
+ * @brief Mueve un proceso registrado a otra casilla
+ * @param Grid Rejilla
+ * @param Entry Entrada devuelta por CRE_GridAdd
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * Si la casilla es la misma no hace nada; si no, se avisa a los procesos que
+ * ya estaban en la nueva casilla y al que entra.
+ * @return 0 si todo ha sido correcto, -1 en caso contrario.
+ **/
+extern Sint32 CRE_GridMove(creGrid * Grid, Sint32 Entry, Sint32 X, Sint32 Y);
+
+/**
+ * @brief Avisa de nuevo a los procesos que coinciden con uno
+ * @param Grid Rejilla
+ * @param Entry Entrada devuelta por CRE_GridAdd
+ * Como si el proceso acabara de entrar en su casilla. Sirve cuando cambia algo
+ * que decide qu ocurre al coincidir (por ejemplo, el fin de una
+ * invulnerabilidad).
+ **/
+extern void CRE_GridTouch(creGrid * Grid, Sint32 Entry);
+
+/**
+ * @brief Quita un proceso de la rejilla
+ * @param Grid Rejilla
+ * @param Entry Entrada devuelta por CRE_GridAdd
+ **/
+extern void CRE_GridRemove(creGrid * Grid, Sint32 Entry);
+
+/**
+ * @brief Busca los procesos que hay en una casilla
+ * @param Grid Rejilla
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @param Out Vector donde dejar los procesos encontrados
+ * @param Max Tamao de Out
+ * No se cuentan los procesos muertos.
+ * @return Nmero de procesos en la casilla (puede ser mayor que Max).
+ **/
+extern Uint32 CRE_GridAt(creGrid * Grid, Sint32 X, Sint32 Y,
+    creProcess ** Out, Uint32 Max);
+
+/**
+ * @brief Busca los procesos que hay cerca de una casilla
+ * @param Grid Rejilla
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @param R Distancia mxima en casillas (distancia eucldea)
+ * @param Out Vector donde dejar los procesos encontrados
+ * @param Max Tamao de Out
+ * Solo se recorren las casillas del cuadrado de lado 2R + 1. No se cuentan
+ * los procesos muertos.
+ * @return Nmero de procesos encontrados (puede ser mayor que Max).
+ **/
+extern Uint32 CRE_GridNear(creGrid * Grid, Sint32 X, Sint32 Y, Sint32 R,
+    creProcess ** Out, Uint32 Max);
+
+#endif
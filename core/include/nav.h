@@ -0,0 +1,323 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file nav.h
+ * Navegacin sobre escenarios de tiles. Guarda qu agentes pueden pasar por
+ * cada casilla y calcula, por bsqueda en anchura, campos de distancias hacia
+ * un objetivo. Un campo solo se recalcula cuando cambia su objetivo o el
+ * mapa, de modo que todos los agentes que lo consultan deciden su siguiente
+ * paso con una consulta de coste constante. Para caminos concretos entre dos
+ * casillas hay bsqueda A* con saltos (jump point search), que no reserva
+ * memoria en cada consulta y puede resolver lotes de consultas en paralelo.
+ **/
+
+
+#ifndef CORE_NAV_H
+#define CORE_NAV_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Direcciones de movimiento (se pueden combinar) */
+/** Ninguna */
+#define CRE_NAV_NONE  0x00
+/** Izquierda */
+#define CRE_NAV_LEFT  0x01
+/** Derecha */
+#define CRE_NAV_RIGHT 0x02
+/** Arriba */
+#define CRE_NAV_UP    0x04
+/** Abajo */
+#define CRE_NAV_DOWN  0x08
+
+/** Distancia de las casillas desde las que no se llega al objetivo */
+#define CRE_NAV_FAR 0xFFFF
+
+/* Opciones de bsqueda de caminos (se pueden combinar) */
+/** A* casilla a casilla, sin saltos */
+#define CRE_PATH_PLAIN   0x01
+/** Si no se llega al destino, camino a la casilla alcanzable ms cercana */
+#define CRE_PATH_NEAREST 0x02
+
+/** Nmero mximo de hilos de un grupo de bsqueda */
+#ifndef CRE_NAV_THREADS
+    #define CRE_NAV_THREADS 16
+#endif
+
+
+/*
+ * Definicin de tipos
+ */
+
+/**
+ * Mapa de navegacin de un escenario
+ **/
+typedef struct creNavMap {
+    /** Ancho y alto (en casillas) */
+    Sint32 W, H;
+    /** Agentes que pueden pasar por cada casilla (un bit por tipo), por filas */
+    Uint8 * Cells;
+    /** Versin del mapa, cambia cada vez que se modifica una casilla */
+    Uint32 Version;
+} creNavMap;
+
+/**
+ * Campo de distancias hacia un objetivo para un tipo de agente
+ **/
+typedef struct creNavField {
+    /** Mapa sobre el que se calcula */
+    creNavMap * Map;
+    /** Agentes para los que se calcula */
+    Uint8 Agents;
+    /** Casilla objetivo (-1 si no tiene) */
+    Sint32 X, Y;
+    /** Versin del mapa con la que se calcul, y si hay que recalcularlo */
+    Uint32 Version;
+    Uint8 Dirty;
+    /** Distancia de cada casilla al objetivo, en pasos */
+    Uint16 * Dist;
+    /** Cola de la bsqueda en anchura */
+    Sint32 * Queue;
+} creNavField;
+
+/**
+ * Memoria de trabajo de la bsqueda de caminos sobre un mapa. Se reserva una
+ * vez y se reutiliza en cada consulta; no se puede usar desde dos hilos a la
+ * vez.
+ **/
+typedef struct creNavSearch {
+    /** Mapa sobre el que se busca */
+    creNavMap * Map;
+    /** Marca de la consulta actual (evita limpiar los vectores en cada una) */
+    Uint32 Stamp;
+    /** Marca de cada casilla (Stamp abierta, Stamp + 1 cerrada) */
+    Uint32 * Marks;
+    /** Coste desde el origen y coste estimado total de cada casilla */
+    Uint32 * G, * F;
+    /** Casilla desde la que se llega a cada casilla */
+    Sint32 * Parent;
+    /** Montculo de casillas abiertas y posicin de cada casilla en l */
+    Sint32 * Heap, * HeapPos;
+    Sint32 HeapCount;
+} creNavSearch;
+
+/**
+ * Consulta de un lote de bsquedas de caminos
+ **/
+typedef struct creNavQuery {
+    /** Tipo de agente y opciones (CRE_PATH_*) */
+    Uint8 Agents, Flags;
+    /** Casillas de origen y de destino */
+    Sint32 FromX, FromY, ToX, ToY;
+    /** Vector en el que se escribe el camino y su tamao */
+    Sint32 * Path;
+    Sint32 MaxPath;
+    /** Resultado, como el de CRE_PathFind */
+    Sint32 Result;
+} creNavQuery;
+
+/**
+ * Grupo de hilos para resolver lotes de bsquedas de caminos
+ **/
+typedef struct creNavPool {
+    /** Mapa sobre el que se busca */
+    creNavMap * Map;
+    /** Hilos de trabajo */
+    SDL_Thread * Threads[CRE_NAV_THREADS];
+    /** Nmero de hilos, y de los que ya han arrancado */
+    Sint32 ThreadCount, Started;
+    /** Memoria de trabajo de cada hilo, ms la del hilo que pide el lote */
+    creNavSearch * Searches[CRE_NAV_THREADS + 1];
+    /** Sincronizacin del lote */
+    SDL_mutex * Lock;
+    SDL_cond * Work, * Done;
+    /** Lote actual: consultas, siguiente libre y pendientes de acabar */
+    creNavQuery * Queries;
+    Sint32 Count, Next, Pending;
+    /** Indica a los hilos que deben terminar */
+    Uint8 Quit;
+} creNavPool;
+
+
+/*
+ * Declaracin de funciones
+ */
+
+/**
+ * @brief Crea el mapa de navegacin de un escenario
+ * @param W Ancho del escenario (en tiles)
+ * @param H Alto del escenario (en tiles)
+ * @param Tiles Tiles del escenario, por filas (como en creMSc)
+ * @param Masks Agentes que pueden pasar por cada identificador de tile (256
+ * valores, uno por identificador)
+ * @return El mapa, o NULL si ha ocurrido algn error.
+ **/
+extern creNavMap * CRE_NewNavMap(Sint32 W, Sint32 H, const char * Tiles,
+    const Uint8 * Masks);
+
+/**
+ * @brief Elimina un mapa de navegacin
+ * @param Map Mapa a eliminar
+ **/
+extern void CRE_FreeNavMap(creNavMap * Map);
+
+/**
+ * @brief Cambia qu agentes pueden pasar por una casilla
+ * @param Map Mapa de navegacin
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @param Agents Agentes que pueden pasar
+ * Los campos de distancias del mapa se recalcularn al consultarlos.
+ **/
+extern void CRE_NavSetCell(creNavMap * Map, Sint32 X, Sint32 Y, Uint8 Agents);
+
+/**
+ * @brief Indica si un agente puede pasar por una casilla
+ * @param Map Mapa de navegacin
+ * @param Agents Tipo de agente
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @return 1 si puede pasar, 0 si no o si la casilla est fuera del mapa.
+ **/
+extern Uint8 CRE_NavWalkable(creNavMap * Map, Uint8 Agents, Sint32 X,
+    Sint32 Y);
+
+/**
+ * @brief Direcciones en las que un agente puede moverse desde una casilla
+ * @param Map Mapa de navegacin
+ * @param Agents Tipo de agente
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @return Combinacin de CRE_NAV_LEFT, CRE_NAV_RIGHT, CRE_NAV_UP y
+ * CRE_NAV_DOWN. Los bordes del mapa no se pueden cruzar.
+ **/
+extern Uint8 CRE_NavMoves(creNavMap * Map, Uint8 Agents, Sint32 X, Sint32 Y);
+
+/**
+ * @brief Crea un campo de distancias, an sin objetivo
+ * @param Map Mapa de navegacin
+ * @param Agents Tipo de agente para el que se calcula
+ * @return El campo, o NULL si ha ocurrido algn error.
+ **/
+extern creNavField * CRE_NewNavField(creNavMap * Map, Uint8 Agents);
+
+/**
+ * @brief Elimina un campo de distancias
+ * @param Field Campo a eliminar
+ **/
+extern void CRE_FreeNavField(creNavField * Field);
+
+/**
+ * @brief Cambia el objetivo de un campo de distancias
+ * @param Field Campo
+ * @param X Columna del objetivo
+ * @param Y Fila del objetivo
+ * Si el objetivo no cambia no hace nada; si cambia, el campo se recalcula al
+ * consultarlo por primera vez.
+ **/
+extern void CRE_NavSetTarget(creNavField * Field, Sint32 X, Sint32 Y);
+
+/**
+ * @brief Distancia de una casilla al objetivo de un campo
+ * @param Field Campo
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @return Nmero de pasos, o CRE_NAV_FAR si no se puede llegar.
+ **/
+extern Uint16 CRE_NavDistance(creNavField * Field, Sint32 X, Sint32 Y);
+
+/**
+ * @brief Mejores direcciones para acercarse o alejarse del objetivo
+ * @param Field Campo
+ * @param X Columna de la casilla
+ * @param Y Fila de la casilla
+ * @param Flee 0 para acercarse al objetivo, 1 para alejarse
+ * @return Combinacin de las direcciones que llevan a las casillas vecinas
+ * ms cercanas (o ms lejanas) al objetivo, o CRE_NAV_NONE si desde la
+ * casilla no se llega al objetivo.
+ **/
+extern Uint8 CRE_NavBest(creNavField * Field, Sint32 X, Sint32 Y, Uint8 Flee);
+
+/**
+ * @brief Crea la memoria de trabajo para buscar caminos en un mapa
+ * @param Map Mapa de navegacin
+ * @return La memoria de trabajo, o NULL si ha ocurrido algn error.
+ **/
+extern creNavSearch * CRE_NewNavSearch(creNavMap * Map);
+
+/**
+ * @brief Elimina la memoria de trabajo de bsqueda de caminos
+ * @param Search Memoria de trabajo a eliminar
+ **/
+extern void CRE_FreeNavSearch(creNavSearch * Search);
+
+/**
+ * @brief Busca el camino ms corto entre dos casillas
+ * @param Search Memoria de trabajo (indica tambin el mapa)
+ * @param Agents Tipo de agente
+ * @param FromX Columna de origen
+ * @param FromY Fila de origen
+ * @param ToX Columna de destino
+ * @param ToY Fila de destino
+ * @param Flags Opciones (CRE_PATH_*)
+ * @param Path Vector en el que se escriben las casillas del camino, sin el
+ * origen y con el destino, como X + Y * W. Puede ser NULL.
+ * @param MaxPath Tamao de Path. Si el camino es ms largo se escriben solo
+ * sus primeros pasos.
+ * @return Nmero de pasos del camino, o -1 si no hay camino.
+ **/
+extern Sint32 CRE_PathFind(creNavSearch * Search, Uint8 Agents, Sint32 FromX,
+    Sint32 FromY, Sint32 ToX, Sint32 ToY, Uint8 Flags, Sint32 * Path,
+    Sint32 MaxPath);
+
+/**
+ * @brief Crea un grupo de hilos para buscar caminos en un mapa
+ * @param Map Mapa de navegacin
+ * @param Threads Nmero de hilos de trabajo (como mximo CRE_NAV_THREADS). Con
+ * 0 los lotes se resuelven en el hilo que los pide.
+ * @return El grupo, o NULL si ha ocurrido algn error.
+ **/
+extern creNavPool * CRE_NewNavPool(creNavMap * Map, Sint32 Threads);
+
+/**
+ * @brief Elimina un grupo de hilos, esperando a que terminen
+ * @param Pool Grupo a eliminar
+ **/
+extern void CRE_FreeNavPool(creNavPool * Pool);
+
+/**
+ * @brief Resuelve un lote de bsquedas de caminos
+ * @param Pool Grupo de hilos
+ * @param Queries Consultas; el resultado de cada una queda en su campo Result
+ * @param Count Nmero de consultas
+ * Las consultas se reparten entre los hilos del grupo y el hilo que llama,
+ * que no vuelve hasta que se han resuelto todas. El mapa no debe cambiar
+ * mientras tanto.
+ **/
+extern void CRE_PathFindBatch(creNavPool * Pool, creNavQuery * Queries,
+    Sint32 Count);
+
+#endif
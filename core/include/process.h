@@ -48,6 +48,32 @@
     #define CRE_PROCESS_DEBUG_FILE stdout
 #endif
 
+/**
+ * Tiempo (en nanosegundos) antes de cada frame que el bucle espera activamente
+ * en lugar de dormir, ya que SDL_Delay solo garantiza milisegundos.
+ **/
+#ifndef CRE_SPIN_TIME
+    #define CRE_SPIN_TIME 2000000
+#endif
+
+/**
+ * Nmero mximo de pasos de simulacin que se ejecutan antes de dibujar un
+ * frame en el modo CRE_TIMESTEP_FIXED. Si el bucle se retrasa ms, se descarta
+ * el tiempo pendiente.
+ **/
+#ifndef CRE_MAX_STEPS
+    #define CRE_MAX_STEPS 5
+#endif
+
+/* Modos de control de la velocidad del bucle de procesos */
+/** Un paso de simulacin por frame; si un frame tarda ms, el juego se frena */
+#define CRE_TIMESTEP_VARIABLE 0
+/**
+ * Pasos de simulacin de duracin fija: si un frame tarda ms, se ejecutan
+ * varios pasos antes de dibujar el siguiente para recuperar el tiempo.
+ **/
+#define CRE_TIMESTEP_FIXED    1
+
 /* Definicin de los estados de un proceso */
 /** El proceso se recuper de cualquier estado temporal anterior */
 #define CRE_PS_WAKEUP  0x80
@@ -80,20 +106,45 @@
  * Definicin de tipos
  */
 
+/**
+ * Estado con el que se dibuj un proceso en el ltimo frame. Lo utiliza el
+ * modo de rectngulos sucios para saber qu procesos han cambiado.
+ **/
+typedef struct creDrawState {
+    /** Grfico, posicin en pantalla y transformacin con las que se dibuj */
+    SDL_Surface * Graph;
+    Sint32 X, Y, Angle;
+    Sint16 SizeW, SizeH;
+    Uint8 Z, Alpha, Blend;
+    /** Flags de estado que afectan al dibujado (GHOST, FREEZE, HIGHGFX) */
+    Uint8 State;
+    /** Zona de pantalla que ocup el proceso (w = 0 si no se dibuj) */
+    SDL_Rect Rect;
+} creDrawState;
+
 /**
  * Estructura que define un proceso.
  **/
 typedef struct creProcess {
     /* Informacin de gestin interna */
-    /** Identificador nico del proceso (Asignado automaticamente) */
+    /**
+     * Identificador nico del proceso (Asignado automaticamente). Es un
+     * manejador: los bits bajos indican su entrada en la tabla de procesos y
+     * los altos su generacin, de modo que el Id de un proceso eliminado no
+     * vuelve a ser vlido aunque su entrada se reutilice.
+     **/
     Uint32 Id;
-    /** Tipo de proceso (Valor opcional) */
+    /** Tipo de proceso (Valor opcional, no debe cambiar tras aadirlo) */
     Uint16 Type;
     /** Flags que indican el estado en el que se encuentra un proceso */
     Uint8 State;
     /** Cadena opcional que identifica al proceso */
     char * Info;
-    /** Puntero al siguiente proceso (Lista enlaz.) */
+    /**
+     * Sin uso: los procesos se guardan en capas segn su Z. Se conserva para
+     * no alterar el orden de los campos. Para recorrer los procesos debe
+     * usarse CRE_FirstProcess y CRE_NextProcess.
+     **/
     struct creProcess * Next;
     /** Mtodo de inicio de una instancia */
     struct creProcess * (* New)(/* ... */);
@@ -117,8 +168,52 @@ typedef struct creProcess {
     /* Informacin de ca instancia */
     /** Puntero de uso general para la informacin propia de cada proceso */
     void * Data;
+    /** Modo de mezcla con el que se dibuja el grfico (CRE_GFX_BLEND_*) */
+    Uint8 Blend;
+    /* Informacin interna del core (no debe modificarse) */
+    /** ltima entrada de la cach de lienzos usada por el proceso (+1) */
+    Uint32 Canvas;
+    /** Estado con el que se dibuj el proceso en el ltimo frame */
+    creDrawState Drawn;
+    /** Capa de Z en la que est guardado y posicin dentro de ella */
+    Uint8 Layer;
+    Uint32 Slot;
+    /** ltima pasada del bucle en la que se ejecut */
+    Uint32 Pass;
+    /** Enlaces de la lista de procesos del mismo tipo */
+    struct creProcess * TypePrev, * TypeNext;
+    /** Tamao de bloque del almacn del que se reserv (0 si no es de uno) */
+    Uint8 Pool;
 } creProcess;
 
+/**
+ * Funcin que se aplica a cada proceso en los recorridos por tipo.
+ * @see CRE_ForEachOfType
+ **/
+typedef void (* creProcessFunc)(creProcess * Process, void * Arg);
+
+/**
+ * Funcin que entrega los eventos de cada frame en lugar de SDL_PollEvent.
+ * Escribe como mximo Max eventos en Events y devuelve cuntos ha escrito.
+ * @see CRE_SetEventSource
+ **/
+typedef Uint32 (* creEventSource)(SDL_Event * Events, Uint32 Max,
+    void * Arg);
+
+/**
+ * Funcin que libera los datos propios de un mundo al liberarlo.
+ * @see CRE_SetWorldData
+ **/
+typedef void (* creDataFree)(void * Data);
+
+/**
+ * Funcin de entrada de cada mundo de CRE_RunWorlds. Se llama con el mundo
+ * ya actual y puede crear sus procesos y lanzar su bucle una o varias veces.
+ * Index es la posicin del mundo en la lista y Arg el de CRE_RunWorlds.
+ * @see CRE_RunWorlds
+ **/
+typedef void (* creWorldEntry)(Uint32 Index, void * Arg);
+
 /**
  * Estructura que define una lista de eventos
  **/
@@ -131,15 +226,25 @@ typedef struct creEventsList {
     SDL_Event Events[CRE_MAX_SIM_EVENTS];
 } creEventsList;
 
+/**
+ * Mundo de procesos. Guarda todo el estado del bucle: los procesos y sus
+ * capas, la tabla de Ids, los almacenes de memoria, los eventos, la pantalla,
+ * la velocidad, el reloj virtual y el generador de nmeros aleatorios con la
+ * grabacin. Cada hilo trabaja con su mundo actual, que al empezar es el
+ * mundo por defecto; las funciones de procesos actan siempre sobre l.
+ * @see CRE_NewWorld, CRE_SetWorld, CRE_RunWorlds
+ **/
+typedef struct creWorld creWorld;
+
 
 /*
  * Variables globales
  */
 
-/** Puntero a pantalla usado por los procesos */
-extern SDL_Surface * creScreen;
+/** Puntero a pantalla usado por los procesos (del mundo actual) */
+#define creScreen (*CRE_WorldScreen())
 /** Estrucutra que contiene en cada momento los eventos procesado en un frame */
-extern creEventsList creEList;
+#define creEList (*CRE_WorldEvents())
 
 
 /*
@@ -167,10 +272,11 @@ extern Sint32 CRE_EndLoop(void);
  * @brief Establece los FPS del bucle principal
  * @param FPS Nmero de frames por segundo
  * Establece la velocidad del bucle principal en FPS (Frames per second). El
- * valor mximo notable depende del hardware de cada equipo, aunque tericamente
- * nunca se podr superar los 1000 fps. Si se le pasa como parmetro 0, el bucle
- * ir lo ms rpido posible que le permita el hardware.
- * @see CRE_GetFPS
+ * valor mximo notable depende del hardware de cada equipo. La duracin de
+ * cada frame se mide en nanosegundos, por lo que no se redondea a
+ * milisegundos. Si se le pasa como parmetro 0, el bucle ir lo ms rpido
+ * posible que le permita el hardware.
+ * @see CRE_GetFPS, CRE_SetTimestep
  **/
 extern void CRE_SetFPS(Uint32 FPS);
 
@@ -183,6 +289,187 @@ extern void CRE_SetFPS(Uint32 FPS);
  **/
 extern float CRE_GetFPS(void);
 
+/**
+ * @brief Selecciona el modo de control de la velocidad del bucle
+ * @param Mode CRE_TIMESTEP_VARIABLE o CRE_TIMESTEP_FIXED
+ * En ambos modos los frames se espacian con un reloj de alta resolucin,
+ * durmiendo y esperando activamente los ltimos CRE_SPIN_TIME nanosegundos.
+ * En el modo fijo cada frame acumula el tiempo transcurrido y ejecuta los
+ * mtodos loop una vez por cada paso de 1/FPS segundos acumulado, pero dibuja
+ * una sola vez. Los eventos solo se entregan en el primer paso del frame.
+ * @see CRE_SetFPS
+ **/
+extern void CRE_SetTimestep(Uint8 Mode);
+
+/**
+ * @brief Devuelve el modo de control de la velocidad del bucle
+ * @return CRE_TIMESTEP_VARIABLE o CRE_TIMESTEP_FIXED
+ **/
+extern Uint8 CRE_GetTimestep(void);
+
+/**
+ * @brief Reloj de alta resolucin
+ * @return Tiempo montono en nanosegundos. Solo tiene sentido la diferencia
+ * entre dos valores.
+ **/
+extern Uint64 CRE_GetTime(void);
+
+/**
+ * @brief Espera hasta un instante dado
+ * @param Time Instante, en el reloj de CRE_GetTime, hasta el que se espera
+ * Duerme mientras falten ms de CRE_SPIN_TIME nanosegundos y espera
+ * activamente el resto.
+ **/
+extern void CRE_WaitUntil(Uint64 Time);
+
+/**
+ * @brief Activa o desactiva el modo sin pantalla
+ * @param Enable 1 para activarlo, 0 para desactivarlo
+ * En este modo el bucle de procesos funciona sin creScreen: ejecuta los
+ * mtodos loop, pero no transforma, dibuja ni actualiza la pantalla, y no
+ * espera entre frames, de modo que cada vuelta del bucle es un paso de
+ * simulacin. Sin una fuente de eventos (CRE_SetEventSource) los procesos no
+ * reciben ninguno. No debe cambiarse con un bucle en marcha.
+ **/
+extern void CRE_SetHeadless(Uint8 Enable);
+
+/**
+ * @brief Indica si est activo el modo sin pantalla
+ * @return 1 si lo est, 0 en caso contrario.
+ **/
+extern Uint8 CRE_IsHeadless(void);
+
+/**
+ * @brief Cambia el origen de los eventos del bucle de procesos
+ * @param Source Funcin que entrega los eventos de cada frame, o NULL para
+ * volver a SDL_PollEvent
+ * @param Arg Argumento que se pasa a la funcin
+ * Sirve para guiar partidas con eventos guionizados. La funcin puede acabar
+ * el bucle con CRE_EndLoop.
+ **/
+extern void CRE_SetEventSource(creEventSource Source, void * Arg);
+
+/**
+ * @brief Reloj virtual del bucle de procesos
+ * @return Milisegundos simulados. El reloj avanza 1/FPS segundos en cada paso
+ * del bucle (el tiempo real transcurrido si no hay lmite de FPS) y no avanza
+ * fuera de l, de modo que los procesos deben usarlo en lugar de
+ * SDL_GetTicks para que las partidas sean reproducibles.
+ **/
+extern Uint32 CRE_GetTicks(void);
+
+/**
+ * @brief Cambia el reloj virtual del bucle de procesos
+ * @param Ticks Milisegundos simulados
+ **/
+extern void CRE_SetTicks(Uint32 Ticks);
+
+/**
+ * @brief Duracin de un paso del bucle
+ * @return Nanosegundos por paso, o 0 si no hay lmite de FPS.
+ **/
+extern Uint64 CRE_GetStepTime(void);
+
+/**
+ * @brief Activa o desactiva el avance rpido
+ * @param Enable 1 para activarlo, 0 para desactivarlo
+ * Con el avance rpido el bucle dibuja como siempre pero no espera entre
+ * frames, y ejecuta un solo paso en cada uno. El reloj virtual sigue
+ * avanzando 1/FPS segundos por paso.
+ **/
+extern void CRE_SetFastForward(Uint8 Enable);
+
+/**
+ * @brief Crea un mundo de procesos vaco
+ * Empieza sin procesos, sin pantalla, sin lmite de FPS y con la semilla por
+ * defecto. Para usarlo hay que hacerlo actual con CRE_SetWorld.
+ * @return El nuevo mundo, o NULL si no hay memoria.
+ **/
+extern creWorld * CRE_NewWorld(void);
+
+/**
+ * @brief Libera un mundo de procesos
+ * @param World Mundo a liberar, que no debe tener un bucle en marcha ni ser
+ * el actual de ningn hilo
+ * Libera los procesos que queden en l (con su mtodo Free), sus tablas y
+ * sus almacenes, y cierra su grabacin o reproduccin.
+ **/
+extern void CRE_FreeWorld(creWorld * World);
+
+/**
+ * @brief Cambia el mundo actual del hilo que la llama
+ * @param World Mundo sobre el que actan a partir de ahora las funciones de
+ * procesos en este hilo, o NULL para volver al mundo por defecto
+ * Los procesos solo deben crearse, liberarse y consultarse con su mundo
+ * como actual.
+ **/
+extern void CRE_SetWorld(creWorld * World);
+
+/**
+ * @brief Devuelve el mundo actual del hilo que la llama
+ * @return El mundo actual.
+ **/
+extern creWorld * CRE_GetWorld(void);
+
+/**
+ * @brief Asocia datos propios del juego al mundo actual
+ * @param Data Datos del mundo, o NULL para quitarlos
+ * @param Free Funcin que los libera con el mundo, o NULL si no hay que
+ * liberarlos
+ * Sirve para que el estado global de un juego sea de cada mundo. CRE_FreeWorld
+ * llama a Free despus de liberar los procesos, que pueden usar los datos en
+ * su mtodo Free. Los datos que hubiera antes no se liberan.
+ **/
+extern void CRE_SetWorldData(void * Data, creDataFree Free);
+
+/**
+ * @brief Devuelve los datos propios del juego del mundo actual
+ * @return Los datos, o NULL si no se han asociado.
+ **/
+extern void * CRE_GetWorldData(void);
+
+/**
+ * @brief Indica si el mundo actual es el mundo por defecto
+ * @return 1 si lo es, 0 si es uno creado con CRE_NewWorld.
+ **/
+extern Uint8 CRE_IsDefaultWorld(void);
+
+/**
+ * @brief Ejecuta varios mundos en paralelo
+ * @param Worlds Mundos a ejecutar
+ * @param Count Nmero de mundos
+ * @param Threads Nmero de hilos, 0 o 1 para ejecutarlos en el hilo que
+ * llama
+ * @param Entry Funcin que ejecuta cada mundo, o NULL para lanzar el bucle
+ * de los procesos que ya tenga creados
+ * @param Arg Argumento que se pasa a Entry
+ * Cada hilo toma el siguiente mundo sin ejecutar, lo hace actual y llama a
+ * Entry (o lanza su bucle) hasta que acaba. Solo se ejecutan los mundos en
+ * modo sin pantalla (CRE_SetHeadless), ya que la pantalla y el estado del
+ * dibujado son compartidos; los dems se saltan. El profiler solo mide el
+ * mundo por defecto, as que las marcas de estos mundos no hacen nada, y los
+ * kernels de dibujado se eligen antes de crear los hilos. El mundo actual del
+ * hilo que llama no cambia.
+ * @return Nmero de mundos ejecutados, o -1 si no se han podido crear los
+ * hilos.
+ **/
+extern Sint32 CRE_RunWorlds(creWorld ** Worlds, Uint32 Count, Uint32 Threads,
+    creWorldEntry Entry, void * Arg);
+
+/**
+ * @brief Pantalla del mundo actual
+ * Se usa a travs de creScreen.
+ * @return Puntero a la pantalla del mundo actual.
+ **/
+extern SDL_Surface ** CRE_WorldScreen(void);
+
+/**
+ * @brief Eventos del mundo actual
+ * Se usa a travs de creEList.
+ * @return Puntero a la lista de eventos del frame del mundo actual.
+ **/
+extern creEventsList * CRE_WorldEvents(void);
+
 /**
  * @brief Muestra informacin del estado actual de los procesos en lista.
  * @param out Fichero donde se van a escribir los resultados.
@@ -200,21 +487,58 @@ extern void CRE_GetProcessesInfo(FILE * out);
  * una instancia y no una clase, a la lista de ejecucin de procesos.
  * Normalmente esta funcin es llamanda dentro de los metodos New de los
  * procesos, as, una vez creada la instancia por este mtodo lo aade a la
- * lista.
+ * lista. La lista se guarda en 256 capas, una por valor de Z, por lo que
+ * aadir un proceso, eliminarlo o cambiar su Z no depende del nmero de
+ * procesos. Dentro de una capa se ejecuta primero el ltimo aadido.
  * @return 0 si ha podido se aadido a la lista, -1 si no ha sido posible.
  **/
 extern Sint32 CRE_AddProcess(creProcess * Process);
 
+/**
+ * @brief Reserva una instancia de proceso y sus datos
+ * @param Class Clase de la que se copia la instancia, o NULL
+ * @param DataSize Tamao en bytes de los datos de la instancia
+ * Reserva en un nico bloque la estructura del proceso y, justo tras ella,
+ * sus datos, a los que apunta Data (NULL si DataSize es 0). Ambos se
+ * inicializan a 0 y despus se copia la clase. Los bloques salen de almacenes
+ * de bloques del mismo tamao reservados por tiras, de modo que crear y
+ * eliminar muchos procesos no fragmenta la memoria y los procesos creados
+ * seguidos quedan contiguos. Cuando todos los bloques de un tamao se liberan
+ * el almacn vuelve a empezar desde el principio.
+ * @see CRE_FreeProcess
+ * @return La nueva instancia, o NULL si no hay memoria.
+ **/
+extern creProcess * CRE_AllocProcess(creProcess * Class, Uint32 DataSize);
+
+/**
+ * @brief Libera una instancia reservada con CRE_AllocProcess
+ * @param Process Instancia a liberar, junto con sus datos
+ * Normalmente se llama desde el mtodo Free del proceso.
+ **/
+extern void CRE_FreeProcess(creProcess * Process);
+
 /**
  * @brief Obtiene la estructura del proceso indicado
  * @param Id Identificador del proceso
  * Funcin que es utilizada para, una vez obtenido un id vlido de algn proceso
- * en activo, acceder a su estructura de proceso.
+ * en activo, acceder a su estructura de proceso. El coste no depende del nmero
+ * de procesos. Un proceso muerto se devuelve hasta que el bucle lo elimina;
+ * despus su Id deja de ser vlido.
  * @return Puntero a la estructura de proceso indicada por el id, o NULL si no
  * existe tal proceso.
  **/
 extern creProcess * CRE_GetProcess(Uint32 Id);
 
+/**
+ * @brief Indica si un proceso sigue vivo
+ * @param Id Identificador del proceso
+ * Permite guardar el Id de un proceso en lugar de un puntero a l, que
+ * dejara de ser vlido al eliminarse el proceso.
+ * @return 1 si el proceso existe y no tiene el estado CRE_PS_DEAD, 0 en caso
+ * contrario.
+ **/
+extern Uint8 CRE_IsAlive(Uint32 Id);
+
 /**
  * @brief Aade un estado a un determinado proceso
  * @param Id Identificador del proceso
@@ -232,7 +556,9 @@ extern Sint32 CRE_SetState(Uint32 Id, Uint8 State);
  * @param State Estado a aadir a los procesos
  * Esta funcin busca todos los procesos activos que sean de un determinado
  * tipo y modifica su estado al indicado en el parmetro. Si se usa el tipo 0
- * todos los procesos se le aplican el estado indicado.
+ * todos los procesos se le aplican el estado indicado. Solo se recorren los
+ * procesos del tipo indicado.
+ * @see CRE_ForEachOfType
  * @return 0 si ha encontrado algn proceso del tipo indicado, -1 si no.
  **/
 extern Sint32 CRE_TSetState(Uint16 Type, Uint8 State);
@@ -256,4 +582,41 @@ extern Sint32 CRE_LetPrcsAlone(Uint32 Id);
  **/
 extern void CRE_SetClearColor(Uint8 R, Uint8 G, Uint8 B);
 
+/**
+ * @brief Devuelve el primer proceso de la lista de ejecucin
+ * @return El proceso de menor Z, o NULL si no hay procesos.
+ * @see CRE_NextProcess
+ **/
+extern creProcess * CRE_FirstProcess(void);
+
+/**
+ * @brief Devuelve el siguiente proceso de la lista de ejecucin
+ * @param Process Proceso actual
+ * Recorre los procesos en el orden en que se ejecutan y dibujan, de menor a
+ * mayor Z. Un proceso cuya Z ha cambiado se recoloca después de ejecutarse.
+ * @return El siguiente proceso, o NULL si Process es el ltimo.
+ **/
+extern creProcess * CRE_NextProcess(creProcess * Process);
+
+/**
+ * @brief Aplica una funcin a todos los procesos de un tipo
+ * @param Type Tipo de los procesos, o 0 para todos los procesos
+ * @param Func Funcin que se llama con cada proceso
+ * @param Arg Argumento que se pasa a la funcin
+ * El core guarda una lista de los procesos de cada tipo, de modo que el
+ * coste depende solo del nmero de procesos del tipo. La funcin puede cambiar
+ * el estado de los procesos o crear otros nuevos, que no se recorren, pero no
+ * debe liberarlos.
+ * @return Nmero de procesos a los que se ha aplicado la funcin.
+ **/
+extern Uint32 CRE_ForEachOfType(Uint16 Type, creProcessFunc Func, void * Arg);
+
+/**
+ * @brief Cuenta los procesos de un tipo
+ * @param Type Tipo de los procesos, o 0 para contar todos
+ * Incluye los procesos muertos que el bucle an no ha eliminado.
+ * @return Nmero de procesos del tipo.
+ **/
+extern Uint32 CRE_CountType(Uint16 Type);
+
 #endif
@@ -0,0 +1,151 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file profiler.h
+ * Medicin del tiempo de cada frame del bucle de procesos. Guarda, para los
+ * ltimos frames, el tiempo de cada fase del bucle y el coste de los mtodos
+ * loop y del dibujado de cada tipo de proceso.
+ * Solo se mide el bucle del mundo por defecto; en los dems mundos las marcas
+ * no hacen nada, de modo que CRE_RunWorlds puede usarse con el profiler
+ * activado.
+ **/
+
+
+#ifndef CORE_PROFILER_H
+#define CORE_PROFILER_H
+
+#include <stdio.h>
+#include <SDL/SDL.h>
+
+
+/*
+ * Definicin de macros
+ */
+
+/** Nmero de frames sobre los que se calculan las estadsticas */
+#ifndef CRE_PROFILER_WINDOW
+    #define CRE_PROFILER_WINDOW 256
+#endif
+
+/** Nmero mximo de tipos de proceso distintos que se miden */
+#ifndef CRE_PROFILER_TYPES
+    #define CRE_PROFILER_TYPES 64
+#endif
+
+/** Fichero en el que se vuelcan las medidas al pulsar F12 en modo debug */
+#ifndef CRE_PROFILER_FILE
+    #define CRE_PROFILER_FILE "profile.csv"
+#endif
+
+/* Fases del bucle de procesos */
+/** Recogida de eventos */
+#define CRE_PROF_EVENTS     0
+/** Compactacin de las capas de procesos */
+#define CRE_PROF_REAP       1
+/** Ejecucin de los mtodos loop */
+#define CRE_PROF_LOOP       2
+/** Rotacin y escalado de los grficos */
+#define CRE_PROF_TRANSFORM  3
+/** Dibujado de los procesos y limpieza de zonas */
+#define CRE_PROF_BLIT       4
+/** Actualizacin de la pantalla */
+#define CRE_PROF_FLIP       5
+/** Frame completo, sin contar la espera */
+#define CRE_PROF_FRAME      6
+/** Nmero de fases */
+#define CRE_PROF_PHASES     7
+
+
+/*
+ * Declaracin de funciones
+ */
+
+/**
+ * @brief Activa o desactiva las medidas del bucle de procesos
+ * @param Enable 1 para activarlas, 0 para desactivarlas
+ * Al activarlas se descartan las medidas anteriores. Desactivadas, el coste
+ * para el bucle es una comprobacin por fase.
+ **/
+extern void CRE_EnableProfiler(Uint8 Enable);
+
+/**
+ * @brief Indica si las medidas estn activadas
+ * @return 1 si lo estn, 0 en caso contrario.
+ **/
+extern Uint8 CRE_IsProfilerEnabled(void);
+
+/**
+ * @brief Reloj de alta resolucin
+ * @return Tiempo montono en microsegundos. Solo tiene sentido la diferencia
+ * entre dos valores.
+ **/
+extern Uint32 CRE_ProfilerTime(void);
+
+/**
+ * @brief Inicia la medida de una fase
+ * @return El tiempo actual, o 0 si las medidas estn desactivadas.
+ **/
+extern Uint32 CRE_ProfilerBegin(void);
+
+/**
+ * @brief Termina la medida de una fase
+ * @param Phase Fase a la que se suma el tiempo (CRE_PROF_*)
+ * @param Begin Valor devuelto por CRE_ProfilerBegin o CRE_ProfilerMark
+ * @return El tiempo actual, que sirve como inicio de la fase siguiente.
+ **/
+extern Uint32 CRE_ProfilerMark(Uint8 Phase, Uint32 Begin);
+
+/**
+ * @brief Suma un tiempo al coste de un tipo de proceso
+ * @param Type Tipo del proceso
+ * @param Phase CRE_PROF_LOOP para el mtodo loop, CRE_PROF_BLIT para el
+ * dibujado (incluida la transformacin)
+ * @param Begin Inicio del intervalo
+ * @param End Fin del intervalo
+ **/
+extern void CRE_ProfilerMarkType(Uint16 Type, Uint8 Phase, Uint32 Begin,
+    Uint32 End);
+
+/**
+ * @brief Cierra las medidas del frame actual
+ * Lo utiliza el bucle de procesos al acabar cada frame, antes de esperar.
+ **/
+extern void CRE_ProfilerEndFrame(void);
+
+/**
+ * @brief Escribe un resumen de las medidas
+ * @param out Fichero de salida
+ * Muestra el mnimo, la media y los percentiles 95 y 99 en microsegundos de
+ * cada fase y del coste por frame de cada tipo de proceso.
+ **/
+extern void CRE_ProfilerReport(FILE * out);
+
+/**
+ * @brief Vuelca las medidas a un fichero
+ * @param FileName Nombre del fichero. Si acaba en ".json" se escribe en JSON,
+ * en cualquier otro caso en CSV.
+ * El fichero contiene el resumen estadstico y el tiempo de cada fase en cada
+ * uno de los frames guardados.
+ * @return 0 si se ha escrito el fichero, -1 en caso contrario.
+ **/
+extern Sint32 CRE_ProfilerDump(const char * FileName);
+
+#endif
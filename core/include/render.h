@@ -0,0 +1,267 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file render.h
+ * Funciones de apoyo al dibujado de los procesos. Contiene la cach de lienzos
+ * transformados (rotados y escalados) que utiliza el bucle de procesos y el
+ * modo de dibujado por rectngulos sucios.
+ **/
+
+
+#ifndef CORE_RENDER_H
+#define CORE_RENDER_H
+
+#include <SDL/SDL.h>
+#include "process.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/**
+ * Memoria mxima por defecto (en bytes) que puede ocupar la cach de lienzos.
+ * Puede modificarse en tiempo de ejecucin con CRE_SetCanvasCacheSize.
+ **/
+#ifndef CRE_CANVAS_CACHE_SIZE
+    #define CRE_CANVAS_CACHE_SIZE (4 * 1024 * 1024)
+#endif
+
+/** Nmero mximo de lienzos que puede guardar la cach a la vez */
+#ifndef CRE_CANVAS_CACHE_ENTRIES
+    #define CRE_CANVAS_CACHE_ENTRIES 256
+#endif
+
+/**
+ * Nmero mximo de rectngulos sucios por frame. Si se superan, el frame se
+ * redibuja completo.
+ **/
+#ifndef CRE_MAX_DIRTY_RECTS
+    #define CRE_MAX_DIRTY_RECTS 64
+#endif
+
+/* Modos de dibujado del bucle de procesos */
+/** Cada frame se dibujan todos los procesos y se actualiza toda la pantalla */
+#define CRE_RENDER_FULL  0
+/** Solo se redibujan y actualizan las zonas de pantalla que han cambiado */
+#define CRE_RENDER_DIRTY 1
+/**
+ * Como CRE_RENDER_FULL, pero los procesos se recogen en el almacn de
+ * dibujado durante el bucle y se dibujan todos juntos al final del frame.
+ **/
+#define CRE_RENDER_STORE 2
+
+
+/*
+ * Declaracin de funciones
+ */
+
+/**
+ * @brief Obtiene el lienzo transformado de un proceso
+ * @param Process Proceso del que se quiere obtener el lienzo
+ * Devuelve el grfico del proceso con la rotacin (Angle) y el escalado
+ * (SizeW, SizeH) aplicados. El resultado se guarda en una cach indexada por
+ * (Graph, Angle, SizeW, SizeH, CRE_PS_HIGHGFX), de modo que un proceso cuyo
+ * aspecto no cambia no vuelve a transformar su grfico en cada frame. Cuando
+ * la cach supera su tamao mximo se eliminan los lienzos usados hace ms
+ * tiempo. El lienzo devuelto pertenece a la cach y no debe liberarse.
+ * @return Lienzo del proceso, o NULL si no ha sido posible crearlo.
+ **/
+extern SDL_Surface * CRE_GetCanvas(creProcess * Process);
+
+/**
+ * @brief Establece la memoria mxima de la cach de lienzos
+ * @param Bytes Nmero mximo de bytes de pixels que puede ocupar la cach
+ * Si la cach ocupa ms que el nuevo tamao se eliminan los lienzos menos
+ * usados. Con 0 la cach solo conserva el ltimo lienzo creado.
+ **/
+extern void CRE_SetCanvasCacheSize(Uint32 Bytes);
+
+/**
+ * @brief Elimina de la cach los lienzos de un grfico
+ * @param Graph Grfico original cuyos lienzos deben eliminarse, o NULL para
+ * vaciar la cach completa.
+ * Debe llamarse antes de liberar un grfico que algn proceso haya dibujado
+ * rotado o escalado, ya que la cach identifica los grficos por su direccin.
+ **/
+extern void CRE_FlushCanvasCache(SDL_Surface * Graph);
+
+/**
+ * @brief Precalcula todas las rotaciones de un grfico
+ * @param Graph Grfico a rotar
+ * @param Steps Nmero de rotaciones en una vuelta completa
+ * @param Zoom Escalado (%) con el que se generan las rotaciones
+ * Genera, con el filtro de suavizado, Steps rotaciones equiespaciadas del
+ * grfico indicado. A partir de ese momento, los procesos que dibujen este
+ * grfico con SizeW y SizeH iguales a Zoom utilizarn la rotacin precalculada
+ * ms cercana a su Angle en lugar de transformar el grfico. Est pensado para
+ * grficos que giran continuamente, como los destellos, cuyos ngulos cambian
+ * en cada frame y por tanto nunca se encuentran en la cach de lienzos.
+ * @return 0 si se han generado las rotaciones, -1 en caso contrario.
+ **/
+extern int CRE_PrebakeRotations(SDL_Surface * Graph, Uint32 Steps, Sint16 Zoom);
+
+/**
+ * @brief Elimina las rotaciones precalculadas de un grfico
+ * @param Graph Grfico cuyas rotaciones deben eliminarse, o NULL para
+ * eliminar todas.
+ **/
+extern void CRE_FreeRotations(SDL_Surface * Graph);
+
+/**
+ * @brief Dibuja un proceso en pantalla
+ * @param Process Proceso a dibujar
+ * @param Screen Superficie en la que se dibuja
+ * Dibuja el grfico del proceso, transformado si es necesario, centrado en
+ * (X, Y) menos la posicin de la cmara y con su canal alpha y modo de
+ * mezcla. Respeta el rea de recorte de Screen; si el proceso queda fuera no
+ * se llega a transformar su grfico.
+ * @return 0 si se ha dibujado, -1 si el proceso no tiene nada que dibujar.
+ **/
+extern Sint32 CRE_DrawProcess(creProcess * Process, SDL_Surface * Screen);
+
+/**
+ * @brief Aade un proceso al almacn de dibujado
+ * @param Process Proceso a dibujar
+ * @param Screen Superficie en la que se dibuja el almacn
+ * Guarda el estado de dibujado del proceso (grfico, posicin,
+ * transformacin, transparencia y modo de mezcla) al final del almacn, que
+ * mantiene cada uno de estos campos en un vector contiguo. Los grficos se
+ * guardan como ndices a una tabla con los grficos distintos del frame. Lo
+ * utiliza el bucle de procesos en el modo CRE_RENDER_STORE en lugar de
+ * CRE_DrawProcess.
+ * @return 0 si se ha guardado o dibujado, -1 si no tiene nada que dibujar.
+ **/
+extern Sint32 CRE_StoreProcess(creProcess * Process, SDL_Surface * Screen);
+
+/**
+ * @brief Dibuja y vaca el almacn de dibujado
+ * @param Screen Superficie en la que se dibuja
+ * Descarta de una pasada las entradas que quedan fuera del rea de recorte de
+ * Screen, sin transformar sus grficos, y dibuja el resto en el orden en que
+ * se aadieron recorriendo los vectores del almacn. Las entradas seguidas
+ * sin transformar que comparten grfico, modo de mezcla y transparencia se
+ * dibujan en un solo lote con CRE_GfxBlendBlitBatch.
+ * @see CRE_SetLayerBatching
+ **/
+extern void CRE_RenderStore(SDL_Surface * Screen);
+
+/**
+ * @brief Permite dibujar en cualquier orden los procesos de una capa
+ * @param Z Capa
+ * @param Enable 1 si el orden de los procesos con esta Z no importa, por
+ * ejemplo porque nunca se solapan, 0 para respetarlo (por defecto)
+ * Al dibujar el almacn, las entradas seguidas con el mismo grfico, modo de
+ * mezcla y transparencia se dibujan en un solo lote. En las capas indicadas
+ * las entradas se ordenan antes por grfico, de modo que se forman lotes
+ * aunque los procesos con el mismo grfico no se hayan creado seguidos.
+ **/
+extern void CRE_SetLayerBatching(Uint8 Z, Uint8 Enable);
+
+/**
+ * @brief Vaca el almacn de dibujado sin dibujarlo
+ * Debe usarse si los grficos de las entradas pueden haberse liberado.
+ **/
+extern void CRE_ClearRenderStore(void);
+
+/**
+ * @brief Establece la posicin de la cmara
+ * @param X Coordenada x del mundo que se muestra en la esquina s-i
+ * @param Y Coordenada y del mundo que se muestra en la esquina s-i
+ * Las coordenadas de los procesos son del mundo y se dibujan desplazadas por
+ * la posicin de la cmara, salvo los de las capas fijas. Esto permite
+ * escenarios mayores que la pantalla. Los procesos que quedan fuera de la
+ * pantalla (o del rea de recorte) se descartan con una cota de su tamao
+ * antes de transformar su grfico o dibujarlo. Por defecto la cmara est en
+ * (0, 0).
+ * @see CRE_SetLayerFixed
+ **/
+extern void CRE_SetCamera(Sint32 X, Sint32 Y);
+
+/**
+ * @brief Devuelve la posicin de la cmara
+ * @param X Si no es NULL, recibe la coordenada x
+ * @param Y Si no es NULL, recibe la coordenada y
+ **/
+extern void CRE_GetCamera(Sint32 * X, Sint32 * Y);
+
+/**
+ * @brief Fija a la pantalla los procesos de una capa
+ * @param Z Capa
+ * @param Fixed 1 si sus procesos no se mueven con la cmara (marcadores,
+ * mens...), 0 si lo hacen (por defecto)
+ **/
+extern void CRE_SetLayerFixed(Uint8 Z, Uint8 Fixed);
+
+/**
+ * @brief Selecciona el modo de dibujado del bucle de procesos
+ * @param Mode CRE_RENDER_FULL, CRE_RENDER_DIRTY o CRE_RENDER_STORE
+ * En el modo CRE_RENDER_DIRTY el bucle compara el estado de cada proceso con
+ * el del frame anterior y solo redibuja, en orden de Z, las zonas que ocupaban
+ * antes y ahora los procesos que han cambiado, limpindolas antes con el color
+ * de fondo. La pantalla se presenta con SDL_UpdateRects. Un proceso cuyo
+ * grfico cambia de contenido sin cambiar de direccin debe activar el estado
+ * CRE_PS_CHANGED. Con pantallas de doble buffer se usa siempre CRE_RENDER_FULL.
+ * Las zonas se redibujan a travs del almacn de dibujado, igual que en el
+ * modo CRE_RENDER_STORE.
+ **/
+extern void CRE_SetRenderMode(Uint8 Mode);
+
+/**
+ * @brief Devuelve el modo de dibujado del bucle de procesos
+ * @return CRE_RENDER_FULL, CRE_RENDER_DIRTY o CRE_RENDER_STORE
+ **/
+extern Uint8 CRE_GetRenderMode(void);
+
+/**
+ * @brief Marca una zona de pantalla para redibujarla en el siguiente frame
+ * @param X Coordenada x de la esquina superior izquierda
+ * @param Y Coordenada y de la esquina superior izquierda
+ * @param W Ancho de la zona
+ * @param H Alto de la zona
+ * Solo tiene efecto en el modo CRE_RENDER_DIRTY.
+ **/
+extern void CRE_AddDirtyRect(Sint32 X, Sint32 Y, Sint32 W, Sint32 H);
+
+/**
+ * @brief Marca para redibujar la zona que ocupaba un proceso
+ * @param Process Proceso cuya ltima zona dibujada debe redibujarse
+ * Lo utiliza el bucle de procesos antes de eliminar un proceso.
+ **/
+extern void CRE_DirtyProcess(creProcess * Process);
+
+/**
+ * @brief Fuerza que el siguiente frame se redibuje completo
+ **/
+extern void CRE_RefreshScreen(void);
+
+/**
+ * @brief Dibuja un frame en el modo de rectngulos sucios
+ * @param First Primer proceso de la lista (ordenada por Z)
+ * @param Screen Pantalla
+ * @param Clear Color con el que se limpian las zonas antes de redibujarlas
+ * Lo utiliza el bucle de procesos en lugar de dibujar cada proceso y llamar a
+ * SDL_Flip.
+ **/
+extern void CRE_RenderDirty(creProcess * First, SDL_Surface * Screen,
+    Uint32 Clear);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file replay.h
+ * Reproducibilidad de las partidas. Contiene el generador de nmeros
+ * aleatorios del core, que depende solo de su semilla, y la grabacin y
+ * reproduccin de los eventos que recibe el bucle de procesos en cada paso.
+ * Con la misma semilla, los mismos FPS y el reloj virtual del bucle
+ * (CRE_GetTicks), una partida grabada se repite exactamente.
+ **/
+
+
+#ifndef CORE_REPLAY_H
+#define CORE_REPLAY_H
+
+#include <SDL/SDL.h>
+
+
+/*
+ * Definicin de macros
+ */
+
+/** Identificador de los ficheros de partida grabada */
+#define CRE_REPLAY_MAGIC "CREr"
+
+/** Versin del formato de los ficheros de partida grabada */
+#define CRE_REPLAY_VERSION 1
+
+/** Semilla del generador de nmeros aleatorios si no se inicializa */
+#define CRE_RANDOM_SEED 0x2545F491
+
+
+/*
+ * Definicin de tipos
+ */
+
+/**
+ * Estado del generador y de la grabacin o reproduccin. Cada mundo de
+ * procesos (ver creWorld) tiene el suyo.
+ **/
+typedef struct creReplayState {
+    /** Estado del generador de nmeros aleatorios (nunca 0) */
+    Uint32 Random;
+    /** Ficheros (gzFile) de la grabacin y de la reproduccin en marcha */
+    void * RecordFile, * ReplayFile;
+    /** Pasos grabados y paso del ltimo registro grabado */
+    Uint32 RecordStep, RecordLast;
+    /** Pasos reproducidos, paso del ltimo registro ledo y del siguiente */
+    Uint32 ReplayStep, ReplayLast, ReplayNext;
+    /** Indica si la reproduccin puso el avance rpido */
+    Uint8 ReplayFast;
+} creReplayState;
+
+
+/*
+ * Declaracin de funciones
+ */
+
+/**
+ * @brief Inicializa el generador de nmeros aleatorios
+ * @param Seed Semilla
+ **/
+extern void CRE_SeedRandom(Uint32 Seed);
+
+/**
+ * @brief Nmero aleatorio
+ * @return Un nmero entre 0 y 2^31 - 1, como random().
+ **/
+extern Sint32 CRE_Random(void);
+
+/**
+ * @brief Empieza a grabar los eventos del bucle de procesos
+ * @param FileName Fichero en el que se graba (comprimido con zlib)
+ * @param Seed Semilla con la que se inicializa el generador de nmeros
+ * aleatorios, que tambin se graba
+ * Se graban la semilla, el reloj virtual, la duracin de cada paso y, de cada
+ * paso del bucle con eventos de teclado o de salida, esos eventos. El resto
+ * de eventos no se graban.
+ * @return 0 si se ha podido empezar, -1 en caso contrario.
+ **/
+extern Sint32 CRE_StartRecord(const char * FileName, Uint32 Seed);
+
+/**
+ * @brief Termina la grabacin, si la hay, y cierra su fichero
+ **/
+extern void CRE_StopRecord(void);
+
+/**
+ * @brief Reproduce una partida grabada
+ * @param FileName Fichero de la partida
+ * @param Fast 1 para no esperar entre frames (avance rpido)
+ * Restablece la semilla y el reloj virtual de la grabacin y sustituye los
+ * eventos de SDL por los grabados (ver CRE_SetEventSource). Los FPS deben ser
+ * los mismos con los que se grab. Al acabar la grabacin los eventos vuelven
+ * a llegar de SDL y, si se pidi, se quita el avance rpido. En el modo sin
+ * pantalla no hay otros eventos, as que se acaba el bucle en marcha.
+ * @return 0 si se ha podido empezar, -1 en caso contrario.
+ **/
+extern Sint32 CRE_StartReplay(const char * FileName, Uint8 Fast);
+
+/**
+ * @brief Termina la reproduccin, si la hay
+ * En el modo sin pantalla acaba tambin el bucle de procesos en marcha.
+ **/
+extern void CRE_StopReplay(void);
+
+/**
+ * @brief Indica si se est reproduciendo una partida
+ * @return 1 si se est reproduciendo, 0 en caso contrario.
+ **/
+extern Uint8 CRE_IsReplaying(void);
+
+/**
+ * @brief Graba los eventos de un paso del bucle de procesos
+ * Lo utiliza el bucle de procesos en cada paso, despus de recoger los
+ * eventos. Sin grabacin en marcha no hace nada.
+ **/
+extern void CRE_RecordStep(void);
+
+/**
+ * @brief Estado de reproducibilidad del mundo actual
+ * Lo implementa el bucle de procesos, que guarda un estado por mundo.
+ * @return Puntero al estado del mundo actual del hilo.
+ **/
+extern creReplayState * CRE_WorldReplay(void);
+
+#endif
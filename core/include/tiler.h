@@ -31,10 +31,38 @@
 #include <SDL/SDL.h>
 #include <core.h>
 
+
+/*
+ * Definicin de macros
+ */
+
+/** Lado (en tiles) de los trozos en los que se divide un mapa para dibujarlo */
+#ifndef CRE_TILE_CHUNK
+    #define CRE_TILE_CHUNK 16
+#endif
+
+/** Nmero mximo por defecto de trozos de un mapa construidos a la vez */
+#ifndef CRE_TILE_CHUNKS
+    #define CRE_TILE_CHUNKS 64
+#endif
+
+
 /*
  * Definicin de tipos
  */
 
+/**
+ * Tile animado. Las casillas del mapa con el identificador Tile muestran,
+ * uno tras otro, los grficos Tile, Tile + 1, ..., Tile + Frames - 1 del skin,
+ * cada uno durante Period milisegundos.
+ **/
+typedef struct creTileAnim {
+    /** Primer grfico (el que aparece en el mapa) y nmero de grficos */
+    Uint8 Tile, Frames;
+    /** Duracin de cada grfico en milisegundos */
+    Uint16 Period;
+} creTileAnim;
+
  /**
   * Estructura que contiene la informacin de un escenario de Tiles
   **/
@@ -51,8 +79,72 @@
      char * Map;
      /** Puntos clave del escenario (a tratar por la aplicacin) */
      crePoint * KeyPoints;
+     /** Nmero de tiles animados y su definicin (NULL si no hay) */
+     int AnimCount;
+     creTileAnim * Anims;
  } creMSc;
 
+/**
+ * Trozo de CRE_TILE_CHUNK x CRE_TILE_CHUNK tiles de un mapa
+ **/
+typedef struct creTileChunk {
+    /** Grfico del trozo, NULL si no est construido */
+    SDL_Surface * Surface;
+    /** Enlaces de la lista de trozos construidos, por orden de uso */
+    Sint32 Prev, Next;
+    /** Casillas del trozo con tiles animados (ndice dentro del trozo) */
+    Uint16 * Anims;
+    Uint16 AnimCount;
+} creTileChunk;
+
+/**
+ * Capa de objetos recogibles (estrellas, monedas...) de un mapa de tiles.
+ * Cada casilla guarda el tipo de objeto que hay en ella, de modo que saber si
+ * hay algo que recoger es una sola consulta. Los objetos se dibujan en los
+ * trozos del mapa, sobre su tile, y se animan como los tiles animados.
+ **/
+typedef struct crePickupLayer {
+    /** Tipo de objeto de cada casilla (0 si no hay ninguno), por filas */
+    Uint8 * Items;
+    /** Objetos que quedan en la capa */
+    Uint32 Count;
+    /** Grficos de los objetos */
+    creMGf * Gfxs;
+    /** Grficos de cada tipo de objeto (el tipo n usa Kinds[n - 1]) */
+    creTileAnim * Kinds;
+    Uint32 KindCount;
+    /** Grfico actual de cada tipo y si ha cambiado en el ltimo paso */
+    Uint8 * Frame, * Changed;
+} crePickupLayer;
+
+/**
+ * Mapa de tiles que se dibuja por trozos. Los trozos se construyen al
+ * dibujarse por primera vez y, si hay demasiados, se eliminan los usados
+ * hace ms tiempo.
+ **/
+typedef struct creTileMap {
+    /** Escenario que se dibuja y grficos de su skin */
+    creMSc * MSc;
+    creMGf * Gfxs;
+    /** Nmero de trozos a lo ancho y a lo alto */
+    Sint32 ChunksW, ChunksH;
+    /** Trozos del mapa, por filas */
+    creTileChunk * Chunks;
+    /** Trozos construidos y mximo de ellos */
+    Uint32 Built, MaxBuilt;
+    /** Extremos de la lista de trozos construidos (primero el ms reciente) */
+    Sint32 First, Last;
+    /** Animacin de cada identificador de tile (ndice + 1, 0 si no tiene) */
+    Uint16 AnimOf[256];
+    /** Grfico actual de cada animacin y si ha cambiado en el ltimo paso */
+    Uint8 * AnimFrame, * AnimChanged;
+    /** Capa de objetos recogibles, NULL si no tiene */
+    crePickupLayer * Pickups;
+    /** Zonas de la superficie destino redibujadas en el ltimo paso */
+    SDL_Rect * Changed;
+    Uint32 ChangedCount, ChangedSize;
+} creTileMap;
+
 
 /*
  * Declaracin de funciones
@@ -60,7 +152,8 @@
 
 /**
  * Funcin que dado el nombre de un archivo escenario lo carga en un variable
- * creMSc para poder ser utilizada.
+ * creMSc para poder ser utilizada. La seccin de tiles animados del final del
+ * archivo es opcional; si no est, AnimCount es 0.
  * @brief Carga un escenario, mapa de tiles.
  * @param FileName Ruta y nombre del archivo.
  * @return Puntero al escenario, o NULL si no ha sido posible cargarlo.
@@ -103,4 +196,124 @@ extern int CRE_DrawMScToSurface(creMSc * Src, SDL_Surface * Trg, creMGf * Gfxs);
  **/
 extern SDL_Surface * CRE_DrawMSc(creMSc * Src);
 
+/**
+ * Crea un mapa de tiles que dibuja un escenario por trozos, de modo que la
+ * memoria y el tiempo de carga no dependen del tamao del escenario. No se
+ * construye ningn trozo hasta que se dibuja. En modo sin pantalla
+ * (CRE_SetHeadless) no se cargan los grficos del skin: el mapa guarda el
+ * escenario y su capa de objetos, pero no se puede dibujar.
+ * @brief Crea un mapa de tiles por trozos.
+ * @param Src Escenario a dibujar. Debe existir mientras exista el mapa.
+ * @param MaxChunks Nmero mximo de trozos construidos a la vez, o 0 para
+ * usar CRE_TILE_CHUNKS.
+ * @return El mapa, o NULL si ha ocurrido algn error.
+ **/
+extern creTileMap * CRE_NewTileMap(creMSc * Src, Uint32 MaxChunks);
+
+/**
+ * Libera un mapa de tiles y sus trozos. No libera el escenario.
+ * @brief Elimina un mapa de tiles.
+ * @param Map Mapa a eliminar.
+ **/
+extern void CRE_FreeTileMap(creTileMap * Map);
+
+/**
+ * Dibuja la parte de un mapa de tiles que se ve desde una cmara. El punto
+ * (X, Y) del escenario (en pixels) se dibuja en la esquina s-i de Trg y solo
+ * se dibujan, construyndolos si es necesario, los trozos que tocan el rea
+ * de recorte de Trg. Las zonas fuera del escenario se dejan en negro.
+ * @brief Dibuja la zona visible de un mapa de tiles.
+ * @param Map Mapa a dibujar.
+ * @param Trg Superficie donde dibujar.
+ * @param X Coordenada x de la cmara.
+ * @param Y Coordenada y de la cmara.
+ * @return 0 si todo ha sido correcto, -1 en caso contrario (tambin si el
+ * mapa no tiene grficos).
+ **/
+extern int CRE_DrawTileMap(creTileMap * Map, SDL_Surface * Trg, Sint32 X,
+    Sint32 Y);
+
+/**
+ * Elimina todos los trozos construidos de un mapa de tiles, que se volvern
+ * a construir al dibujarse.
+ * @brief Vaca la cach de trozos de un mapa de tiles.
+ * @param Map Mapa a vaciar.
+ **/
+extern void CRE_FlushTileMap(creTileMap * Map);
+
+/**
+ * Cambia un tile del escenario y, si el trozo que lo contiene est
+ * construido, vuelve a dibujar solo ese tile en l. No redibuja ninguna
+ * superficie en la que ya se haya dibujado el mapa: la aplicacin debe volver
+ * a dibujar esa zona (por ejemplo con CRE_DrawTileMap recortando al tile) y
+ * marcarla para el bucle con CRE_AddDirtyRect.
+ * @brief Cambia un tile de un mapa de tiles.
+ * @param Map Mapa a modificar.
+ * @param X Columna del tile.
+ * @param Y Fila del tile.
+ * @param Tile Identificador del nuevo tile en el skin del escenario.
+ * @return 0 si se ha cambiado el tile, -1 si est fuera del escenario o el
+ * identificador no existe en el skin (sin grficos solo se comprueba que no
+ * sea negativo).
+ **/
+extern int CRE_SetTile(creTileMap * Map, Sint32 X, Sint32 Y, char Tile);
+
+/**
+ * Avanza los tiles animados del escenario al instante indicado. Solo se
+ * recorren las casillas animadas de los trozos construidos, y solo se
+ * redibujan las de las animaciones que cambian de grfico; los trozos sin
+ * construir se dibujarn ya con el grfico actual. Si Trg no es NULL, las
+ * casillas redibujadas que se ven en Trg desde la cmara (X, Y) se copian
+ * tambin a Trg, y sus zonas quedan en Map->Changed para que la aplicacin
+ * las marque con CRE_AddDirtyRect.
+ * @brief Avanza las animaciones de un mapa de tiles.
+ * @param Map Mapa a animar.
+ * @param Time Instante actual en milisegundos.
+ * @param Trg Superficie en la que se ha dibujado el mapa, o NULL.
+ * @param X Coordenada x de la cmara con la que se ha dibujado Trg.
+ * @param Y Coordenada y de la cmara con la que se ha dibujado Trg.
+ * @return Nmero de casillas redibujadas.
+ **/
+extern Uint32 CRE_AnimateTileMap(creTileMap * Map, Uint32 Time,
+    SDL_Surface * Trg, Sint32 X, Sint32 Y);
+
+/**
+ * Crea una capa de objetos recogibles, vaca, y se la asigna a un mapa de
+ * tiles, eliminando la que tuviera. La capa se elimina con el mapa.
+ * @brief Crea la capa de objetos recogibles de un mapa de tiles.
+ * @param Map Mapa al que se asigna la capa.
+ * @param Gfxs Grficos de los objetos. Deben existir mientras exista el mapa.
+ * En modo sin pantalla puede ser NULL; los objetos no se dibujan.
+ * @param Kinds Grficos de cada tipo de objeto: el tipo n (de 1 a KindCount)
+ * se dibuja con los grficos de Kinds[n - 1], animados si tiene ms de uno.
+ * @param KindCount Nmero de tipos de objeto (como mucho 255).
+ * @return La capa, o NULL si ha ocurrido algn error.
+ **/
+extern crePickupLayer * CRE_NewPickupLayer(creTileMap * Map, creMGf * Gfxs,
+    creTileAnim * Kinds, Uint32 KindCount);
+
+/**
+ * Coloca o quita un objeto de una casilla y redibuja la casilla en su trozo
+ * si est construido. Como con CRE_SetTile, la aplicacin debe redibujar esa
+ * zona en las superficies donde ya se haya dibujado el mapa.
+ * @brief Coloca un objeto recogible.
+ * @param Map Mapa con capa de objetos.
+ * @param X Columna de la casilla.
+ * @param Y Fila de la casilla.
+ * @param Item Tipo del objeto, o 0 para quitarlo.
+ * @return 0 si todo ha sido correcto, -1 en caso contrario.
+ **/
+extern int CRE_SetPickup(creTileMap * Map, Sint32 X, Sint32 Y, Uint8 Item);
+
+/**
+ * Recoge el objeto de una casilla, si lo hay: lo quita de la capa y redibuja
+ * la casilla en su trozo como CRE_SetPickup.
+ * @brief Recoge un objeto recogible.
+ * @param Map Mapa con capa de objetos.
+ * @param X Columna de la casilla.
+ * @param Y Fila de la casilla.
+ * @return El tipo del objeto recogido, o 0 si no haba ninguno.
+ **/
+extern Uint8 CRE_TakePickup(creTileMap * Map, Sint32 X, Sint32 Y);
+
 #endif
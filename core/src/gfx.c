@@ -29,31 +29,925 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "core.h"
-
+
+/*
+ * Los kernels SSE2 y AVX2 se compilan con atributos de funcin y se eligen en
+ * tiempo de ejecucin, de modo que no hace falta compilar con -msse2/-mavx2.
+ * Las cabeceras de intrnsecos deben incluirse antes que core.h, que redefine
+ * __inline.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 5) && \
+    (defined(__i386__) || defined(__x86_64__))
+    #define CRE_GFX_X86
+    #include <immintrin.h>
+#endif
+
+#include "core.h"
+
 #define VALUE_LIMIT	0.001
 
+/* Divisin entre 255 redondeada, vlida para 0 <= V <= 255 * 255 */
+#define DIV255(V)	((((V) + 128) + (((V) + 128) >> 8)) >> 8)
+
+
+/*
+ * Kernels de mezcla de 32 bits
+ * Todos los kernels mezclan una fila de Count pixels del origen (Src) sobre el
+ * destino (Dst). El alpha de cada pixel (en Ashift) se escala por el alpha
+ * global y se lleva al rango 0..256, de modo que las divisiones son
+ * desplazamientos y un pixel opaco copia exactamente el origen:
+ *   a = (Alpha' * sa) >> 8, a = a + (a >> 7), con Alpha' = Alpha + (Alpha >> 7)
+ *   Normal:   d = (s * a + d * (256 - a)) >> 8
+ *   Aditivo:  d = min(255, d + ((s * a) >> 8))
+ * Los bits del destino indicados en Keep (alpha y bits sin uso) no cambian.
+ * Las versiones SSE2 y AVX2 calculan con enteros de 16 bits exactamente lo
+ * mismo que las escritas en C, y stas se usan para los pixels sobrantes.
+ */
+
+/*
+ * CRE_GfxOverRow
+ * Mezcla normal sin alpha global
+ */
+void CRE_GfxOverRow(Uint32 * Dst, Uint32 * Src, Sint32 Count, Uint32 Alpha,
+    Uint32 Ashift, Uint32 Keep)
+{
+    Uint32 s, d, a, rb, ag;
+
+    for(; Count > 0; Count--, Dst++, Src++) {
+        s = *Src;
+        a = (s >> Ashift) & 0xff;
+        /* Los pixels totalmente transparentes no modifican el destino */
+        if(a == 0)
+            continue;
+        a += a >> 7;
+        d = *Dst;
+        /* Dos canales por palabra, cada uno en 16 bits */
+        rb = (((s & 0x00ff00ff) * a + (d & 0x00ff00ff) * (256 - a)) >> 8)
+            & 0x00ff00ff;
+        ag = (((s >> 8) & 0x00ff00ff) * a + ((d >> 8) & 0x00ff00ff) * (256 - a))
+            & 0xff00ff00;
+        *Dst = ((rb | ag) & ~Keep) | (d & Keep);
+    }
+}
+
+
+/*
+ * CRE_GfxOverAlphaRow
+ * Mezcla normal con el alpha de cada pixel escalado por el alpha global
+ */
+void CRE_GfxOverAlphaRow(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    Uint32 s, d, a, rb, ag;
+
+    Alpha += Alpha >> 7;
+    for(; Count > 0; Count--, Dst++, Src++) {
+        s = *Src;
+        a = (((s >> Ashift) & 0xff) * Alpha) >> 8;
+        if(a == 0)
+            continue;
+        a += a >> 7;
+        d = *Dst;
+        rb = (((s & 0x00ff00ff) * a + (d & 0x00ff00ff) * (256 - a)) >> 8)
+            & 0x00ff00ff;
+        ag = (((s >> 8) & 0x00ff00ff) * a + ((d >> 8) & 0x00ff00ff) * (256 - a))
+            & 0xff00ff00;
+        *Dst = ((rb | ag) & ~Keep) | (d & Keep);
+    }
+}
+
+
+/*
+ * CRE_GfxAddRow
+ * Mezcla aditiva con saturacin
+ */
+void CRE_GfxAddRow(Uint32 * Dst, Uint32 * Src, Sint32 Count, Uint32 Alpha,
+    Uint32 Ashift, Uint32 Keep)
+{
+    Uint32 s, d, a, rb, ag, ov;
+
+    Alpha += Alpha >> 7;
+    for(; Count > 0; Count--, Dst++, Src++) {
+        s = *Src;
+        a = (((s >> Ashift) & 0xff) * Alpha) >> 8;
+        if(a == 0)
+            continue;
+        a += a >> 7;
+        d = *Dst;
+        /* Sumamos el origen escalado; cada canal desborda a su bit 8 */
+        rb = (d & 0x00ff00ff) + ((((s & 0x00ff00ff) * a) >> 8) & 0x00ff00ff);
+        ag = ((d >> 8) & 0x00ff00ff) +
+            (((((s >> 8) & 0x00ff00ff) * a) >> 8) & 0x00ff00ff);
+        /* Los canales desbordados se saturan a 255 */
+        ov = rb & 0x01000100;
+        rb = (rb | (ov - (ov >> 8))) & 0x00ff00ff;
+        ov = ag & 0x01000100;
+        ag = ((ag | (ov - (ov >> 8))) & 0x00ff00ff) << 8;
+        *Dst = ((rb | ag) & ~Keep) | (d & Keep);
+    }
+}
+
+
+#ifdef CRE_GFX_X86
+
+/*
+ * CRE_GfxMix4SSE2
+ * Mezcla 4 pixels con los pesos de 32 bits indicados (0..256) en la mitad
+ * baja de cada pixel. Si Add es distinto de 0 la mezcla es aditiva.
+ */
+static __inline__ __attribute__((target("sse2"), always_inline))
+__m128i CRE_GfxMix4SSE2(__m128i s, __m128i d, __m128i a, int Add)
+{
+    __m128i z = _mm_setzero_si128(), c256 = _mm_set1_epi16(256);
+    __m128i sl, sh, dl, dh, al, ah;
+
+    /* Repetimos el peso de cada pixel en sus cuatro canales de 16 bits */
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    al = _mm_unpacklo_epi32(a, a);
+    ah = _mm_unpackhi_epi32(a, a);
+    sl = _mm_mullo_epi16(_mm_unpacklo_epi8(s, z), al);
+    sh = _mm_mullo_epi16(_mm_unpackhi_epi8(s, z), ah);
+    if(Add) {
+        sl = _mm_srli_epi16(sl, 8);
+        sh = _mm_srli_epi16(sh, 8);
+        return _mm_adds_epu8(d, _mm_packus_epi16(sl, sh));
+    }
+    dl = _mm_mullo_epi16(_mm_unpacklo_epi8(d, z), _mm_sub_epi16(c256, al));
+    dh = _mm_mullo_epi16(_mm_unpackhi_epi8(d, z), _mm_sub_epi16(c256, ah));
+    sl = _mm_srli_epi16(_mm_add_epi16(sl, dl), 8);
+    sh = _mm_srli_epi16(_mm_add_epi16(sh, dh), 8);
+    return _mm_packus_epi16(sl, sh);
+}
+
+
+/*
+ * CRE_GfxRowSSE2
+ * Recorre la fila de 4 en 4 pixels. Scale indica si hay que escalar el alpha
+ * de los pixels por el alpha global y Add si la mezcla es aditiva.
+ */
+static __inline__ __attribute__((target("sse2"), always_inline))
+void CRE_GfxRowSSE2(Uint32 * Dst, Uint32 * Src, Sint32 Count, Uint32 Alpha,
+    Uint32 Ashift, Uint32 Keep, int Scale, int Add)
+{
+    __m128i s, d, a, r, z = _mm_setzero_si128();
+    __m128i Mask = _mm_set1_epi32(0xff), Shift = _mm_cvtsi32_si128(Ashift);
+    __m128i vKeep = _mm_set1_epi32(Keep);
+    __m128i vAlpha = _mm_set1_epi32(Alpha + (Alpha >> 7));
+
+    for(; Count >= 4; Count -= 4, Dst += 4, Src += 4) {
+        s = _mm_loadu_si128((__m128i *) Src);
+        a = _mm_and_si128(_mm_srl_epi32(s, Shift), Mask);
+        if(Scale)
+            a = _mm_srli_epi32(_mm_mullo_epi16(a, vAlpha), 8);
+        /* Si los cuatro pixels son transparentes no hay nada que hacer */
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(a, z)) == 0xffff)
+            continue;
+        a = _mm_add_epi32(a, _mm_srli_epi32(a, 7));
+        d = _mm_loadu_si128((__m128i *) Dst);
+        r = CRE_GfxMix4SSE2(s, d, a, Add);
+        r = _mm_or_si128(_mm_andnot_si128(vKeep, r), _mm_and_si128(vKeep, d));
+        _mm_storeu_si128((__m128i *) Dst, r);
+    }
+
+    /* Pixels sobrantes */
+    if(Count > 0) {
+        if(Add)
+            CRE_GfxAddRow(Dst, Src, Count, Alpha, Ashift, Keep);
+        else if(Scale)
+            CRE_GfxOverAlphaRow(Dst, Src, Count, Alpha, Ashift, Keep);
+        else
+            CRE_GfxOverRow(Dst, Src, Count, Alpha, Ashift, Keep);
+    }
+}
+
+
+/*
+ * CRE_GfxMix8AVX2
+ * Igual que CRE_GfxMix4SSE2 pero con 8 pixels
+ */
+static __inline__ __attribute__((target("avx2"), always_inline))
+__m256i CRE_GfxMix8AVX2(__m256i s, __m256i d, __m256i a, int Add)
+{
+    __m256i z = _mm256_setzero_si256(), c256 = _mm256_set1_epi16(256);
+    __m256i sl, sh, dl, dh, al, ah;
+
+    a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+    al = _mm256_unpacklo_epi32(a, a);
+    ah = _mm256_unpackhi_epi32(a, a);
+    sl = _mm256_mullo_epi16(_mm256_unpacklo_epi8(s, z), al);
+    sh = _mm256_mullo_epi16(_mm256_unpackhi_epi8(s, z), ah);
+    if(Add) {
+        sl = _mm256_srli_epi16(sl, 8);
+        sh = _mm256_srli_epi16(sh, 8);
+        return _mm256_adds_epu8(d, _mm256_packus_epi16(sl, sh));
+    }
+    dl = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, z),
+        _mm256_sub_epi16(c256, al));
+    dh = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, z),
+        _mm256_sub_epi16(c256, ah));
+    sl = _mm256_srli_epi16(_mm256_add_epi16(sl, dl), 8);
+    sh = _mm256_srli_epi16(_mm256_add_epi16(sh, dh), 8);
+    return _mm256_packus_epi16(sl, sh);
+}
+
+
+/*
+ * CRE_GfxRowAVX2
+ * Recorre la fila de 8 en 8 pixels; el resto lo mezcla CRE_GfxRowSSE2
+ */
+static __inline__ __attribute__((target("avx2"), always_inline))
+void CRE_GfxRowAVX2(Uint32 * Dst, Uint32 * Src, Sint32 Count, Uint32 Alpha,
+    Uint32 Ashift, Uint32 Keep, int Scale, int Add)
+{
+    __m256i s, d, a, r, z = _mm256_setzero_si256();
+    __m256i Mask = _mm256_set1_epi32(0xff);
+    __m128i Shift = _mm_cvtsi32_si128(Ashift);
+    __m256i vKeep = _mm256_set1_epi32(Keep);
+    __m256i vAlpha = _mm256_set1_epi32(Alpha + (Alpha >> 7));
+
+    for(; Count >= 8; Count -= 8, Dst += 8, Src += 8) {
+        s = _mm256_loadu_si256((__m256i *) Src);
+        a = _mm256_and_si256(_mm256_srl_epi32(s, Shift), Mask);
+        if(Scale)
+            a = _mm256_srli_epi32(_mm256_mullo_epi16(a, vAlpha), 8);
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, z)) == -1)
+            continue;
+        a = _mm256_add_epi32(a, _mm256_srli_epi32(a, 7));
+        d = _mm256_loadu_si256((__m256i *) Dst);
+        r = CRE_GfxMix8AVX2(s, d, a, Add);
+        r = _mm256_or_si256(_mm256_andnot_si256(vKeep, r),
+            _mm256_and_si256(vKeep, d));
+        _mm256_storeu_si256((__m256i *) Dst, r);
+    }
+
+    if(Count > 0)
+        CRE_GfxRowSSE2(Dst, Src, Count, Alpha, Ashift, Keep, Scale, Add);
+}
+
+
+/*
+ * Instancias de los kernels SSE2 y AVX2 para cada modo de mezcla
+ */
+__attribute__((target("sse2")))
+void CRE_GfxOverRowSSE2(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxRowSSE2(Dst, Src, Count, Alpha, Ashift, Keep, 0, 0);
+}
+
+__attribute__((target("sse2")))
+void CRE_GfxOverAlphaRowSSE2(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxRowSSE2(Dst, Src, Count, Alpha, Ashift, Keep, 1, 0);
+}
+
+__attribute__((target("sse2")))
+void CRE_GfxAddRowSSE2(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxRowSSE2(Dst, Src, Count, Alpha, Ashift, Keep, 1, 1);
+}
+
+__attribute__((target("avx2")))
+void CRE_GfxOverRowAVX2(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxRowAVX2(Dst, Src, Count, Alpha, Ashift, Keep, 0, 0);
+}
+
+__attribute__((target("avx2")))
+void CRE_GfxOverAlphaRowAVX2(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxRowAVX2(Dst, Src, Count, Alpha, Ashift, Keep, 1, 0);
+}
+
+__attribute__((target("avx2")))
+void CRE_GfxAddRowAVX2(Uint32 * Dst, Uint32 * Src, Sint32 Count,
+    Uint32 Alpha, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxRowAVX2(Dst, Src, Count, Alpha, Ashift, Keep, 1, 1);
+}
+
+#endif
+
+
+/*
+ * Interpolacin bilineal
+ * Las rutinas de zoom y rotacin con suavizado interpolan cada canal con
+ * aritmtica de punto fijo 16.16:
+ *   t = ((((c1 - c0) * e) >> 16) + c0) & 0xff
+ * Las versiones SSE2 y AVX2 interpolan 4 u 8 pixels a la vez con enteros de
+ * 16 bits y obtienen exactamente el mismo resultado: el producto con signo se
+ * calcula como producto sin signo (mulhi) menos e cuando c1 < c0.
+ */
+
+/*
+ * CRE_GfxBilerp
+ * Interpola un pixel de 32 bits a partir de sus cuatro vecinos
+ */
+Uint32 CRE_GfxBilerp(Uint32 c00, Uint32 c01, Uint32 c10, Uint32 c11,
+    Sint32 ex, Sint32 ey)
+{
+    Sint32 i, t1, t2, a, b;
+    Uint32 r = 0;
+
+    for(i = 0; i < 32; i += 8) {
+        a = (c00 >> i) & 0xff; b = (c01 >> i) & 0xff;
+        t1 = ((((b - a) * ex) >> 16) + a) & 0xff;
+        a = (c10 >> i) & 0xff; b = (c11 >> i) & 0xff;
+        t2 = ((((b - a) * ex) >> 16) + a) & 0xff;
+        r |= (Uint32) (((((t2 - t1) * ey) >> 16) + t1) & 0xff) << i;
+    }
+
+    return r;
+}
+
+
+/*
+ * CRE_GfxRPixelRGBA
+ * Calcula un pixel de la rotacin con suavizado. (sdx, sdy) es la posicin en
+ * el origen en punto fijo 16.16. Si queda fuera del grfico no se dibuja.
+ */
+void CRE_GfxRPixelRGBA(SDL_Surface * src, creGfxColorRGBA * pc, int sdx,
+    int sdy)
+{
+    int t1, t2, dx, dy, ex, ey, sw, sh;
+    creGfxColorRGBA c00, c01, c10, c11;
+    creGfxColorRGBA *sp;
+
+    sw = src->w - 1;
+    sh = src->h - 1;
+    dx = (sdx >> 16);
+    dy = (sdy >> 16);
+    if ((dx >= -1) && (dy >= -1) && (dx < src->w) && (dy < src->h)) {
+	if ((dx >= 0) && (dy >= 0) && (dx < sw) && (dy < sh)) {
+	    sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
+	    sp += dx;
+	    c00 = *sp;
+	    sp += 1;
+	    c01 = *sp;
+	    sp = (creGfxColorRGBA *) ((Uint8 *) sp + src->pitch);
+	    sp -= 1;
+	    c10 = *sp;
+	    sp += 1;
+	    c11 = *sp;
+	} else if ((dx == sw) && (dy == sh)) {
+	    sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
+	    sp += dx;
+	    c00 = *sp;
+	    c01 = *sp;
+	    c10 = *sp;
+	    c11 = *sp;
+	} else if ((dx == -1) && (dy == -1)) {
+	    sp = (creGfxColorRGBA *) (src->pixels);
+	    c00 = *sp;
+	    c01 = *sp;
+	    c10 = *sp;
+	    c11 = *sp;
+	} else if ((dx == -1) && (dy == sh)) {
+	    sp = (creGfxColorRGBA *) (src->pixels);
+	    sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
+	    c00 = *sp;
+	    c01 = *sp;
+	    c10 = *sp;
+	    c11 = *sp;
+	} else if ((dx == sw) && (dy == -1)) {
+	    sp = (creGfxColorRGBA *) (src->pixels);
+	    sp += dx;
+	    c00 = *sp;
+	    c01 = *sp;
+	    c10 = *sp;
+	    c11 = *sp;
+	} else if (dx == -1) {
+	    sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
+	    c00 = *sp;
+	    c01 = *sp;
+	    c10 = *sp;
+	    sp = (creGfxColorRGBA *) ((Uint8 *) sp + src->pitch);
+	    c11 = *sp;
+	} else if (dy == -1) {
+	    sp = (creGfxColorRGBA *) (src->pixels);
+	    sp += dx;
+	    c00 = *sp;
+	    c01 = *sp;
+	    c10 = *sp;
+	    sp += 1;
+	    c11 = *sp;
+	} else if (dx == sw) {
+	    sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
+	    sp += dx;
+	    c00 = *sp;
+	    c01 = *sp;
+	    sp = (creGfxColorRGBA *) ((Uint8 *) sp + src->pitch);
+	    c10 = *sp;
+	    c11 = *sp;
+	} else {
+	    /* dy == sh */
+	    sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
+	    sp += dx;
+	    c00 = *sp;
+	    sp += 1;
+	    c01 = *sp;
+	    c10 = *sp;
+	    c11 = *sp;
+	}
+	/*
+	 * Interpolate colors
+	 */
+	ex = (sdx & 0xffff);
+	ey = (sdy & 0xffff);
+	t1 = ((((c01.r - c00.r) * ex) >> 16) + c00.r) & 0xff;
+	t2 = ((((c11.r - c10.r) * ex) >> 16) + c10.r) & 0xff;
+	pc->r = (((t2 - t1) * ey) >> 16) + t1;
+	t1 = ((((c01.g - c00.g) * ex) >> 16) + c00.g) & 0xff;
+	t2 = ((((c11.g - c10.g) * ex) >> 16) + c10.g) & 0xff;
+	pc->g = (((t2 - t1) * ey) >> 16) + t1;
+	t1 = ((((c01.b - c00.b) * ex) >> 16) + c00.b) & 0xff;
+	t2 = ((((c11.b - c10.b) * ex) >> 16) + c10.b) & 0xff;
+	pc->b = (((t2 - t1) * ey) >> 16) + t1;
+	t1 = ((((c01.a - c00.a) * ex) >> 16) + c00.a) & 0xff;
+	t2 = ((((c11.a - c10.a) * ex) >> 16) + c10.a) & 0xff;
+	pc->a = (((t2 - t1) * ey) >> 16) + t1;
+    }
+}
+
+
+/*
+ * CRE_GFX_RINSIDE
+ * Indica si la posicin (sdx, sdy) tiene sus cuatro vecinos dentro del grfico
+ */
+#define CRE_GFX_RINSIDE(sdx, sdy, sw, sh) \
+    (((sdx) >> 16) >= 0 && ((sdy) >> 16) >= 0 && \
+     ((sdx) >> 16) < (sw) && ((sdy) >> 16) < (sh))
+
+
+#ifdef CRE_GFX_X86
+
+/*
+ * CRE_GfxLerpSSE2
+ * Interpola canales de 16 bits: ((((b - a) * e) >> 16) + a) & 0xff
+ */
+static __inline__ __attribute__((target("sse2"), always_inline))
+__m128i CRE_GfxLerpSSE2(__m128i a, __m128i b, __m128i e)
+{
+    __m128i r = _mm_mulhi_epu16(_mm_sub_epi16(b, a), e);
+
+    r = _mm_sub_epi16(r, _mm_and_si128(_mm_cmpgt_epi16(a, b), e));
+    return _mm_and_si128(_mm_add_epi16(r, a), _mm_set1_epi16(0xff));
+}
+
+
+/*
+ * CRE_GfxBilerp4SSE2
+ * Interpola 4 pixels. ex y ey contienen los pesos (0..65535) de cada pixel.
+ */
+static __inline__ __attribute__((target("sse2"), always_inline))
+__m128i CRE_GfxBilerp4SSE2(__m128i c00, __m128i c01, __m128i c10,
+    __m128i c11, __m128i ex, __m128i ey)
+{
+    __m128i z = _mm_setzero_si128(), exl, exh, eyl, eyh, lo, hi;
+
+    /* Repetimos los pesos de cada pixel en sus cuatro canales */
+    ex = _mm_or_si128(ex, _mm_slli_epi32(ex, 16));
+    ey = _mm_or_si128(ey, _mm_slli_epi32(ey, 16));
+    exl = _mm_unpacklo_epi32(ex, ex);
+    exh = _mm_unpackhi_epi32(ex, ex);
+    eyl = _mm_unpacklo_epi32(ey, ey);
+    eyh = _mm_unpackhi_epi32(ey, ey);
+
+    lo = CRE_GfxLerpSSE2(
+        CRE_GfxLerpSSE2(_mm_unpacklo_epi8(c00, z), _mm_unpacklo_epi8(c01, z),
+            exl),
+        CRE_GfxLerpSSE2(_mm_unpacklo_epi8(c10, z), _mm_unpacklo_epi8(c11, z),
+            exl), eyl);
+    hi = CRE_GfxLerpSSE2(
+        CRE_GfxLerpSSE2(_mm_unpackhi_epi8(c00, z), _mm_unpackhi_epi8(c01, z),
+            exh),
+        CRE_GfxLerpSSE2(_mm_unpackhi_epi8(c10, z), _mm_unpackhi_epi8(c11, z),
+            exh), eyh);
+
+    return _mm_packus_epi16(lo, hi);
+}
+
+
+/* Lee el pixel de 32 bits situado a Off bytes de P */
+#define CRE_GFX_PIXEL(P, Off) (*(Uint32 *) ((Uint8 *) (P) + (Off)))
+
+/*
+ * CRE_GfxZRowSSE2
+ * Interpola una fila del zoom. Off contiene el desplazamiento en bytes de la
+ * columna origen de cada pixel respecto a Row y Ex su peso horizontal.
+ */
+__attribute__((target("sse2")))
+void CRE_GfxZRowSSE2(Uint32 * Dst, Uint8 * Row, Sint32 Pitch, Sint32 * Off,
+    Sint32 * Ex, Sint32 Ey, Sint32 Count)
+{
+    __m128i c00, c01, c10, c11, vEy = _mm_set1_epi32(Ey);
+    Uint8 * Row2 = Row + Pitch;
+    Sint32 x;
+
+    for(x = 0; x + 4 <= Count; x += 4, Off += 4, Ex += 4) {
+        c00 = _mm_set_epi32(CRE_GFX_PIXEL(Row, Off[3]),
+            CRE_GFX_PIXEL(Row, Off[2]), CRE_GFX_PIXEL(Row, Off[1]),
+            CRE_GFX_PIXEL(Row, Off[0]));
+        c01 = _mm_set_epi32(CRE_GFX_PIXEL(Row, Off[3] + 4),
+            CRE_GFX_PIXEL(Row, Off[2] + 4), CRE_GFX_PIXEL(Row, Off[1] + 4),
+            CRE_GFX_PIXEL(Row, Off[0] + 4));
+        c10 = _mm_set_epi32(CRE_GFX_PIXEL(Row2, Off[3]),
+            CRE_GFX_PIXEL(Row2, Off[2]), CRE_GFX_PIXEL(Row2, Off[1]),
+            CRE_GFX_PIXEL(Row2, Off[0]));
+        c11 = _mm_set_epi32(CRE_GFX_PIXEL(Row2, Off[3] + 4),
+            CRE_GFX_PIXEL(Row2, Off[2] + 4), CRE_GFX_PIXEL(Row2, Off[1] + 4),
+            CRE_GFX_PIXEL(Row2, Off[0] + 4));
+        _mm_storeu_si128((__m128i *) (Dst + x), CRE_GfxBilerp4SSE2(c00, c01,
+            c10, c11, _mm_loadu_si128((__m128i *) Ex), vEy));
+    }
+
+    /* Pixels sobrantes */
+    for(; x < Count; x++, Off++, Ex++)
+        Dst[x] = CRE_GfxBilerp(CRE_GFX_PIXEL(Row, *Off),
+            CRE_GFX_PIXEL(Row, *Off + 4), CRE_GFX_PIXEL(Row2, *Off),
+            CRE_GFX_PIXEL(Row2, *Off + 4), *Ex, Ey);
+}
+
+
+/*
+ * CRE_GfxRRowSSE2
+ * Interpola una fila de la rotacin. Los bloques de 4 pixels cuyos vecinos
+ * estn todos dentro del grfico se interpolan a la vez; el resto, pixel a
+ * pixel como en la versin en C.
+ */
+__attribute__((target("sse2")))
+void CRE_GfxRRowSSE2(creGfxColorRGBA * pc, SDL_Surface * src, int sdx,
+    int sdy, int icos, int isin, int Count)
+{
+    __m128i c00, c01, c10, c11, ex, ey;
+    int i, o[4], sw = src->w - 1, sh = src->h - 1;
+    Uint8 * Row = (Uint8 *) src->pixels, * Row2 = Row + src->pitch;
+
+    while(Count > 0) {
+        /*
+         * Las posiciones avanzan en lnea recta, por lo que si el primer y el
+         * ltimo pixel del bloque estn dentro, lo estn todos
+         */
+        if(Count >= 4 && CRE_GFX_RINSIDE(sdx, sdy, sw, sh) &&
+            CRE_GFX_RINSIDE(sdx + 3 * icos, sdy + 3 * isin, sw, sh)) {
+            for(i = 0; i < 4; i++)
+                o[i] = ((sdy + i * isin) >> 16) * src->pitch +
+                    (((sdx + i * icos) >> 16) << 2);
+            c00 = _mm_set_epi32(CRE_GFX_PIXEL(Row, o[3]),
+                CRE_GFX_PIXEL(Row, o[2]), CRE_GFX_PIXEL(Row, o[1]),
+                CRE_GFX_PIXEL(Row, o[0]));
+            c01 = _mm_set_epi32(CRE_GFX_PIXEL(Row, o[3] + 4),
+                CRE_GFX_PIXEL(Row, o[2] + 4), CRE_GFX_PIXEL(Row, o[1] + 4),
+                CRE_GFX_PIXEL(Row, o[0] + 4));
+            c10 = _mm_set_epi32(CRE_GFX_PIXEL(Row2, o[3]),
+                CRE_GFX_PIXEL(Row2, o[2]), CRE_GFX_PIXEL(Row2, o[1]),
+                CRE_GFX_PIXEL(Row2, o[0]));
+            c11 = _mm_set_epi32(CRE_GFX_PIXEL(Row2, o[3] + 4),
+                CRE_GFX_PIXEL(Row2, o[2] + 4), CRE_GFX_PIXEL(Row2, o[1] + 4),
+                CRE_GFX_PIXEL(Row2, o[0] + 4));
+            ex = _mm_set_epi32((sdx + 3 * icos) & 0xffff,
+                (sdx + 2 * icos) & 0xffff, (sdx + icos) & 0xffff, sdx & 0xffff);
+            ey = _mm_set_epi32((sdy + 3 * isin) & 0xffff,
+                (sdy + 2 * isin) & 0xffff, (sdy + isin) & 0xffff, sdy & 0xffff);
+            _mm_storeu_si128((__m128i *) pc, CRE_GfxBilerp4SSE2(c00, c01, c10,
+                c11, ex, ey));
+            sdx += 4 * icos;
+            sdy += 4 * isin;
+            pc += 4;
+            Count -= 4;
+        }
+        else {
+            CRE_GfxRPixelRGBA(src, pc, sdx, sdy);
+            sdx += icos;
+            sdy += isin;
+            pc++;
+            Count--;
+        }
+    }
+}
+
+
+/*
+ * CRE_GfxLerpAVX2
+ * Igual que CRE_GfxLerpSSE2 con 16 canales
+ */
+static __inline__ __attribute__((target("avx2"), always_inline))
+__m256i CRE_GfxLerpAVX2(__m256i a, __m256i b, __m256i e)
+{
+    __m256i r = _mm256_mulhi_epu16(_mm256_sub_epi16(b, a), e);
+
+    r = _mm256_sub_epi16(r, _mm256_and_si256(_mm256_cmpgt_epi16(a, b), e));
+    return _mm256_and_si256(_mm256_add_epi16(r, a), _mm256_set1_epi16(0xff));
+}
+
+
+/*
+ * CRE_GfxBilerp8AVX2
+ * Interpola 8 pixels a partir de los desplazamientos (en bytes) de c00
+ */
+static __inline__ __attribute__((target("avx2"), always_inline))
+__m256i CRE_GfxBilerp8AVX2(Uint8 * Row, Sint32 Pitch, __m256i Off,
+    __m256i ex, __m256i ey)
+{
+    __m256i z = _mm256_setzero_si256(), c00, c01, c10, c11;
+    __m256i exl, exh, eyl, eyh, lo, hi;
+    Uint8 * Row2 = Row + Pitch;
+
+    c00 = _mm256_i32gather_epi32((const int *) Row, Off, 1);
+    c01 = _mm256_i32gather_epi32((const int *) (Row + 4), Off, 1);
+    c10 = _mm256_i32gather_epi32((const int *) Row2, Off, 1);
+    c11 = _mm256_i32gather_epi32((const int *) (Row2 + 4), Off, 1);
+
+    ex = _mm256_or_si256(ex, _mm256_slli_epi32(ex, 16));
+    ey = _mm256_or_si256(ey, _mm256_slli_epi32(ey, 16));
+    exl = _mm256_unpacklo_epi32(ex, ex);
+    exh = _mm256_unpackhi_epi32(ex, ex);
+    eyl = _mm256_unpacklo_epi32(ey, ey);
+    eyh = _mm256_unpackhi_epi32(ey, ey);
+
+    lo = CRE_GfxLerpAVX2(
+        CRE_GfxLerpAVX2(_mm256_unpacklo_epi8(c00, z),
+            _mm256_unpacklo_epi8(c01, z), exl),
+        CRE_GfxLerpAVX2(_mm256_unpacklo_epi8(c10, z),
+            _mm256_unpacklo_epi8(c11, z), exl), eyl);
+    hi = CRE_GfxLerpAVX2(
+        CRE_GfxLerpAVX2(_mm256_unpackhi_epi8(c00, z),
+            _mm256_unpackhi_epi8(c01, z), exh),
+        CRE_GfxLerpAVX2(_mm256_unpackhi_epi8(c10, z),
+            _mm256_unpackhi_epi8(c11, z), exh), eyh);
+
+    return _mm256_packus_epi16(lo, hi);
+}
+
+
+/*
+ * CRE_GfxZRowAVX2
+ * Igual que CRE_GfxZRowSSE2 de 8 en 8 pixels
+ */
+__attribute__((target("avx2")))
+void CRE_GfxZRowAVX2(Uint32 * Dst, Uint8 * Row, Sint32 Pitch, Sint32 * Off,
+    Sint32 * Ex, Sint32 Ey, Sint32 Count)
+{
+    __m256i vEy = _mm256_set1_epi32(Ey);
+    Sint32 x;
+
+    for(x = 0; x + 8 <= Count; x += 8)
+        _mm256_storeu_si256((__m256i *) (Dst + x), CRE_GfxBilerp8AVX2(Row,
+            Pitch, _mm256_loadu_si256((__m256i *) (Off + x)),
+            _mm256_loadu_si256((__m256i *) (Ex + x)), vEy));
+
+    if(x < Count)
+        CRE_GfxZRowSSE2(Dst + x, Row, Pitch, Off + x, Ex + x, Ey, Count - x);
+}
+
+
+/*
+ * CRE_GfxRRowAVX2
+ * Igual que CRE_GfxRRowSSE2 de 8 en 8 pixels; las posiciones, desplazamientos
+ * y pesos de los pixels del bloque se calculan en paralelo
+ */
+__attribute__((target("avx2")))
+void CRE_GfxRRowAVX2(creGfxColorRGBA * pc, SDL_Surface * src, int sdx,
+    int sdy, int icos, int isin, int Count)
+{
+    __m256i Step = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i vCos = _mm256_mullo_epi32(Step, _mm256_set1_epi32(icos));
+    __m256i vSin = _mm256_mullo_epi32(Step, _mm256_set1_epi32(isin));
+    __m256i vPitch = _mm256_set1_epi32(src->pitch);
+    __m256i Mask = _mm256_set1_epi32(0xffff), x, y, Off;
+    int sw = src->w - 1, sh = src->h - 1;
+
+    while(Count >= 8) {
+        if(CRE_GFX_RINSIDE(sdx, sdy, sw, sh) &&
+            CRE_GFX_RINSIDE(sdx + 7 * icos, sdy + 7 * isin, sw, sh)) {
+            x = _mm256_add_epi32(_mm256_set1_epi32(sdx), vCos);
+            y = _mm256_add_epi32(_mm256_set1_epi32(sdy), vSin);
+            Off = _mm256_add_epi32(
+                _mm256_mullo_epi32(_mm256_srai_epi32(y, 16), vPitch),
+                _mm256_slli_epi32(_mm256_srai_epi32(x, 16), 2));
+            _mm256_storeu_si256((__m256i *) pc, CRE_GfxBilerp8AVX2(
+                (Uint8 *) src->pixels, src->pitch, Off,
+                _mm256_and_si256(x, Mask), _mm256_and_si256(y, Mask)));
+        }
+        /* Si el bloque toca el borde, lo resolvemos con la versin SSE2 */
+        else
+            CRE_GfxRRowSSE2(pc, src, sdx, sdy, icos, isin, 8);
+        sdx += 8 * icos;
+        sdy += 8 * isin;
+        pc += 8;
+        Count -= 8;
+    }
+
+    if(Count > 0)
+        CRE_GfxRRowSSE2(pc, src, sdx, sdy, icos, isin, Count);
+}
+
+#endif
+
+
+/* Kernels en uso: normal, normal con alpha global y aditivo */
+creGfxBlendFunc creGfxBlend[3] = {NULL, NULL, NULL};
+/* Interpolacin de filas del zoom y la rotacin (NULL: versin en C) */
+void (* creGfxZRow)(Uint32 *, Uint8 *, Sint32, Sint32 *, Sint32 *, Sint32,
+    Sint32) = NULL;
+void (* creGfxRRow)(creGfxColorRGBA *, SDL_Surface *, int, int, int, int,
+    int) = NULL;
+/* Juego de instrucciones de los kernels en uso */
+int creGfxSIMD = CRE_GFX_SIMD_AUTO;
+
+
+/*
+ * CRE_GfxSetSIMD
+ * Selecciona los kernels de mezcla segn el juego de instrucciones indicado y
+ * los que soporta la CPU
+ */
+int CRE_GfxSetSIMD(int Level)
+{
+    /* Mejor juego de instrucciones soportado por la CPU */
+    int Max = CRE_GFX_SIMD_NONE;
+
+#ifdef CRE_GFX_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        Max = CRE_GFX_SIMD_AVX2;
+    else if(__builtin_cpu_supports("sse2"))
+        Max = CRE_GFX_SIMD_SSE2;
+#endif
+
+    if(Level < 0 || Level > Max)
+        Level = Max;
+
+    switch(Level) {
+#ifdef CRE_GFX_X86
+        case CRE_GFX_SIMD_AVX2:
+            creGfxBlend[0] = CRE_GfxOverRowAVX2;
+            creGfxBlend[1] = CRE_GfxOverAlphaRowAVX2;
+            creGfxBlend[2] = CRE_GfxAddRowAVX2;
+            creGfxZRow = CRE_GfxZRowAVX2;
+            creGfxRRow = CRE_GfxRRowAVX2;
+            break;
+        case CRE_GFX_SIMD_SSE2:
+            creGfxBlend[0] = CRE_GfxOverRowSSE2;
+            creGfxBlend[1] = CRE_GfxOverAlphaRowSSE2;
+            creGfxBlend[2] = CRE_GfxAddRowSSE2;
+            creGfxZRow = CRE_GfxZRowSSE2;
+            creGfxRRow = CRE_GfxRRowSSE2;
+            break;
+#endif
+        default:
+            creGfxBlend[0] = CRE_GfxOverRow;
+            creGfxBlend[1] = CRE_GfxOverAlphaRow;
+            creGfxBlend[2] = CRE_GfxAddRow;
+            creGfxZRow = NULL;
+            creGfxRRow = NULL;
+            break;
+    }
+
+    return creGfxSIMD = Level;
+}
+
+
+/*
+ * CRE_GfxInitSIMD
+ * Selecciona los kernels por defecto si todava no se ha elegido ninguno
+ */
+void CRE_GfxInitSIMD(void)
+{
+    if(creGfxSIMD == CRE_GFX_SIMD_AUTO)
+        CRE_GfxSetSIMD(CRE_GFX_SIMD_AUTO);
+}
+
+
+/*
+ * CRE_GfxBlendKernel
+ * Devuelve el kernel que corresponde al modo y alpha global indicados
+ */
+creGfxBlendFunc CRE_GfxBlendKernel(Uint8 Alpha, Uint8 Mode)
+{
+    CRE_GfxInitSIMD();
+
+    if(Mode == CRE_GFX_BLEND_ADD)
+        return creGfxBlend[2];
+    return creGfxBlend[(Alpha == 255) ? 0 : 1];
+}
+
+
+/*
+ * CRE_GfxBlendRow
+ * Mezcla una fila de pixels de 32 bits con el kernel del modo indicado
+ */
+void CRE_GfxBlendRow(Uint32 * Dst, Uint32 * Src, Sint32 Count, Uint8 Alpha,
+    Uint8 Mode, Uint32 Ashift, Uint32 Keep)
+{
+    CRE_GfxBlendKernel(Alpha, Mode)(Dst, Src, Count, Alpha, Ashift, Keep);
+}
+
+
+/*
+ * CRE_GfxBlendBlitBatch
+ * Mezcla directamente un grfico de 32 bits con canal alpha sobre un destino
+ * de 32 bits con el mismo formato RGB, en cada uno de los Count rectngulos
+ * indicados, aplicando el alpha global sin crear superficies intermedias. Los
+ * formatos, el kernel y el bloqueo del destino se comprueban una sola vez.
+ * Cada rectngulo se recorta con el rea de recorte del destino y, como en
+ * SDL_BlitSurface, se devuelve en l la zona dibujada. Devuelve -1 si los
+ * formatos no permiten hacer la mezcla directa.
+ */
+int CRE_GfxBlendBlitBatch(SDL_Surface * Src, SDL_Surface * Trg,
+    SDL_Rect * Rects, Uint32 Count, Uint8 Alpha, Uint8 Mode)
+{
+    SDL_PixelFormat * sf = Src->format, * tf = Trg->format;
+    /* Kernel con el que se mezcla cada fila */
+    creGfxBlendFunc Blend;
+    /* Zona del origen y del destino que se mezcla */
+    Sint32 x, y, w, h, sx, sy, cx, cy, cw, ch;
+    /* Filas actuales del origen y del destino */
+    Uint8 * sRow, * tRow;
+    /* Bits del destino que no son de color */
+    Uint32 Keep;
+    /* Rectngulo actual */
+    SDL_Rect * Rect;
+
+    /*
+     * Solo mezclamos directamente grficos de 32 bits con el mismo orden RGB
+     * y con canales de 8 bits alineados a byte
+     */
+    if(sf->BitsPerPixel != 32 || tf->BitsPerPixel != 32 || sf->Amask == 0 ||
+        (Src->flags & SDL_RLEACCEL) || sf->Rmask != tf->Rmask ||
+        sf->Gmask != tf->Gmask || sf->Bmask != tf->Bmask ||
+        sf->Rloss || sf->Gloss || sf->Bloss || sf->Aloss ||
+        ((sf->Rshift | sf->Gshift | sf->Bshift | sf->Ashift) & 7))
+        return -1;
+
+    if(SDL_MUSTLOCK(Trg) && SDL_LockSurface(Trg) < 0)
+        return -1;
+
+    Blend = CRE_GfxBlendKernel(Alpha, Mode);
+    Keep = ~(tf->Rmask | tf->Gmask | tf->Bmask);
+    cx = Trg->clip_rect.x; cy = Trg->clip_rect.y;
+    cw = Trg->clip_rect.w; ch = Trg->clip_rect.h;
+
+    for(Rect = Rects; Count > 0; Count--, Rect++) {
+        /* Recortamos con el rea de recorte del destino */
+        x = Rect->x; y = Rect->y; w = Src->w; h = Src->h; sx = sy = 0;
+        if(x < cx) { sx = cx - x; w -= sx; x = cx; }
+        if(y < cy) { sy = cy - y; h -= sy; y = cy; }
+        if(x + w > cx + cw) w = cx + cw - x;
+        if(y + h > cy + ch) h = cy + ch - y;
+
+        if(w <= 0 || h <= 0) {
+            Rect->w = Rect->h = 0;
+            continue;
+        }
+        Rect->x = x; Rect->y = y; Rect->w = w; Rect->h = h;
+
+        sRow = (Uint8 *) Src->pixels + sy * Src->pitch + (sx << 2);
+        tRow = (Uint8 *) Trg->pixels + y * Trg->pitch + (x << 2);
+        for(; h > 0; h--, sRow += Src->pitch, tRow += Trg->pitch)
+            Blend((Uint32 *) tRow, (Uint32 *) sRow, w, Alpha, sf->Ashift,
+                Keep);
+    }
+
+    if(SDL_MUSTLOCK(Trg))
+        SDL_UnlockSurface(Trg);
+
+    return 0;
+}
+
+
+/*
+ * CRE_GfxBlendBlit
+ * Mezcla un grfico sobre un nico rectngulo del destino. Ver
+ * CRE_GfxBlendBlitBatch.
+ */
+int CRE_GfxBlendBlit(SDL_Surface * Src, SDL_Surface * Trg, SDL_Rect * Rect,
+    Uint8 Alpha, Uint8 Mode)
+{
+    return CRE_GfxBlendBlitBatch(Src, Trg, Rect, 1, Alpha, Mode);
+}
+
 
 /*
  * CRE_GfxAlphaBlit
  * Hace un blit entre dos superficies teniendo en cuenta el canal alpha indicado
  * como parmetro incluso cuando las superficies son de 32bits, caso en el que
- * hay que aplicar el cambio del canal alpha pixel a pixel
+ * el canal alpha de cada pixel se escala por el indicado
  */
 int CRE_GfxAlphaBlit(SDL_Surface * Src, SDL_Surface * Trg, SDL_Rect * Rect,
     Uint8 Alpha)
 {
-    /* Lienzo temporal usado en caso de que el blit sea de 32 bits */
+    /* Lienzo temporal usado en caso de que no se pueda mezclar directamente */
     SDL_Surface * Canvas = NULL;
-    /* Bufers del lienzo y el origen (32 bits) */
-    Uint32 * cBuffer, * sBuffer;
+    /* Filas del lienzo y el origen (32 bits) */
+    Uint8 * cRow, * sRow;
     /* Contadores para recorrer los grficos (32 bits) */
-    Uint32 max, a;
-    /*
-     * Variable temporal que almace la diferencia entre el canala alpha de un
-     * pixel y el establecido (32 bits)
-     */
-    Sint32 Tmp;
+    Sint32 x, y;
+    /* Canal alpha del pixel actual (32 bits) */
+    Uint32 a, s;
 
     /* Comprobamos que los datos son correctos */
     if(Trg == NULL || Src == NULL || Rect == NULL)
@@ -64,49 +958,42 @@ int CRE_GfxAlphaBlit(SDL_Surface * Src, SDL_Surface * Trg, SDL_Rect * Rect,
         SDL_BlitSurface(Src, NULL, Trg, Rect);
 
     }
-    /* Si hay un cierto nivel de transparencia */
-    else {
-        /*
-         * Si el grfico no es de 32 bits, aplicamos el canal alpha a toda la
-         * superficie del grfico
-         */
-        if(Src->format->BitsPerPixel != 32) {
-            /* Aplicamos el canal alpha */
-            SDL_SetAlpha(Src, SDL_SRCALPHA, Alpha);
-            /* Hacemos el blit */
-            SDL_BlitSurface(Src, NULL, Trg, Rect);
-        }
-        /*
-         * Si el grfico es de 32 bits, debemos aplicar a la diferencia de los
-         * canales alphas a cada pixel. Para ello usamos un grfico temporal.
-         */
-        else {
-            /* Obtemeos la diferencia (complemento de alpha, 255 - Alpha) */
-            Alpha = ~Alpha;
-            /* Creamos el grfico temporal a imagen del origen */
-            Canvas = SDL_CreateRGBSurface(SDL_HWSURFACE, Src->w, Src->h,
-                Src->format->BitsPerPixel, Src->format->Rmask,
-                Src->format->Gmask, Src->format->Bmask, Src->format->Amask);
-            /* Obtenemos las direcciones de los buffers de datos */
-            cBuffer = (Uint32 *) Canvas->pixels;
-            sBuffer = (Uint32 *) Src->pixels;
-            /* Recorremos el grfico de 32 bits pixel a pixel */
-            for(max = Src->w * Src->h; max > 0; max--, cBuffer++, sBuffer++) {
-                /* Obtenemos el canal alpha del pixel actual */
-                a = ((*sBuffer) & (Src->format->Amask)) >> Src->format->Ashift;
-                /* Calculamso la diferencia entre los canales */
-                Tmp = a - Alpha;
-                /* Si la diferencia es negativa, lo ajutamos a 0 (Transpa.) */
-                a = (Tmp < 0) ? 0 : Tmp;
-                /* LLevamos al valor obtenido a su posicin */
-                a = a << Src->format->Ashift;
-                /* Unimos el canal alpha nuevo con el RGB y hacemo el blit */
-                *cBuffer = a | ((*sBuffer) & (~Src->format->Amask));
-
+    /*
+     * Si el grfico no es de 32 bits, aplicamos el canal alpha a toda la
+     * superficie del grfico
+     */
+    else if(Src->format->BitsPerPixel != 32) {
+        /* Aplicamos el canal alpha */
+        SDL_SetAlpha(Src, SDL_SRCALPHA, Alpha);
+        /* Hacemos el blit */
+        SDL_BlitSurface(Src, NULL, Trg, Rect);
+    }
+    /*
+     * Si el grfico es de 32 bits intentamos mezclarlo directamente sobre el
+     * destino. Si los formatos no lo permiten, escalamos el canal alpha de
+     * cada pixel en un grfico temporal y dejamos que SDL haga la conversin.
+     */
+    else if(CRE_GfxBlendBlit(Src, Trg, Rect, Alpha, CRE_GFX_BLEND_OVER) != 0) {
+        /* Creamos el grfico temporal a imagen del origen */
+        Canvas = SDL_CreateRGBSurface(SDL_SWSURFACE, Src->w, Src->h,
+            Src->format->BitsPerPixel, Src->format->Rmask,
+            Src->format->Gmask, Src->format->Bmask, Src->format->Amask);
+        if(Canvas == NULL)
+            return -1;
+        /* Recorremos el grfico de 32 bits pixel a pixel */
+        cRow = (Uint8 *) Canvas->pixels;
+        sRow = (Uint8 *) Src->pixels;
+        for(y = 0; y < Src->h; y++, cRow += Canvas->pitch, sRow += Src->pitch)
+            for(x = 0; x < Src->w; x++) {
+                s = ((Uint32 *) sRow)[x];
+                /* Escalamos el canal alpha del pixel por el indicado */
+                a = (s & Src->format->Amask) >> Src->format->Ashift;
+                a = DIV255(a * Alpha) << Src->format->Ashift;
+                /* Unimos el canal alpha nuevo con el RGB */
+                ((Uint32 *) cRow)[x] = a | (s & ~Src->format->Amask);
             }
-            /* Copiamos el Lienzo temporal a la imagen destino */
-            SDL_BlitSurface(Canvas, NULL, Trg, Rect);
-        }
+        /* Copiamos el Lienzo temporal a la imagen destino */
+        SDL_BlitSurface(Canvas, NULL, Trg, Rect);
     }
 
     /* Si hemos usado un lienzo temporal, lo eliminamos */
@@ -116,7 +1003,7 @@ int CRE_GfxAlphaBlit(SDL_Surface * Src, SDL_Surface * Trg, SDL_Rect * Rect,
     return 0;
 }
 
-
+
 /*
  * CRE_GfxZSurfaceRGBA
  * Hace un zoom de la superfecie de 32 bits y da el resultado en dst.
@@ -129,6 +1016,8 @@ int CRE_GfxZSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx,
     creGfxColorRGBA *c00, *c01, *c10, *c11;
     creGfxColorRGBA *sp, *csp, *dp;
     int dgap;
+    /* Desplazamiento y peso de cada columna para la versin SIMD */
+    Sint32 *xoff = NULL;
 
     /*
      * Variable setup
@@ -187,9 +1076,37 @@ int CRE_GfxZSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int flipx,
     dgap = dst->pitch - dst->w * 4;
 
     /*
-     * Switch between interpolating and non-interpolating code
+     * Si hay una versin SIMD de la interpolacin, precalculamos el
+     * desplazamiento y el peso de cada columna, que son iguales en todas las
+     * filas, y la usamos para interpolar las filas completas
      */
     if (smooth) {
+	CRE_GfxInitSIMD();
+	if (creGfxZRow != NULL)
+	    xoff = (Sint32 *) malloc(2 * dst->w * sizeof(Sint32));
+    }
+
+    if (xoff != NULL) {
+	csx = 0;
+	for (x = 0; x < dst->w; x++) {
+	    xoff[x] = csx << 2;
+	    xoff[dst->w + x] = sax[x] & 0xffff;
+	    csx += sax[x + 1] >> 16;
+	}
+	csay = say;
+	for (y = 0; y < dst->h; y++) {
+	    creGfxZRow((Uint32 *) dp, (Uint8 *) csp, src->pitch, xoff,
+		xoff + dst->w, *csay & 0xffff, dst->w);
+	    csay++;
+	    csp = (creGfxColorRGBA *) ((Uint8 *) csp + (*csay >> 16) * src->pitch);
+	    dp = (creGfxColorRGBA *) ((Uint8 *) dp + dst->pitch);
+	}
+	free(xoff);
+
+    /*
+     * Switch between interpolating and non-interpolating code
+     */
+    } else if (smooth) {
 
 	/*
 	 * Interpolating Zoom
@@ -429,20 +1346,17 @@ int CRE_GfxZSurfaceY(SDL_Surface * src, SDL_Surface * dst, int flipx, int flipy)
 void CRE_GfxRSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy,
     int isin, int icos, int flipx, int flipy, int smooth)
 {
-    int x, y, t1, t2, dx, dy, xd, yd, sdx, sdy, ax, ay, ex, ey, sw, sh;
-    creGfxColorRGBA c00, c01, c10, c11;
+    int x, y, dx, dy, xd, yd, sdx, sdy, ax, ay;
     creGfxColorRGBA *pc, *sp;
     int gap;
 
     /*
      * Variable setup
      */
-    xd = ((src->w - dst->w) << 15);
-    yd = ((src->h - dst->h) << 15);
+    xd = ((src->w - dst->w) * 32768);
+    yd = ((src->h - dst->h) * 32768);
     ax = (cx << 16) - (icos * cx);
     ay = (cy << 16) - (isin * cx);
-    sw = src->w - 1;
-    sh = src->h - 1;
     pc = dst->pixels;
     gap = dst->pitch - dst->w * 4;
 
@@ -450,105 +1364,22 @@ void CRE_GfxRSurfaceRGBA(SDL_Surface * src, SDL_Surface * dst, int cx, int cy,
      * Switch between interpolating and non-interpolating code
      */
     if (smooth) {
+	CRE_GfxInitSIMD();
 	for (y = 0; y < dst->h; y++) {
 	    dy = cy - y;
 	    sdx = (ax + (isin * dy)) + xd;
 	    sdy = (ay - (icos * dy)) + yd;
-	    for (x = 0; x < dst->w; x++) {
-		dx = (sdx >> 16);
-		dy = (sdy >> 16);
-		if ((dx >= -1) && (dy >= -1) && (dx < src->w) && (dy < src->h)) {
-		    if ((dx >= 0) && (dy >= 0) && (dx < sw) && (dy < sh)) {
-			sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
-			sp += dx;
-			c00 = *sp;
-			sp += 1;
-			c01 = *sp;
-			sp = (creGfxColorRGBA *) ((Uint8 *) sp + src->pitch);
-			sp -= 1;
-			c10 = *sp;
-			sp += 1;
-			c11 = *sp;
-		    } else if ((dx == sw) && (dy == sh)) {
-			sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
-			sp += dx;
-			c00 = *sp;
-			c01 = *sp;
-			c10 = *sp;
-			c11 = *sp;
-		    } else if ((dx == -1) && (dy == -1)) {
-			sp = (creGfxColorRGBA *) (src->pixels);
-			c00 = *sp;
-			c01 = *sp;
-			c10 = *sp;
-			c11 = *sp;
-		    } else if ((dx == -1) && (dy == sh)) {
-			sp = (creGfxColorRGBA *) (src->pixels);
-			sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
-			c00 = *sp;
-			c01 = *sp;
-			c10 = *sp;
-			c11 = *sp;
-		    } else if ((dx == sw) && (dy == -1)) {
-			sp = (creGfxColorRGBA *) (src->pixels);
-			sp += dx;
-			c00 = *sp;
-			c01 = *sp;
-			c10 = *sp;
-			c11 = *sp;
-		    } else if (dx == -1) {
-			sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
-			c00 = *sp;
-			c01 = *sp;
-			c10 = *sp;
-			sp = (creGfxColorRGBA *) ((Uint8 *) sp + src->pitch);
-			c11 = *sp;
-		    } else if (dy == -1) {
-			sp = (creGfxColorRGBA *) (src->pixels);
-			sp += dx;
-			c00 = *sp;
-			c01 = *sp;
-			c10 = *sp;
-			sp += 1;
-			c11 = *sp;
-		    } else if (dx == sw) {
-			sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
-			sp += dx;
-			c00 = *sp;
-			c01 = *sp;
-			sp = (creGfxColorRGBA *) ((Uint8 *) sp + src->pitch);
-			c10 = *sp;
-			c11 = *sp;
-		    } else if (dy == sh) {
-			sp = (creGfxColorRGBA *) ((Uint8 *) src->pixels + src->pitch * dy);
-			sp += dx;
-			c00 = *sp;
-			sp += 1;
-			c01 = *sp;
-			c10 = *sp;
-			c11 = *sp;
-		    }
-		    /*
-		     * Interpolate colors
-		     */
-		    ex = (sdx & 0xffff);
-		    ey = (sdy & 0xffff);
-		    t1 = ((((c01.r - c00.r) * ex) >> 16) + c00.r) & 0xff;
-		    t2 = ((((c11.r - c10.r) * ex) >> 16) + c10.r) & 0xff;
-		    pc->r = (((t2 - t1) * ey) >> 16) + t1;
-		    t1 = ((((c01.g - c00.g) * ex) >> 16) + c00.g) & 0xff;
-		    t2 = ((((c11.g - c10.g) * ex) >> 16) + c10.g) & 0xff;
-		    pc->g = (((t2 - t1) * ey) >> 16) + t1;
-		    t1 = ((((c01.b - c00.b) * ex) >> 16) + c00.b) & 0xff;
-		    t2 = ((((c11.b - c10.b) * ex) >> 16) + c10.b) & 0xff;
-		    pc->b = (((t2 - t1) * ey) >> 16) + t1;
-		    t1 = ((((c01.a - c00.a) * ex) >> 16) + c00.a) & 0xff;
-		    t2 = ((((c11.a - c10.a) * ex) >> 16) + c10.a) & 0xff;
-		    pc->a = (((t2 - t1) * ey) >> 16) + t1;
+	    /* Si hay una versin SIMD, interpolamos la fila completa con ella */
+	    if (creGfxRRow != NULL) {
+		creGfxRRow(pc, src, sdx, sdy, icos, isin, dst->w);
+		pc += dst->w;
+	    } else {
+		for (x = 0; x < dst->w; x++) {
+		    CRE_GfxRPixelRGBA(src, pc, sdx, sdy);
+		    sdx += icos;
+		    sdy += isin;
+		    pc++;
 		}
-		sdx += icos;
-		sdy += isin;
-		pc++;
 	    }
 	    pc = (creGfxColorRGBA *) ((Uint8 *) pc + gap);
 	}
@@ -592,8 +1423,8 @@ void CRE_GfxRSurfaceY(SDL_Surface * src, SDL_Surface * dst, int cx, int cy,
     /*
      * Variable setup
      */
-    xd = ((src->w - dst->w) << 15);
-    yd = ((src->h - dst->h) << 15);
+    xd = ((src->w - dst->w) * 32768);
+    yd = ((src->h - dst->h) * 32768);
     ax = (cx << 16) - (icos * cx);
     ay = (cy << 16) - (isin * cx);
     sw = src->w - 1;
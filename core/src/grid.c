@@ -0,0 +1,333 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file grid.c
+ * Implementacin de la rejilla de ocupacin por tiles. Ms informacin en el
+ * archivo de cabecera.
+ **/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include "process.h"
+#include "grid.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Nmero inicial de entradas de una rejilla */
+#define GRID_MIN_SIZE 64
+
+/* Macros de mximos y mnimos */
+#ifndef MAX
+    #define MAX(A, B) (((A) > (B)) ? (A) : (B))
+#endif
+
+#ifndef MIN
+    #define MIN(A, B) (((A) < (B)) ? (A) : (B))
+#endif
+
+/* Indica si una casilla est dentro de la rejilla */
+#define GRID_INSIDE(G, X, Y) ((X) >= 0 && (Y) >= 0 && (X) < (G)->W && \
+    (Y) < (G)->H)
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * CRE_NewGrid
+ * Crea una rejilla de ocupacin vaca.
+ */
+creGrid * CRE_NewGrid(Sint32 W, Sint32 H)
+{
+    creGrid * Grid;
+    Sint32 i;
+
+    /* Comprobamos los parametros */
+    if(W <= 0 || H <= 0) return NULL;
+
+    Grid = (creGrid *) malloc(sizeof(creGrid));
+    if(Grid == NULL) return NULL;
+    Grid->W = W;
+    Grid->H = H;
+    Grid->Cells = (Sint32 *) malloc(sizeof(Sint32) * W * H);
+    Grid->Entries = NULL;
+    Grid->Size = 0;
+    Grid->FreeFirst = -1;
+    if(Grid->Cells == NULL) {
+        free(Grid);
+        return NULL;
+    }
+    for(i = 0; i < W * H; i++)
+        Grid->Cells[i] = -1;
+
+    return Grid;
+}
+
+
+/*
+ * CRE_FreeGrid
+ * Elimina una rejilla de ocupacin.
+ */
+void CRE_FreeGrid(creGrid * Grid)
+{
+    if(Grid == NULL) return;
+
+    free(Grid->Cells);
+    free(Grid->Entries);
+    free(Grid);
+}
+
+
+/*
+ * CRE_GridLink
+ * Aade una entrada al principio de la lista de su casilla.
+ */
+void CRE_GridLink(creGrid * Grid, Sint32 e)
+{
+    creGridEntry * Entry = Grid->Entries + e;
+    Sint32 * Cell = Grid->Cells + Entry->X + Entry->Y * Grid->W;
+
+    Entry->Prev = -1;
+    Entry->Next = *Cell;
+    if(*Cell != -1) Grid->Entries[*Cell].Prev = e;
+    *Cell = e;
+}
+
+
+/*
+ * CRE_GridUnlink
+ * Saca una entrada de la lista de su casilla.
+ */
+void CRE_GridUnlink(creGrid * Grid, Sint32 e)
+{
+    creGridEntry * Entry = Grid->Entries + e;
+
+    if(Entry->Prev != -1) Grid->Entries[Entry->Prev].Next = Entry->Next;
+    else Grid->Cells[Entry->X + Entry->Y * Grid->W] = Entry->Next;
+    if(Entry->Next != -1) Grid->Entries[Entry->Next].Prev = Entry->Prev;
+    Entry->Prev = Entry->Next = -1;
+}
+
+
+/*
+ * CRE_GridValid
+ * Indica si una entrada pertenece a un proceso vivo.
+ */
+Uint8 CRE_GridValid(creGrid * Grid, Sint32 e)
+{
+    creGridEntry * Entry;
+
+    if(Grid == NULL || e < 0 || (Uint32) e >= Grid->Size) return 0;
+    Entry = Grid->Entries + e;
+    return Entry->Id != 0 && CRE_IsAlive(Entry->Id);
+}
+
+
+/*
+ * CRE_GridTouch
+ * Avisa a los procesos que coinciden en la casilla de una entrada, y a ella.
+ * Las funciones pueden modificar la rejilla (crear o mover procesos), por lo
+ * que primero se guardan las entradas a avisar y despus se comprueba que
+ * siguen en la misma casilla.
+ */
+void CRE_GridTouch(creGrid * Grid, Sint32 Entry)
+{
+    Sint32 Touched[CRE_GRID_TOUCHES];
+    Uint32 Ids[CRE_GRID_TOUCHES];
+    Sint32 e, n = 0, i, X, Y;
+    Uint32 Id;
+    creGridEntry * This, * Other;
+
+    if(!CRE_GridValid(Grid, Entry)) return;
+    This = Grid->Entries + Entry;
+    Id = This->Id; X = This->X; Y = This->Y;
+
+    /* Procesos que hay en la casilla */
+    for(e = Grid->Cells[X + Y * Grid->W]; e != -1 && n < CRE_GRID_TOUCHES;
+        e = Grid->Entries[e].Next)
+        if(e != Entry && CRE_GridValid(Grid, e)) {
+            Touched[n] = e;
+            Ids[n++] = Grid->Entries[e].Id;
+        }
+
+    /* Avisamos a ambos, si siguen vivos y en la misma casilla */
+    for(i = 0; i < n; i++) {
+        This = Grid->Entries + Entry;
+        Other = Grid->Entries + Touched[i];
+        if(!CRE_GridValid(Grid, Entry) || This->Id != Id || This->X != X ||
+           This->Y != Y)
+            return;
+        if(!CRE_GridValid(Grid, Touched[i]) || Other->Id != Ids[i] ||
+           Other->X != X || Other->Y != Y)
+            continue;
+        if(This->Touch != NULL)
+            This->Touch(This->Process, Other->Process);
+
+        This = Grid->Entries + Entry;
+        Other = Grid->Entries + Touched[i];
+        if(Other->Touch != NULL && CRE_GridValid(Grid, Entry) &&
+           CRE_GridValid(Grid, Touched[i]) && Other->Id == Ids[i])
+            Other->Touch(Other->Process, This->Process);
+    }
+}
+
+
+/*
+ * CRE_GridAdd
+ * Registra un proceso en una casilla.
+ */
+Sint32 CRE_GridAdd(creGrid * Grid, creProcess * Process, Sint32 X, Sint32 Y,
+    creGridTouch Touch)
+{
+    creGridEntry * Entries, * Entry;
+    Uint32 i, Size;
+    Sint32 e;
+
+    /* Comprobamos los parametros */
+    if(Grid == NULL || Process == NULL || Process->Id == 0 ||
+       !GRID_INSIDE(Grid, X, Y))
+        return -1;
+
+    /* Reutilizamos una entrada libre, o ampliamos el vector */
+    if(Grid->FreeFirst == -1) {
+        Size = Grid->Size ? Grid->Size * 2 : GRID_MIN_SIZE;
+        Entries = (creGridEntry *) realloc(Grid->Entries,
+            sizeof(creGridEntry) * Size);
+        if(Entries == NULL) return -1;
+        for(i = Grid->Size; i < Size; i++) {
+            Entries[i].Id = 0;
+            Entries[i].Next = i + 1 < Size ? (Sint32) i + 1 : -1;
+        }
+        Grid->FreeFirst = Grid->Size;
+        Grid->Entries = Entries;
+        Grid->Size = Size;
+    }
+    e = Grid->FreeFirst;
+    Entry = Grid->Entries + e;
+    Grid->FreeFirst = Entry->Next;
+
+    Entry->Process = Process;
+    Entry->Id = Process->Id;
+    Entry->X = X;
+    Entry->Y = Y;
+    Entry->Touch = Touch;
+    CRE_GridLink(Grid, e);
+
+    CRE_GridTouch(Grid, e);
+    return e;
+}
+
+
+/*
+ * CRE_GridMove
+ * Mueve un proceso registrado a otra casilla.
+ */
+Sint32 CRE_GridMove(creGrid * Grid, Sint32 Entry, Sint32 X, Sint32 Y)
+{
+    creGridEntry * This;
+
+    /* Comprobamos los parametros */
+    if(Grid == NULL || Entry < 0 || (Uint32) Entry >= Grid->Size ||
+       Grid->Entries[Entry].Id == 0 || !GRID_INSIDE(Grid, X, Y))
+        return -1;
+
+    This = Grid->Entries + Entry;
+    if(This->X == X && This->Y == Y)
+        return 0;
+
+    CRE_GridUnlink(Grid, Entry);
+    This->X = X;
+    This->Y = Y;
+    CRE_GridLink(Grid, Entry);
+
+    CRE_GridTouch(Grid, Entry);
+    return 0;
+}
+
+
+/*
+ * CRE_GridRemove
+ * Quita un proceso de la rejilla.
+ */
+void CRE_GridRemove(creGrid * Grid, Sint32 Entry)
+{
+    if(Grid == NULL || Entry < 0 || (Uint32) Entry >= Grid->Size ||
+       Grid->Entries[Entry].Id == 0)
+        return;
+
+    CRE_GridUnlink(Grid, Entry);
+    Grid->Entries[Entry].Id = 0;
+    Grid->Entries[Entry].Next = Grid->FreeFirst;
+    Grid->FreeFirst = Entry;
+}
+
+
+/*
+ * CRE_GridAt
+ * Busca los procesos que hay en una casilla.
+ */
+Uint32 CRE_GridAt(creGrid * Grid, Sint32 X, Sint32 Y, creProcess ** Out,
+    Uint32 Max)
+{
+    Uint32 n = 0;
+    Sint32 e;
+
+    if(Grid == NULL || !GRID_INSIDE(Grid, X, Y)) return 0;
+
+    for(e = Grid->Cells[X + Y * Grid->W]; e != -1; e = Grid->Entries[e].Next)
+        if(CRE_GridValid(Grid, e)) {
+            if(n < Max) Out[n] = Grid->Entries[e].Process;
+            n++;
+        }
+
+    return n;
+}
+
+
+/*
+ * CRE_GridNear
+ * Busca los procesos que hay cerca de una casilla.
+ */
+Uint32 CRE_GridNear(creGrid * Grid, Sint32 X, Sint32 Y, Sint32 R,
+    creProcess ** Out, Uint32 Max)
+{
+    Sint32 i, j, i0, j0, i1, j1;
+    Uint32 n = 0;
+
+    if(Grid == NULL || R < 0) return 0;
+
+    /* Recorremos solo las casillas del cuadrado que contiene al crculo */
+    i0 = MAX(0, X - R); i1 = MIN(Grid->W - 1, X + R);
+    j0 = MAX(0, Y - R); j1 = MIN(Grid->H - 1, Y + R);
+    for(j = j0; j <= j1; j++)
+        for(i = i0; i <= i1; i++)
+            if((i - X) * (i - X) + (j - Y) * (j - Y) <= R * R)
+                n += CRE_GridAt(Grid, i, j, n < Max ? Out + n : NULL,
+                    n < Max ? Max - n : 0);
+
+    return n;
+}
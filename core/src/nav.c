@@ -0,0 +1,721 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file nav.c
+ * Implementacin de la navegacin sobre escenarios de tiles. Ms informacin
+ * en el archivo de cabecera.
+ **/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include "nav.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Indica si una casilla est dentro del mapa */
+#define NAV_INSIDE(M, X, Y) ((X) >= 0 && (Y) >= 0 && (X) < (M)->W && \
+    (Y) < (M)->H)
+
+/* Indica si un agente puede pasar por una casilla */
+#define NAV_WALK(M, A, X, Y) (NAV_INSIDE(M, X, Y) && \
+    ((M)->Cells[(X) + (Y) * (M)->W] & (A)))
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * CRE_NewNavMap
+ * Crea el mapa de navegacin de un escenario.
+ */
+creNavMap * CRE_NewNavMap(Sint32 W, Sint32 H, const char * Tiles,
+    const Uint8 * Masks)
+{
+    creNavMap * Map;
+    Sint32 i;
+
+    /* Comprobamos los parametros */
+    if(Tiles == NULL || Masks == NULL || W <= 0 || H <= 0)
+        return NULL;
+
+    Map = (creNavMap *) malloc(sizeof(creNavMap));
+    if(Map == NULL) return NULL;
+    Map->W = W;
+    Map->H = H;
+    Map->Version = 0;
+    Map->Cells = (Uint8 *) malloc(Map->W * Map->H);
+    if(Map->Cells == NULL) {
+        free(Map);
+        return NULL;
+    }
+    for(i = 0; i < Map->W * Map->H; i++)
+        Map->Cells[i] = Masks[(Uint8) Tiles[i]];
+
+    return Map;
+}
+
+
+/*
+ * CRE_FreeNavMap
+ * Elimina un mapa de navegacin.
+ */
+void CRE_FreeNavMap(creNavMap * Map)
+{
+    if(Map == NULL) return;
+
+    free(Map->Cells);
+    free(Map);
+}
+
+
+/*
+ * CRE_NavSetCell
+ * Cambia qu agentes pueden pasar por una casilla.
+ */
+void CRE_NavSetCell(creNavMap * Map, Sint32 X, Sint32 Y, Uint8 Agents)
+{
+    Uint8 * Cell;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL || !NAV_INSIDE(Map, X, Y)) return;
+
+    Cell = Map->Cells + X + Y * Map->W;
+    if(*Cell == Agents) return;
+    *Cell = Agents;
+    Map->Version++;
+}
+
+
+/*
+ * CRE_NavWalkable
+ * Indica si un agente puede pasar por una casilla.
+ */
+Uint8 CRE_NavWalkable(creNavMap * Map, Uint8 Agents, Sint32 X, Sint32 Y)
+{
+    if(Map == NULL) return 0;
+    return NAV_WALK(Map, Agents, X, Y) != 0;
+}
+
+
+/*
+ * CRE_NavMoves
+ * Direcciones en las que un agente puede moverse desde una casilla.
+ */
+Uint8 CRE_NavMoves(creNavMap * Map, Uint8 Agents, Sint32 X, Sint32 Y)
+{
+    Uint8 Moves = CRE_NAV_NONE;
+
+    if(CRE_NavWalkable(Map, Agents, X - 1, Y)) Moves |= CRE_NAV_LEFT;
+    if(CRE_NavWalkable(Map, Agents, X + 1, Y)) Moves |= CRE_NAV_RIGHT;
+    if(CRE_NavWalkable(Map, Agents, X, Y - 1)) Moves |= CRE_NAV_UP;
+    if(CRE_NavWalkable(Map, Agents, X, Y + 1)) Moves |= CRE_NAV_DOWN;
+
+    return Moves;
+}
+
+
+/*
+ * CRE_NewNavField
+ * Crea un campo de distancias sin objetivo.
+ */
+creNavField * CRE_NewNavField(creNavMap * Map, Uint8 Agents)
+{
+    creNavField * Field;
+    Sint32 Size;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL) return NULL;
+
+    Field = (creNavField *) malloc(sizeof(creNavField));
+    if(Field == NULL) return NULL;
+    Size = Map->W * Map->H;
+    Field->Map = Map;
+    Field->Agents = Agents;
+    Field->X = Field->Y = -1;
+    Field->Version = Map->Version;
+    Field->Dirty = 0;
+    Field->Dist = (Uint16 *) malloc(sizeof(Uint16) * Size);
+    Field->Queue = (Sint32 *) malloc(sizeof(Sint32) * Size);
+    if(Field->Dist == NULL || Field->Queue == NULL) {
+        CRE_FreeNavField(Field);
+        return NULL;
+    }
+    memset(Field->Dist, 0xFF, sizeof(Uint16) * Size);
+
+    return Field;
+}
+
+
+/*
+ * CRE_FreeNavField
+ * Elimina un campo de distancias.
+ */
+void CRE_FreeNavField(creNavField * Field)
+{
+    if(Field == NULL) return;
+
+    free(Field->Dist);
+    free(Field->Queue);
+    free(Field);
+}
+
+
+/*
+ * CRE_NavSetTarget
+ * Cambia el objetivo de un campo; se recalcula al consultarlo.
+ */
+void CRE_NavSetTarget(creNavField * Field, Sint32 X, Sint32 Y)
+{
+    if(Field == NULL || (Field->X == X && Field->Y == Y)) return;
+
+    Field->X = X;
+    Field->Y = Y;
+    Field->Dirty = 1;
+}
+
+
+/*
+ * CRE_NavUpdate
+ * Recalcula un campo, si hace falta, con una bsqueda en anchura desde el
+ * objetivo.
+ */
+void CRE_NavUpdate(creNavField * Field)
+{
+    creNavMap * Map = Field->Map;
+    Sint32 First, Last, c, n, x, y;
+    Uint16 d;
+
+    if(!Field->Dirty && Field->Version == Map->Version) return;
+    Field->Dirty = 0;
+    Field->Version = Map->Version;
+
+    memset(Field->Dist, 0xFF, sizeof(Uint16) * Map->W * Map->H);
+    if(!NAV_INSIDE(Map, Field->X, Field->Y)) return;
+
+    /* El objetivo cuenta aunque el agente no pueda pisarlo */
+    c = Field->X + Field->Y * Map->W;
+    Field->Dist[c] = 0;
+    Field->Queue[0] = c;
+    First = 0;
+    Last = 1;
+    while(First < Last) {
+        c = Field->Queue[First++];
+        x = c % Map->W;
+        y = c / Map->W;
+        d = Field->Dist[c] + 1;
+        /* Vecinos: izquierda, derecha, arriba y abajo */
+        for(n = 0; n < 4; n++) {
+            Sint32 nx = x, ny = y, k;
+
+            switch(n) {
+                case 0: nx--; break;
+                case 1: nx++; break;
+                case 2: ny--; break;
+                default: ny++; break;
+            }
+            if(!NAV_INSIDE(Map, nx, ny)) continue;
+            k = nx + ny * Map->W;
+            if(Field->Dist[k] != CRE_NAV_FAR) continue;
+            if(!(Map->Cells[k] & Field->Agents)) continue;
+            Field->Dist[k] = d;
+            Field->Queue[Last++] = k;
+        }
+    }
+}
+
+
+/*
+ * CRE_NavDistance
+ * Distancia de una casilla al objetivo de un campo.
+ */
+Uint16 CRE_NavDistance(creNavField * Field, Sint32 X, Sint32 Y)
+{
+    if(Field == NULL || !NAV_INSIDE(Field->Map, X, Y)) return CRE_NAV_FAR;
+
+    CRE_NavUpdate(Field);
+    return Field->Dist[X + Y * Field->Map->W];
+}
+
+
+/*
+ * CRE_NavBest
+ * Mejores direcciones para acercarse o alejarse del objetivo.
+ */
+Uint8 CRE_NavBest(creNavField * Field, Sint32 X, Sint32 Y, Uint8 Flee)
+{
+    static const Sint32 DX[4] = {-1, 1, 0, 0}, DY[4] = {0, 0, -1, 1};
+    static const Uint8 Dirs[4] = {CRE_NAV_LEFT, CRE_NAV_RIGHT, CRE_NAV_UP,
+        CRE_NAV_DOWN};
+    Uint8 Best = CRE_NAV_NONE;
+    Uint16 BestDist = 0, d;
+    Sint32 n;
+
+    if(CRE_NavDistance(Field, X, Y) == CRE_NAV_FAR) return CRE_NAV_NONE;
+
+    for(n = 0; n < 4; n++) {
+        d = CRE_NavDistance(Field, X + DX[n], Y + DY[n]);
+        if(d == CRE_NAV_FAR) continue;
+        if(Best == CRE_NAV_NONE || (Flee ? d > BestDist : d < BestDist)) {
+            Best = Dirs[n];
+            BestDist = d;
+        } else if(d == BestDist)
+            Best |= Dirs[n];
+    }
+
+    return Best;
+}
+
+
+/*
+ * CRE_NewNavSearch
+ * Crea la memoria de trabajo para buscar caminos en un mapa.
+ */
+creNavSearch * CRE_NewNavSearch(creNavMap * Map)
+{
+    creNavSearch * Search;
+    Sint32 Size;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL) return NULL;
+
+    Search = (creNavSearch *) malloc(sizeof(creNavSearch));
+    if(Search == NULL) return NULL;
+    Size = Map->W * Map->H;
+    Search->Map = Map;
+    Search->Stamp = 0;
+    Search->HeapCount = 0;
+    Search->Marks = (Uint32 *) calloc(Size, sizeof(Uint32));
+    Search->G = (Uint32 *) malloc(sizeof(Uint32) * Size);
+    Search->F = (Uint32 *) malloc(sizeof(Uint32) * Size);
+    Search->Parent = (Sint32 *) malloc(sizeof(Sint32) * Size);
+    Search->Heap = (Sint32 *) malloc(sizeof(Sint32) * Size);
+    Search->HeapPos = (Sint32 *) malloc(sizeof(Sint32) * Size);
+    if(Search->Marks == NULL || Search->G == NULL || Search->F == NULL ||
+      Search->Parent == NULL || Search->Heap == NULL ||
+      Search->HeapPos == NULL) {
+        CRE_FreeNavSearch(Search);
+        return NULL;
+    }
+
+    return Search;
+}
+
+
+/*
+ * CRE_FreeNavSearch
+ * Elimina la memoria de trabajo de bsqueda de caminos.
+ */
+void CRE_FreeNavSearch(creNavSearch * Search)
+{
+    if(Search == NULL) return;
+
+    free(Search->Marks);
+    free(Search->G);
+    free(Search->F);
+    free(Search->Parent);
+    free(Search->Heap);
+    free(Search->HeapPos);
+    free(Search);
+}
+
+
+/*
+ * CRE_NavHeapLess
+ * Orden del montculo: menor coste estimado y, a igualdad, mayor coste desde
+ * el origen (la casilla ms avanzada).
+ */
+Uint8 CRE_NavHeapLess(creNavSearch * Search, Sint32 a, Sint32 b)
+{
+    if(Search->F[a] != Search->F[b]) return Search->F[a] < Search->F[b];
+    return Search->G[a] > Search->G[b];
+}
+
+
+/*
+ * CRE_NavHeapUp
+ * Sube una casilla en el montculo hasta su sitio.
+ */
+void CRE_NavHeapUp(creNavSearch * Search, Sint32 i)
+{
+    Sint32 c = Search->Heap[i], p;
+
+    while(i > 0) {
+        p = (i - 1) / 2;
+        if(!CRE_NavHeapLess(Search, c, Search->Heap[p])) break;
+        Search->Heap[i] = Search->Heap[p];
+        Search->HeapPos[Search->Heap[i]] = i;
+        i = p;
+    }
+    Search->Heap[i] = c;
+    Search->HeapPos[c] = i;
+}
+
+
+/*
+ * CRE_NavHeapPop
+ * Saca la casilla de menor coste del montculo.
+ */
+Sint32 CRE_NavHeapPop(creNavSearch * Search)
+{
+    Sint32 Top = Search->Heap[0], c, i = 0, k;
+
+    c = Search->Heap[--Search->HeapCount];
+    while((k = 2 * i + 1) < Search->HeapCount) {
+        if(k + 1 < Search->HeapCount &&
+          CRE_NavHeapLess(Search, Search->Heap[k + 1], Search->Heap[k]))
+            k++;
+        if(!CRE_NavHeapLess(Search, Search->Heap[k], c)) break;
+        Search->Heap[i] = Search->Heap[k];
+        Search->HeapPos[Search->Heap[i]] = i;
+        i = k;
+    }
+    if(Search->HeapCount > 0) {
+        Search->Heap[i] = c;
+        Search->HeapPos[c] = i;
+    }
+
+    return Top;
+}
+
+
+/*
+ * CRE_NavJumpH
+ * Salta en horizontal desde una casilla hasta encontrar el destino o una
+ * casilla con vecinos forzados. Devuelve la casilla, o -1 si choca.
+ */
+Sint32 CRE_NavJumpH(creNavMap * Map, Uint8 Agents, Sint32 X, Sint32 Y,
+    Sint32 DX, Sint32 Goal)
+{
+    for(;; X += DX) {
+        if(!NAV_WALK(Map, Agents, X, Y)) return -1;
+        if(X + Y * Map->W == Goal) return Goal;
+        if((NAV_WALK(Map, Agents, X, Y - 1) &&
+          !NAV_WALK(Map, Agents, X - DX, Y - 1)) ||
+          (NAV_WALK(Map, Agents, X, Y + 1) &&
+          !NAV_WALK(Map, Agents, X - DX, Y + 1)))
+            return X + Y * Map->W;
+    }
+}
+
+
+/*
+ * CRE_NavJumpV
+ * Salta en vertical desde una casilla. Adems de los vecinos forzados, se
+ * para en las filas desde las que un salto horizontal encuentra algo.
+ */
+Sint32 CRE_NavJumpV(creNavMap * Map, Uint8 Agents, Sint32 X, Sint32 Y,
+    Sint32 DY, Sint32 Goal)
+{
+    for(;; Y += DY) {
+        if(!NAV_WALK(Map, Agents, X, Y)) return -1;
+        if(X + Y * Map->W == Goal) return Goal;
+        if((NAV_WALK(Map, Agents, X - 1, Y) &&
+          !NAV_WALK(Map, Agents, X - 1, Y - DY)) ||
+          (NAV_WALK(Map, Agents, X + 1, Y) &&
+          !NAV_WALK(Map, Agents, X + 1, Y - DY)))
+            return X + Y * Map->W;
+        if(CRE_NavJumpH(Map, Agents, X + 1, Y, 1, Goal) != -1 ||
+          CRE_NavJumpH(Map, Agents, X - 1, Y, -1, Goal) != -1)
+            return X + Y * Map->W;
+    }
+}
+
+
+/*
+ * CRE_NavVisit
+ * Abre (o mejora) una casilla alcanzada desde otra con un coste dado.
+ */
+void CRE_NavVisit(creNavSearch * Search, Sint32 c, Sint32 From, Uint32 G,
+    Sint32 Goal)
+{
+    Sint32 W = Search->Map->W;
+
+    if(Search->Marks[c] == Search->Stamp + 1) return;
+    if(Search->Marks[c] == Search->Stamp && Search->G[c] <= G) return;
+
+    Search->G[c] = G;
+    Search->F[c] = G + abs(c % W - Goal % W) + abs(c / W - Goal / W);
+    Search->Parent[c] = From;
+    if(Search->Marks[c] != Search->Stamp) {
+        Search->Marks[c] = Search->Stamp;
+        Search->Heap[Search->HeapCount] = c;
+        Search->HeapPos[c] = Search->HeapCount++;
+    }
+    CRE_NavHeapUp(Search, Search->HeapPos[c]);
+}
+
+
+/*
+ * CRE_PathFind
+ * A* sobre el mapa; salvo con CRE_PATH_PLAIN, solo se abren los puntos de
+ * salto, que estn siempre en lnea recta con su padre.
+ */
+Sint32 CRE_PathFind(creNavSearch * Search, Uint8 Agents, Sint32 FromX,
+    Sint32 FromY, Sint32 ToX, Sint32 ToY, Uint8 Flags, Sint32 * Path,
+    Sint32 MaxPath)
+{
+    static const Sint32 DX[4] = {-1, 1, 0, 0}, DY[4] = {0, 0, -1, 1};
+    creNavMap * Map;
+    Sint32 Start, Goal, Best, c, n, j, x, y, px, py, Length, Step;
+    Uint32 BestH, h;
+
+    /* Comprobamos los parametros */
+    if(Search == NULL) return -1;
+    Map = Search->Map;
+    if(!NAV_INSIDE(Map, FromX, FromY) || !NAV_INSIDE(Map, ToX, ToY))
+        return -1;
+
+    Start = FromX + FromY * Map->W;
+    Goal = ToX + ToY * Map->W;
+
+    /* Nueva marca; al dar la vuelta hay que limpiar las casillas */
+    Search->Stamp += 2;
+    if(Search->Stamp == 0) {
+        memset(Search->Marks, 0, sizeof(Uint32) * Map->W * Map->H);
+        Search->Stamp = 2;
+    }
+    Search->HeapCount = 0;
+    CRE_NavVisit(Search, Start, -1, 0, Goal);
+    Best = Start;
+    BestH = Search->F[Start];
+
+    while(Search->HeapCount > 0) {
+        c = CRE_NavHeapPop(Search);
+        Search->Marks[c] = Search->Stamp + 1;
+        if(c == Goal) break;
+
+        /* La casilla ms cercana al destino, por si no se llega */
+        h = Search->F[c] - Search->G[c];
+        if(h < BestH || (h == BestH && Search->G[c] < Search->G[Best])) {
+            Best = c;
+            BestH = h;
+        }
+
+        x = c % Map->W;
+        y = c / Map->W;
+        if(Search->Parent[c] != -1) {
+            px = Search->Parent[c] % Map->W;
+            py = Search->Parent[c] / Map->W;
+        } else {
+            px = x;
+            py = y;
+        }
+
+        for(n = 0; n < 4; n++) {
+            /* Vecinos podados: no volvemos hacia el padre */
+            if((px < x && n == 0) || (px > x && n == 1) ||
+              (py < y && n == 2) || (py > y && n == 3))
+                continue;
+
+            if(Flags & CRE_PATH_PLAIN) {
+                if(!NAV_WALK(Map, Agents, x + DX[n], y + DY[n])) continue;
+                j = x + DX[n] + (y + DY[n]) * Map->W;
+            } else if(DX[n] != 0)
+                j = CRE_NavJumpH(Map, Agents, x + DX[n], y, DX[n], Goal);
+            else
+                j = CRE_NavJumpV(Map, Agents, x, y + DY[n], DY[n], Goal);
+            if(j == -1) continue;
+
+            CRE_NavVisit(Search, j, c, Search->G[c] +
+              abs(j % Map->W - x) + abs(j / Map->W - y), Goal);
+        }
+    }
+
+    /* Sin camino al destino */
+    if(Search->Marks[Goal] != Search->Stamp + 1) {
+        if(!(Flags & CRE_PATH_NEAREST)) return -1;
+        /*
+         * Los saltos solo cierran puntos de salto, y la casilla ms cercana
+         * al destino puede estar entre dos, por lo que se busca paso a paso
+         */
+        if(!(Flags & CRE_PATH_PLAIN))
+            return CRE_PathFind(Search, Agents, FromX, FromY, ToX, ToY,
+                Flags | CRE_PATH_PLAIN, Path, MaxPath);
+        Goal = Best;
+    }
+
+    /*
+     * Recorremos el camino hacia atrs, paso a paso entre puntos de salto,
+     * escribiendo solo los pasos que caben
+     */
+    Length = Search->G[Goal];
+    Step = Length;
+    for(c = Goal; c != Start; c = Search->Parent[c]) {
+        x = c % Map->W;
+        y = c / Map->W;
+        px = Search->Parent[c] % Map->W;
+        py = Search->Parent[c] / Map->W;
+        while(x != px || y != py) {
+            if(--Step < MaxPath && Path != NULL)
+                Path[Step] = x + y * Map->W;
+            x += (px > x) - (px < x);
+            y += (py > y) - (py < y);
+        }
+    }
+
+    return Length;
+}
+
+
+/*
+ * CRE_NavPoolRun
+ * Resuelve consultas del lote actual hasta que no quedan libres. Se llama con
+ * el cerrojo del grupo cogido y vuelve con l cogido.
+ */
+void CRE_NavPoolRun(creNavPool * Pool, creNavSearch * Search)
+{
+    creNavQuery * Query;
+
+    while(Pool->Next < Pool->Count) {
+        Query = Pool->Queries + Pool->Next++;
+        SDL_mutexV(Pool->Lock);
+        Query->Result = CRE_PathFind(Search, Query->Agents, Query->FromX,
+          Query->FromY, Query->ToX, Query->ToY, Query->Flags, Query->Path,
+          Query->MaxPath);
+        SDL_mutexP(Pool->Lock);
+        if(--Pool->Pending == 0)
+            SDL_CondSignal(Pool->Done);
+    }
+}
+
+
+/*
+ * CRE_NavPoolThread
+ * Bucle de un hilo de trabajo: espera lotes y resuelve sus consultas.
+ */
+int CRE_NavPoolThread(void * Data)
+{
+    creNavPool * Pool = (creNavPool *) Data;
+    creNavSearch * Search;
+
+    SDL_mutexP(Pool->Lock);
+    /* Cada hilo usa la memoria de trabajo que le toca por orden de arranque */
+    Search = Pool->Searches[++Pool->Started];
+    while(!Pool->Quit) {
+        CRE_NavPoolRun(Pool, Search);
+        if(!Pool->Quit)
+            SDL_CondWait(Pool->Work, Pool->Lock);
+    }
+    SDL_mutexV(Pool->Lock);
+
+    return 0;
+}
+
+
+/*
+ * CRE_NewNavPool
+ * Crea un grupo de hilos para buscar caminos en un mapa.
+ */
+creNavPool * CRE_NewNavPool(creNavMap * Map, Sint32 Threads)
+{
+    creNavPool * Pool;
+    Sint32 i;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL || Threads < 0 || Threads > CRE_NAV_THREADS) return NULL;
+
+    Pool = (creNavPool *) calloc(1, sizeof(creNavPool));
+    if(Pool == NULL) return NULL;
+    Pool->Map = Map;
+    Pool->Lock = SDL_CreateMutex();
+    Pool->Work = SDL_CreateCond();
+    Pool->Done = SDL_CreateCond();
+    if(Pool->Lock == NULL || Pool->Work == NULL || Pool->Done == NULL) {
+        CRE_FreeNavPool(Pool);
+        return NULL;
+    }
+    for(i = 0; i <= Threads; i++)
+        if((Pool->Searches[i] = CRE_NewNavSearch(Map)) == NULL) {
+            CRE_FreeNavPool(Pool);
+            return NULL;
+        }
+
+    /* La memoria de trabajo 0 queda para el hilo que pide los lotes */
+    Pool->ThreadCount = Threads;
+    for(i = 0; i < Threads; i++)
+        if((Pool->Threads[i] = SDL_CreateThread(CRE_NavPoolThread, Pool)) ==
+          NULL) {
+            CRE_FreeNavPool(Pool);
+            return NULL;
+        }
+
+    return Pool;
+}
+
+
+/*
+ * CRE_FreeNavPool
+ * Elimina un grupo de hilos, esperando a que terminen.
+ */
+void CRE_FreeNavPool(creNavPool * Pool)
+{
+    Sint32 i;
+
+    if(Pool == NULL) return;
+
+    if(Pool->Lock != NULL) {
+        SDL_mutexP(Pool->Lock);
+        Pool->Quit = 1;
+        if(Pool->Work != NULL) SDL_CondBroadcast(Pool->Work);
+        SDL_mutexV(Pool->Lock);
+    }
+    for(i = 0; i < CRE_NAV_THREADS; i++)
+        if(Pool->Threads[i] != NULL) SDL_WaitThread(Pool->Threads[i], NULL);
+    for(i = 0; i <= CRE_NAV_THREADS; i++)
+        CRE_FreeNavSearch(Pool->Searches[i]);
+
+    if(Pool->Done != NULL) SDL_DestroyCond(Pool->Done);
+    if(Pool->Work != NULL) SDL_DestroyCond(Pool->Work);
+    if(Pool->Lock != NULL) SDL_DestroyMutex(Pool->Lock);
+    free(Pool);
+}
+
+
+/*
+ * CRE_PathFindBatch
+ * Reparte un lote de consultas entre los hilos del grupo y el que llama.
+ */
+void CRE_PathFindBatch(creNavPool * Pool, creNavQuery * Queries, Sint32 Count)
+{
+    /* Comprobamos los parametros */
+    if(Pool == NULL || Queries == NULL || Count <= 0) return;
+
+    SDL_mutexP(Pool->Lock);
+    Pool->Queries = Queries;
+    Pool->Count = Count;
+    Pool->Next = 0;
+    Pool->Pending = Count;
+    SDL_CondBroadcast(Pool->Work);
+
+    /* Trabajamos tambin nosotros y esperamos a las consultas en marcha */
+    CRE_NavPoolRun(Pool, Pool->Searches[0]);
+    while(Pool->Pending > 0)
+        SDL_CondWait(Pool->Done, Pool->Lock);
+    Pool->Queries = NULL;
+    Pool->Count = Pool->Next = 0;
+    SDL_mutexV(Pool->Lock);
+}
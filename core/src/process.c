@@ -27,38 +27,224 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
 #include "process.h"
 #include "gfx.h"
+#include "render.h"
+#include "profiler.h"
+#include "replay.h"
 
-/*TODO: Los canvas de los procesos siempre se vuelve a dibujar, aunque no hayan
-        cambiado desde la itineracin anterior, consumiendo en estos casos,
-        gran cantidad del tiempo del procesador al aplicar los blendops.
-        Relaizar una propiedad de los procesos denominada Hash que calcule si
-        algn parmetro del proceso anterior ha sido modificado. Si no lo a sido
-        no volver a dibujar el canvas. Datos a tener en cuenta: Graph, SizeW,
-        SizeX, Angle y Alpha. Acosta de ganar tiempo se pierde memoria,
-        comprobar si el gasto es rentable */
+
+/*
+ * Definicin de macros
+ */
+
+/* Nmero de capas, una por cada valor de Z */
+#define LAYERS 256
+
+/* Tamao inicial de una capa */
+#define LAYER_MIN_SIZE 16
+
+/* Bits del Id que indican la entrada en la tabla de manejadores */
+#define HANDLE_BITS 20
+#define HANDLE_MASK ((1 << HANDLE_BITS) - 1)
+/* Mscara de la generacin, que ocupa el resto de bits del Id */
+#define HANDLE_GEN_MASK ((1 << (32 - HANDLE_BITS)) - 1)
+/* Tamao inicial de la tabla y fin de la lista de entradas libres */
+#define HANDLE_MIN_SIZE 64
+#define HANDLE_NONE 0xFFFFFFFF
+
+/* Nmero de listas de la tabla hash de tipos (potencia de 2) */
+#define TYPE_HASH_SIZE 64
+
+/* Alineacin y nmero de tamaos de bloque del almacn de procesos */
+#define POOL_ALIGN 16
+#define POOL_CLASSES 64
+/* Nmero de bloques de cada tira de memoria del almacn */
+#define POOL_SLAB_CHUNKS 64
+/* Tamao de la cabecera del bloque, antes de los datos de la instancia */
+#define POOL_HEADER ((sizeof(creProcess) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+/* Tamao de bloque (en unidades de POOL_ALIGN) para Size bytes de datos */
+#define POOL_CLASS(Size) ((POOL_HEADER + (Size) + POOL_ALIGN - 1) / POOL_ALIGN)
+
+/* Variables locales a cada hilo */
+#ifdef _MSC_VER
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL __thread
+#endif
+
+
+/*
+ * Definicin de tipos
+ */
+
+/*
+ * Capa de procesos con la misma Z. Los procesos eliminados dejan un hueco
+ * (NULL) hasta que se compacta la capa.
+ */
+typedef struct creLayer {
+    creProcess ** Items;
+    Uint32 Count, Size, Holes;
+} creLayer;
+
+/*
+ * Entrada de la tabla de manejadores. La generacin se incrementa cada vez
+ * que la entrada se asigna a un proceso nuevo.
+ */
+typedef struct creHandle {
+    creProcess * Process;
+    Uint32 Gen;
+    /* Siguiente entrada libre */
+    Uint32 NextFree;
+} creHandle;
+
+/*
+ * Lista de los procesos de un tipo. Las listas se guardan en una tabla hash
+ * y no se eliminan aunque se queden vacas.
+ */
+typedef struct creTypeIndex {
+    Uint16 Type;
+    Uint32 Count;
+    creProcess * First;
+    struct creTypeIndex * Next;
+} creTypeIndex;
+
+/*
+ * Almacn de bloques de un tamao. Los bloques se sirven de tiras de
+ * POOL_SLAB_CHUNKS bloques contiguos, primero los liberados y despus los
+ * que an no se han usado de la tira actual. Las tiras no se liberan, se
+ * reutilizan cuando el almacn se vaca.
+ */
+typedef struct crePool {
+    Uint8 ** Slabs;
+    Uint32 SlabCount, SlabSize;
+    /* Tira actual y bloques usados de ella */
+    Uint32 Slab, Used;
+    /* Lista de bloques liberados, enlazados por su primer puntero */
+    void * FreeList;
+    /* Bloques en uso */
+    Uint32 Live;
+} crePool;
+
+
+/*
+ * Mundo de procesos. Contiene todo el estado del bucle de procesos.
+ */
+struct creWorld {
+    /* Indica si un bucle se esta ejecutando */
+    Uint8 AnyLoop;
+    /* Indica si el bucle funciona sin pantalla */
+    Uint8 Headless;
+    /* Fuente de eventos que sustituye a SDL_PollEvent, y su argumento */
+    creEventSource EventFunc;
+    void * EventArg;
+    /* Indica si el bucle avanza sin esperas */
+    Uint8 FastForward;
+    /* Reloj virtual en nanosegundos, e instante real del ltimo paso */
+    Uint64 Clock, ClockLast;
+    /* Puntero a la superficie de pantalla */
+    SDL_Surface * Screen;
+    /* Capas de procesos, de menor a mayor Z, y nmero de procesos en ellas */
+    creLayer Layers[LAYERS];
+    Uint32 ProcessCount;
+    /* Pasada actual del bucle de ejecucin */
+    Uint32 RunPass;
+    /* Tabla de manejadores: entradas usadas alguna vez y memoria reservada */
+    creHandle * Handles;
+    Uint32 HandlesUsed, HandlesSize;
+    /*
+     * Lista de entradas libres. Se reutiliza primero la que lleva ms tiempo
+     * libre, para que un mismo Id tarde lo mximo posible en repetirse.
+     */
+    Uint32 FreeFirst, FreeLast;
+    /* Tabla hash con las listas de procesos de cada tipo */
+    creTypeIndex * Types[TYPE_HASH_SIZE];
+    /* Almacenes de procesos, uno por cada tamao de bloque */
+    crePool Pools[POOL_CLASSES + 1];
+    /* Duracin en nanosegundos de un paso (El iverso de FPS), 0 sin lmite */
+    Uint64 Step;
+    /* Modo de control de la velocidad */
+    Uint8 Timestep;
+    /* Tiempo sin simular e instante en que se acumul por ltima vez */
+    Uint64 Accumulator, LastTime;
+    /* Velocidad real del juego en FPS */
+    float RealFPS;
+    /* Estructura que contiene los eventos de cada frame */
+    creEventsList EList;
+    /* Color con el que se limpia la panatalla */
+    Uint32 ClearColor;
+    /* Generador de nmeros aleatorios y grabacin */
+    creReplayState Replay;
+    /* Datos propios del juego, y funcin que los libera con el mundo */
+    void * Data;
+    creDataFree DataFree;
+};
+
+/*
+ * Reparto de los mundos de CRE_RunWorlds entre sus hilos.
+ */
+typedef struct creWorldRun {
+    creWorld ** Worlds;
+    Uint32 Count, Next, Ran;
+    creWorldEntry Entry;
+    void * Arg;
+    SDL_mutex * Lock;
+} creWorldRun;
 
 
 /*
  * Variables gloables al fichero
  */
 
-/* Indica si un bucle se esta ejecutando */
-Uint8 creAnyLoop = 0;
-/* Puntero a la superficie de pantalla */
-SDL_Surface * creScreen = NULL;
-/* Puntero al primer proceso */
-creProcess * creFirstProcess = NULL;
-/* Velocidad del juego en SPF (El iverso de FPS) */
-Uint32 creSPF = 0;
-/* Velocidad real del juego en FPS */
-float creRealFPS = 0;
-/* Estructura que contiene los eventos de cada frame */
-creEventsList creEList;
-/* Color con el que se limpia la panatalla */
-Uint32 creClearColor = 0;
+/* Mundo por defecto, el actual de cada hilo mientras no se cambie */
+creWorld creDefaultWorld = {
+    .FreeFirst = HANDLE_NONE,
+    .FreeLast = HANDLE_NONE,
+    .Timestep = CRE_TIMESTEP_VARIABLE,
+    .Replay = { .Random = CRE_RANDOM_SEED }
+};
+/* Mundo actual de cada hilo */
+THREAD_LOCAL creWorld * creWorldNow = &creDefaultWorld;
+
+/*
+ * El estado del bucle se lee siempre del mundo actual. creScreen y creEList
+ * se usan fuera del fichero a travs de funciones; aqu se leen directamente.
+ */
+#undef creScreen
+#undef creEList
+#define creAnyLoop (creWorldNow->AnyLoop)
+#define creHeadless (creWorldNow->Headless)
+#define creEventFunc (creWorldNow->EventFunc)
+#define creEventArg (creWorldNow->EventArg)
+#define creFastForward (creWorldNow->FastForward)
+#define creClock (creWorldNow->Clock)
+#define creClockLast (creWorldNow->ClockLast)
+#define creScreen (creWorldNow->Screen)
+#define creLayers (creWorldNow->Layers)
+#define creProcessCount (creWorldNow->ProcessCount)
+#define creRunPass (creWorldNow->RunPass)
+#define creHandles (creWorldNow->Handles)
+#define creHandlesUsed (creWorldNow->HandlesUsed)
+#define creHandlesSize (creWorldNow->HandlesSize)
+#define creFreeFirst (creWorldNow->FreeFirst)
+#define creFreeLast (creWorldNow->FreeLast)
+#define creTypes (creWorldNow->Types)
+#define crePools (creWorldNow->Pools)
+#define creStep (creWorldNow->Step)
+#define creTimestep (creWorldNow->Timestep)
+#define creAccumulator (creWorldNow->Accumulator)
+#define creLastTime (creWorldNow->LastTime)
+#define creRealFPS (creWorldNow->RealFPS)
+#define creEList (creWorldNow->EList)
+#define creClearColor (creWorldNow->ClearColor)
 
 
 /*
@@ -67,14 +253,63 @@ Uint32 creClearColor = 0;
 
 
 /*
- * CRE_GetNewPId
- * Devuelve una nueva id para un proceso vlida y nico para l.
+ * CRE_NewHandle
+ * Asigna una entrada de la tabla de manejadores a un proceso y devuelve su
+ * Id, o 0 si la tabla esta llena.
+ */
+Uint32 CRE_NewHandle(creProcess * Process)
+{
+    creHandle * Handles;
+    Uint32 i, Size;
+
+    /* Reutilizamos la entrada libre ms antigua */
+    if(creFreeFirst != HANDLE_NONE) {
+        i = creFreeFirst;
+        creFreeFirst = creHandles[i].NextFree;
+        if(creFreeFirst == HANDLE_NONE)
+            creFreeLast = HANDLE_NONE;
+    /* O usamos una nueva, ampliando la tabla si es necesario */
+    } else {
+        if(creHandlesUsed == creHandlesSize) {
+            if(creHandlesSize > HANDLE_MASK)
+                return 0;
+            Size = creHandlesSize ? creHandlesSize * 2 : HANDLE_MIN_SIZE;
+            Handles = (creHandle *) realloc(creHandles,
+                Size * sizeof(creHandle));
+            if(Handles == NULL)
+                return 0;
+            creHandles = Handles;
+            creHandlesSize = Size;
+        }
+        i = creHandlesUsed++;
+        creHandles[i].Gen = 0;
+    }
+
+    /* La generacin nunca es 0, as ningn Id vlido es 0 */
+    creHandles[i].Gen = (creHandles[i].Gen + 1) & HANDLE_GEN_MASK;
+    if(creHandles[i].Gen == 0)
+        creHandles[i].Gen = 1;
+    creHandles[i].Process = Process;
+
+    return (creHandles[i].Gen << HANDLE_BITS) | i;
+}
+
+
+/*
+ * CRE_FreeHandle
+ * Libera la entrada de la tabla de manejadores de un proceso.
  */
-__inline Uint32 CRE_GetNewPId(void)
+void CRE_FreeHandle(creProcess * Process)
 {
-    static Uint32 IdCount = 1;
+    Uint32 i = Process->Id & HANDLE_MASK;
 
-    return IdCount++;
+    creHandles[i].Process = NULL;
+    creHandles[i].NextFree = HANDLE_NONE;
+    if(creFreeLast == HANDLE_NONE)
+        creFreeFirst = i;
+    else
+        creHandles[creFreeLast].NextFree = i;
+    creFreeLast = i;
 }
 
 
@@ -85,16 +320,46 @@ __inline Uint32 CRE_GetNewPId(void)
  */
 void CRE_UpdateEList(void)
 {
+    Uint32 Size;
+
     /* Reinicializamos la lista */
     creEList.Size = 0;
 
+    /* Con una fuente de eventos, ella los entrega todos */
+    if(creEventFunc != NULL) {
+        Size = creEventFunc(creEList.Events, CRE_MAX_SIM_EVENTS, creEventArg);
+        creEList.Size = Size < CRE_MAX_SIM_EVENTS ? Size : CRE_MAX_SIM_EVENTS;
+        return;
+    }
+
+    /* Sin pantalla no hay eventos de SDL */
+    if(creHeadless)
+        return;
+
     /* Mientra haya eventos que procesar y espacio para almacenarlos */
     while(SDL_PollEvent(creEList.Events + creEList.Size) && (creEList.Size < CRE_MAX_SIM_EVENTS)){
-        /* Si esta definido el modo debug */
+        /*
+         * Si esta definido el modo debug, F10 muestra el estado de los
+         * procesos y las medidas, F11 activa o desactiva las medidas y F12
+         * las vuelca a un fichero.
+         */
         #ifdef CRE_PROCESS_DEBUG_MODE
-            if(creEList.Events[creEList.Size].type == SDL_KEYDOWN &&
-                creEList.Events[creEList.Size].key.keysym.sym == SDLK_F10)
-                CRE_GetProcessesInfo(CRE_PROCESS_DEBUG_FILE);
+            if(creEList.Events[creEList.Size].type == SDL_KEYDOWN)
+                switch(creEList.Events[creEList.Size].key.keysym.sym) {
+                    case SDLK_F10:
+                        CRE_GetProcessesInfo(CRE_PROCESS_DEBUG_FILE);
+                        if(CRE_IsProfilerEnabled())
+                            CRE_ProfilerReport(CRE_PROCESS_DEBUG_FILE);
+                        break;
+                    case SDLK_F11:
+                        CRE_EnableProfiler(!CRE_IsProfilerEnabled());
+                        break;
+                    case SDLK_F12:
+                        CRE_ProfilerDump(CRE_PROFILER_FILE);
+                        break;
+                    default:
+                        break;
+                }
         #endif
         /* Actualizamos la lista de eventos */
         creEList.Size++;
@@ -104,165 +369,227 @@ void CRE_UpdateEList(void)
 
 
 /*
- * CRE_MainLoop
- * Fucnin que contiene el bucle principal de gestin de procesos. Es el
- * encargado de cuidar el estado de los procesos, as, si alguno tiene el flag
- * de "muerto" lo elimina, si esta "congelado" no lo ejecuta, etc. Como se ha
- * dicho, tambin ejecuta el mtodo loop de todos los procesos que permiten
- * a estos actualizar sus valores. Luego, despus de ejecutar cada proceso
- * hace un blit de su grfico asociado a pantalla. Este bucle tambin es el
- * encargado de actualizar la lista de eventos en cada instante, para que los
- * procesos puedan acceder a ellos sin problemas e interaccionar con el usuario.
- * Tambin es el encargado de gestionar la velocidad del juego. Pa ello se
- * establece una velocidad en FPS, y si el proceso de ejecucin a sido ms
- * rpido q los SPF (FPS^-1) el bucle espera para funcionar a la velocidad
- * adecuada.
+ * CRE_LayerAppend
+ * Aade un proceso al final de la capa indicada, ampliando sta si es
+ * necesario.
  */
-Sint32 CRE_MainLoop(void)
+Sint32 CRE_LayerAppend(creProcess * Process, Uint8 Z)
 {
-    /* Proceso que hemos ejecutado en el ciclo anterior */
-    creProcess * LastProcess;
-    /* Proceso que vamos a ejecutar en un determinado ciclo */
-    creProcess * CurrentProcess;
-    /* Punteros a procesos que son utilizados cuando se ordena la lista */
-    creProcess * SortPro1, * SortPro2;
-    /* Rectngulo usado temporalmente para el blit grfico */
-    SDL_Rect GfxRect;
-    /* Indica el tiempo en ms que hemos tardado en ejecutar cada ciclo */
-    Uint32 CurrentTime;
-    /* Indica el tiempo que debe esperar el bucle */
-    Sint32 WaitTime;
-    /* Superficie temporal de dibujo, lienzo */
-    SDL_Surface * Canvas = NULL;
+    creLayer * l = creLayers + Z;
+    creProcess ** Items;
+    Uint32 Size;
+
+    if(l->Count == l->Size) {
+        Size = l->Size ? l->Size * 2 : LAYER_MIN_SIZE;
+        Items = (creProcess **) realloc(l->Items, Size * sizeof(creProcess *));
+        if(Items == NULL)
+            return -1;
+        l->Items = Items;
+        l->Size = Size;
+    }
 
-    /* Limpiamos los todos los eventos pendientes */
-    while(SDL_PollEvent(creEList.Events));
+    Process->Layer = Z;
+    Process->Slot = l->Count;
+    l->Items[l->Count++] = Process;
 
-    /*
-     * Mientras el usuario indique el bucle debe ejecutarse, y haya algn
-     * proceso que gestionar.
-     */
-    while(creAnyLoop && creFirstProcess != NULL && creScreen != NULL) {
+    return 0;
+}
 
-        /* Iniciamos el contador del tiempo para controlar los FPS */
-        CurrentTime = SDL_GetTicks();
 
-        /*  Recogemos los eventos que han sucedido hasta el momento */
-        CRE_UpdateEList();
+/*
+ * CRE_LayerRemove
+ * Quita un proceso de su capa dejando un hueco, que se elimina ms tarde al
+ * compactar la capa. As no se desplaza ningn proceso mientras se recorre.
+ */
+void CRE_LayerRemove(creProcess * Process)
+{
+    creLayer * l = creLayers + Process->Layer;
 
-        /*
-         * Buscamos entre la lista procesos que tengan estado de 'muerto' y los
-         * eliminamos de la lista, tambin nos encargamos de liberar la memoria
-         * de la instancia de forma manual (llamando al metodo free de la
-         * instancia).
-         */
+    l->Items[Process->Slot] = NULL;
+    l->Holes++;
+}
 
-        /* Preparamos los punteros para recorrer la lista */
-        LastProcess = NULL;
-        CurrentProcess = creFirstProcess;
 
-        /* Recorremos la lista */
-        while(CurrentProcess != NULL) {
-            /* Comprobamos si tiene el estado de muerto */
-            if((CurrentProcess->State & CRE_PS_DEAD) >> 3) {
-                /* Si es el primero de la lista */
-                if(LastProcess == NULL) {
-                    /* Actualizamos la lista */
-                    creFirstProcess = CurrentProcess->Next;
-                    /* Eliminamos el proceso */
-                    if(CurrentProcess->Free != NULL)
-                        CurrentProcess->Free(CurrentProcess);
-                    /* Continuamos recorriendo la lista */
-                    CurrentProcess = creFirstProcess;
-                /* Si esta en cualquier otra posicin */
-                } else {
-                    /* Actualizamos la lista */
-                    LastProcess->Next = CurrentProcess->Next;
-                    /* Eliminamos el proceso */
-                    if(CurrentProcess->Free != NULL)
-                        CurrentProcess->Free(CurrentProcess);
-                    /* Continuamos recorriendo la lista */
-                    CurrentProcess = LastProcess->Next;
-                }
-            /* Si no esta muerto continuamos normalmente */
-            } else {
-                LastProcess = CurrentProcess;
-                CurrentProcess = CurrentProcess->Next;
-            }
-        }
+/*
+ * CRE_CompactLayers
+ * Elimina los huecos de las capas en las que ocupan ms de la mitad, sin
+ * alterar el orden de los procesos. Cada hueco se elimina una sola vez, por
+ * lo que el coste se reparte entre los procesos eliminados.
+ */
+void CRE_CompactLayers(void)
+{
+    creLayer * l;
+    Uint32 z, i, n;
 
-        /* Verificamos que qeda algn proceso vivo */
-        if(creFirstProcess == NULL)
+    for(z = 0; z < LAYERS; z++) {
+        l = creLayers + z;
+        if(l->Holes == 0 || l->Holes * 2 < l->Count)
             continue;
+        for(i = n = 0; i < l->Count; i++)
+            if(l->Items[i] != NULL) {
+                l->Items[i]->Slot = n;
+                l->Items[n++] = l->Items[i];
+            }
+        l->Count = n;
+        l->Holes = 0;
+    }
+}
 
-        /*
-         * Actualizamos la lista de procesos y observamos si esta bien ordenada
-         * con respecto a Z de cada proceso. Por defecto, los procesos se aaden
-         * a la lista de forma ordenada (de menor Z a mayor Z), pero es posible
-         * que un proceso cambie su Z, por lo que debemos reorganizar la lista.
-         */
 
-        /* Preparamos los punteros para recorrer la lista */
-        LastProcess = creFirstProcess;
-        CurrentProcess = LastProcess->Next;
-
-        /* Recorremos la lista */
-        while(CurrentProcess != NULL) {
-            /* Si el elemento esta desordenado, buscamos su posicin */
-            if(CurrentProcess->Z < LastProcess->Z) {
-                /* Caso especial, su posicin es la primera de la lista  */
-                if(CurrentProcess->Z <= creFirstProcess->Z) {
-                    /* Desenlazamos el elemento */
-                    LastProcess->Next = CurrentProcess->Next;
-                    /* Y lo enlazamos en la primera posicin */
-                    CurrentProcess->Next = creFirstProcess;
-                    creFirstProcess = CurrentProcess;
-                /* Caso general, buscamos su posicin */
-                } else {
-                    /* Preparamos punteros para volver a recorrer la lista */
-                    SortPro1 = creFirstProcess;
-                    SortPro2 = SortPro1->Next;
-                    /* Recorremos la lista hasta que econtramos su sitio */
-                    while(SortPro2 != NULL) {
-                        if(CurrentProcess->Z <= SortPro2->Z)
-                            break;
-                        SortPro1 = SortPro2;
-                        SortPro2 = SortPro2->Next;
-                    }
-                    /* Desenlazamos el elemento */
-                    LastProcess->Next = CurrentProcess->Next;
-                    /* Y lo enlazamos en su nueva posicin */
-                    SortPro1->Next = CurrentProcess;
-                    CurrentProcess->Next = SortPro2;
-                }
-                /* Avanzamos, pero solo CurrentProcess, ya que es diferente */
-                CurrentProcess = LastProcess->Next;
-            /* Si el elemento esta ordenado continuamos al siguiente */
-            } else {
-            /* Avanzamos los punteros  de la lista */
-            LastProcess = CurrentProcess;
-            CurrentProcess = CurrentProcess->Next;
-            }
+/*
+ * CRE_ClearLayers
+ * Vaca todas las capas sin liberar su memoria.
+ */
+void CRE_ClearLayers(void)
+{
+    creTypeIndex * Index;
+    Uint32 z;
+
+    for(z = 0; z < LAYERS; z++)
+        creLayers[z].Count = creLayers[z].Holes = 0;
+    creProcessCount = 0;
+
+    /* Las listas de tipos se conservan, vacas */
+    for(z = 0; z < TYPE_HASH_SIZE; z++)
+        for(Index = creTypes[z]; Index != NULL; Index = Index->Next) {
+            Index->Count = 0;
+            Index->First = NULL;
         }
+}
+
+
+/*
+ * CRE_GetTypeIndex
+ * Devuelve la lista de procesos de un tipo. Si no existe y Create lo indica
+ * la crea, en caso contrario devuelve NULL.
+ */
+creTypeIndex * CRE_GetTypeIndex(Uint16 Type, Uint8 Create)
+{
+    creTypeIndex ** Link = creTypes + (Type & (TYPE_HASH_SIZE - 1));
+    creTypeIndex * Index;
+
+    for(Index = *Link; Index != NULL; Index = Index->Next)
+        if(Index->Type == Type)
+            return Index;
+
+    if(!Create)
+        return NULL;
+
+    Index = (creTypeIndex *) malloc(sizeof(creTypeIndex));
+    if(Index == NULL)
+        return NULL;
+    Index->Type = Type;
+    Index->Count = 0;
+    Index->First = NULL;
+    Index->Next = *Link;
+    *Link = Index;
+
+    return Index;
+}
+
+
+/*
+ * CRE_TypeLink
+ * Aade un proceso al principio de la lista de su tipo.
+ */
+Sint32 CRE_TypeLink(creProcess * Process)
+{
+    creTypeIndex * Index = CRE_GetTypeIndex(Process->Type, 1);
 
+    if(Index == NULL)
+        return -1;
+
+    Process->TypePrev = NULL;
+    Process->TypeNext = Index->First;
+    if(Index->First != NULL)
+        Index->First->TypePrev = Process;
+    Index->First = Process;
+    Index->Count++;
+
+    return 0;
+}
+
+
+/*
+ * CRE_TypeUnlink
+ * Quita un proceso de la lista de su tipo.
+ */
+void CRE_TypeUnlink(creProcess * Process)
+{
+    creTypeIndex * Index = CRE_GetTypeIndex(Process->Type, 0);
+
+    if(Process->TypePrev != NULL)
+        Process->TypePrev->TypeNext = Process->TypeNext;
+    else
+        Index->First = Process->TypeNext;
+    if(Process->TypeNext != NULL)
+        Process->TypeNext->TypePrev = Process->TypePrev;
+    Index->Count--;
+}
+
+
+/*
+ * CRE_ReapProcess
+ * Elimina de la lista un proceso con el estado de 'muerto', tambin se
+ * encarga de liberar la memoria de la instancia de forma manual (llamando al
+ * metodo free de la instancia).
+ */
+void CRE_ReapProcess(creProcess * Process)
+{
+    /* La zona que ocupaba el proceso debe redibujarse */
+    if(!creHeadless)
+        CRE_DirtyProcess(Process);
+    /* Lo quitamos de su capa y su tipo y su Id deja de ser vlido */
+    CRE_LayerRemove(Process);
+    CRE_TypeUnlink(Process);
+    CRE_FreeHandle(Process);
+    creProcessCount--;
+    /* Eliminamos el proceso */
+    if(Process->Free != NULL)
+        Process->Free(Process);
+}
 
-        /* Preparamos las variables para recorrer la lista de procesos */
-        LastProcess = NULL;
-        CurrentProcess = creFirstProcess;
 
+/*
+ * CRE_RunProcesses
+ * Recorre las capas de menor a mayor Z. Elimina los procesos muertos, ejecuta
+ * los mtodos loop del resto y, si Draw lo indica, hace el blit bsico del
+ * grfico de cada proceso a la pantalla. Los procesos que han cambiado su Z
+ * se pasan a su nueva capa despus de ejecutarse.
+ */
+void CRE_RunProcesses(Uint8 Draw)
+{
+    /* Proceso que vamos a ejecutar */
+    creProcess * CurrentProcess;
+    /* Tipo del proceso, que se mide despus de que el loop lo pueda liberar */
+    Uint16 Type;
+    /* Capa y posicin que se recorren */
+    Uint32 z, i;
+    /* Inicio de la medida del mtodo loop */
+    Uint32 ProfTime;
+    /* Indica si se dibuja a travs del almacn de dibujado */
+    Uint8 Store = Draw && CRE_GetRenderMode() == CRE_RENDER_STORE;
+
+    /* Identificamos la pasada para no ejecutar dos veces un proceso movido */
+    creRunPass++;
+
+    for(z = 0; z < LAYERS; z++)
         /*
-         * En este bucle se actuliza el estado de los procesos, se ejecutan
-         * sus mtodos loop, se actualiza el estado del bucle principal y se
-         * hace el blit bsico del grfico del proceso a la pantalla.
+         * Las capas se recorren desde el final, de modo que el ltimo
+         * proceso aadido a una Z se ejecute y dibuje el primero
          */
-        while(CurrentProcess != NULL) {
+        for(i = creLayers[z].Count; i-- > 0; ) {
 
-            /* Para poder ejecutar un proceso hay que tener en cuenta dos
-             * flags de estado muy importantes que alteran radicalmente el
-             * comportamiento de ste. El primero es "dead" en cuyo caso
-             * eliminamos el proceso y actualizamos la lista de proceso. El
-             * segundo es "wakeup", en el cual debemos restablecer los flags.
-             */
+            CurrentProcess = creLayers[z].Items[i];
+            if(CurrentProcess == NULL || CurrentProcess->Pass == creRunPass)
+                continue;
+
+            /* Los procesos muertos no se ejecutan, se eliminan */
+            if((CurrentProcess->State & CRE_PS_DEAD) >> 3) {
+                CRE_ReapProcess(CurrentProcess);
+                continue;
+            }
+            CurrentProcess->Pass = creRunPass;
 
             /* Comprobamos el estado de "wakeup" por si debemos restablecerlo */
             if((CurrentProcess->State & CRE_PS_WAKEUP) >> 7)
@@ -276,86 +603,244 @@ Sint32 CRE_MainLoop(void)
              */
             if((CurrentProcess->Loop != NULL) &&
                !((CurrentProcess->State & CRE_PS_PAUSE) >> 6) &&
-               !((CurrentProcess->State & CRE_PS_FREEZE) >> 4))
+               !((CurrentProcess->State & CRE_PS_FREEZE) >> 4)) {
+                /*
+                 * Si el loop acaba el bucle se liberan todos los procesos,
+                 * este incluido, por lo que su tipo se guarda antes
+                 */
+                Type = CurrentProcess->Type;
+                ProfTime = CRE_ProfilerBegin();
                 CurrentProcess->Loop(CurrentProcess);
+                CRE_ProfilerMarkType(Type, CRE_PROF_LOOP, ProfTime,
+                    CRE_ProfilerMark(CRE_PROF_LOOP, ProfTime));
+            }
 
             /* Comprobamos si el proceso ha indicado que el bucle no continue */
-            if(!creAnyLoop || creFirstProcess == NULL) break;
-
-            /* Limpiamos el lienzo antes de dibujar */
-            if(Canvas != NULL) {
-                SDL_FreeSurface(Canvas);
-                Canvas = NULL;
-            }
+            if(!creAnyLoop || creProcessCount == 0) return;
 
             /*
              * Hacemos el blit del grfico del proceso a pantalla si el estado
-             * del proceso as lo indica y hay un grfico disponible.
+             * del proceso as lo indica y hay un grfico disponible. En el
+             * modo CRE_RENDER_STORE solo se guarda y se dibuja al acabar.
              */
+            if(Store)
+                CRE_StoreProcess(CurrentProcess, creScreen);
+            else if(Draw)
+                CRE_DrawProcess(CurrentProcess, creScreen);
+
+            /* Si ha cambiado de Z lo pasamos a su nueva capa */
+            if(CurrentProcess->Z != z &&
+               CRE_LayerAppend(CurrentProcess, CurrentProcess->Z) == 0) {
+                creLayers[z].Items[i] = NULL;
+                creLayers[z].Holes++;
+            }
+        }
+}
 
-            if(CurrentProcess->Graph != NULL &&
-               !((CurrentProcess->State & CRE_PS_GHOST) >> 5) &&
-               !((CurrentProcess->State & CRE_PS_FREEZE) >> 4)) {
-                /*
-                 * Dependiendo de las caracterias del proceso: tamao y ngulo
-                 * Aplicamos las transformaciones necesarias o no
-                 */
 
-                if(CurrentProcess->Angle != 0 || CurrentProcess->SizeW != 100
-                    || CurrentProcess->SizeH != 100) {
-                    Canvas = CRE_GfxRZSurfaceXY(CurrentProcess->Graph,
-                    CurrentProcess->Angle / 1000.0f,
-                    CurrentProcess->SizeW / 100.0f,
-                    CurrentProcess->SizeH / 100.0f,
-                    (CurrentProcess->State & CRE_PS_HIGHGFX) >> 1);
-                }
+/*
+ * CRE_PaceFrame
+ * Espera hasta que toca empezar un nuevo frame y devuelve cuntos pasos de
+ * simulacin debe ejecutar. El tiempo transcurrido se acumula en
+ * creAccumulator y cada paso consume creStep nanosegundos.
+ */
+Uint32 CRE_PaceFrame(void)
+{
+    Uint64 Now;
+    Uint32 Steps;
 
-                /* Si no se a aplicado ningn cambio, dibujamos tal cual */
-                if(Canvas == NULL) {
-                    /* Preparamos las coordenadas para el blit */
-                    GfxRect.x = CurrentProcess->X -
-                        (CurrentProcess->Graph->w / 2);
-                    GfxRect.y = CurrentProcess->Y -
-                        (CurrentProcess->Graph->h / 2);
-                    /* Dibujamos el grfico directamente */
-                    CRE_GfxAlphaBlit(CurrentProcess->Graph, creScreen, &GfxRect,
-                        CurrentProcess->Alpha);
-                /* Si hemos aplicado algun cambio, dibujamos el Canvas Temp. */
-                } else {
-                    /* Preparamos las coordenadas para el blit */
-                    GfxRect.x = CurrentProcess->X - (Canvas->w / 2);
-                    GfxRect.y = CurrentProcess->Y - (Canvas->h / 2);
-                    /* Dibujamos el Canvas */
-                    CRE_GfxAlphaBlit(Canvas, creScreen, &GfxRect,
-                        CurrentProcess->Alpha);
-                }
+    /*
+     * Sin lmite de velocidad, sin pantalla o en avance rpido se ejecuta un
+     * paso lo antes posible
+     */
+    if(creStep == 0 || creHeadless || creFastForward)
+        return 1;
+
+    /* Acumulamos el tiempo y, si no llega a un paso, esperamos */
+    Now = CRE_GetTime();
+    creAccumulator += Now - creLastTime;
+    creLastTime = Now;
+    if(creAccumulator < creStep) {
+        CRE_WaitUntil(Now + (creStep - creAccumulator));
+        Now = CRE_GetTime();
+        creAccumulator += Now - creLastTime;
+        creLastTime = Now;
+    }
 
-            }
+    /* En el modo fijo se recuperan los pasos atrasados */
+    if(creTimestep == CRE_TIMESTEP_FIXED) {
+        Steps = (Uint32) (creAccumulator / creStep);
+        if(Steps > CRE_MAX_STEPS) {
+            Steps = CRE_MAX_STEPS;
+            creAccumulator %= creStep;
+        } else
+            creAccumulator -= Steps * creStep;
+    /* En el variable un frame lento no se recupera */
+    } else {
+        Steps = 1;
+        creAccumulator -= creStep;
+        if(creAccumulator >= creStep)
+            creAccumulator = 0;
+    }
+
+    return Steps;
+}
 
-            /* Continuamos al elemento siguiente */
-            LastProcess = CurrentProcess;
-            CurrentProcess = CurrentProcess->Next;
 
-        }
+/*
+ * CRE_TickClock
+ * Avanza el reloj virtual un paso del bucle.
+ */
+void CRE_TickClock(void)
+{
+    Uint64 Now;
+
+    /* Sin lmite de FPS los pasos duran lo que tardan de verdad */
+    if(creStep != 0)
+        creClock += creStep;
+    else {
+        Now = CRE_GetTime();
+        creClock += Now - creClockLast;
+        creClockLast = Now;
+    }
+}
+
+
+/*
+ * CRE_MainLoop
+ * Fucnin que contiene el bucle principal de gestin de procesos. Es el
+ * encargado de cuidar el estado de los procesos, as, si alguno tiene el flag
+ * de "muerto" lo elimina, si esta "congelado" no lo ejecuta, etc. Como se ha
+ * dicho, tambin ejecuta el mtodo loop de todos los procesos que permiten
+ * a estos actualizar sus valores. Luego, despus de ejecutar cada proceso
+ * hace un blit de su grfico asociado a pantalla. Este bucle tambin es el
+ * encargado de actualizar la lista de eventos en cada instante, para que los
+ * procesos puedan acceder a ellos sin problemas e interaccionar con el usuario.
+ * Tambin es el encargado de gestionar la velocidad del juego. Pa ello se
+ * establece una velocidad en FPS, y cada frame espera, con un reloj de alta
+ * resolucin, a que haya transcurrido el tiempo de un paso (FPS^-1). En el
+ * modo de paso fijo los mtodos loop se ejecutan tantas veces como pasos se
+ * hayan acumulado, pero el frame se dibuja una sola vez. En el modo sin
+ * pantalla solo se ejecutan los mtodos loop, un paso por vuelta y sin
+ * esperas.
+ */
+Sint32 CRE_MainLoop(void)
+{
+    /* Indica si el frame se dibuja por rectngulos sucios */
+    Uint8 Dirty;
+    /* Pasos de simulacin del frame y paso actual */
+    Uint32 Steps, Step;
+    /* Final del frame anterior y del actual, para calcular los FPS reales */
+    Uint64 LastFrame, Frame;
+    /* Duracin media de los frames en nanosegundos */
+    float FrameTime = 0;
+    /* Inicio del frame y de la fase que se est midiendo */
+    Uint32 ProfFrame, ProfTime;
+
+    /* Limpiamos los todos los eventos pendientes */
+    if(!creHeadless && creEventFunc == NULL)
+        while(SDL_PollEvent(creEList.Events));
 
-        /* Actualizamos la pantalla */
-        SDL_Flip(creScreen);
+    /* El primer frame empieza sin esperar */
+    creLastTime = creClockLast = CRE_GetTime();
+    creAccumulator = creStep;
+    LastFrame = 0;
+    creRealFPS = 0;
+
+    /*
+     * Mientras el usuario indique el bucle debe ejecutarse, y haya algn
+     * proceso que gestionar.
+     */
+    while(creAnyLoop && creProcessCount != 0 &&
+      (creScreen != NULL || creHeadless)) {
+
+        /* Esperamos al momento de empezar el frame */
+        Steps = CRE_PaceFrame();
+        ProfFrame = CRE_ProfilerBegin();
 
         /*
-         * Una vez ejecutado todos los procesos, y realizado todas acciones
-         * relacionadas con stos debemos comprobar si nos ha sobrado tiempo,
-         * y en tal caso, esperar si as esta indicado en SPF (SPF > 0)
+         * Con una pantalla de doble buffer no se puede actualizar solo una
+         * parte, por lo que en ese caso siempre se dibuja el frame completo
          */
-        if(creSPF != 0) {
-            /* Calculamos el tiempo de espera */
-            WaitTime = creSPF - (SDL_GetTicks() - CurrentTime);
-            /* Si nos sobra tiempo, esperamos */
-            if(WaitTime > 0)
-                SDL_Delay(WaitTime);
+        Dirty = !creHeadless && CRE_GetRenderMode() == CRE_RENDER_DIRTY &&
+            !(creScreen->flags & SDL_DOUBLEBUF);
+
+        for(Step = 0; Step < Steps; Step++) {
+            ProfTime = CRE_ProfilerBegin();
+
+            /*
+             * Recogemos los eventos que han sucedido hasta el momento. Los
+             * pasos siguientes del mismo frame no reciben eventos de SDL para
+             * que no se procesen dos veces; una fuente de eventos se consulta
+             * en todos, ya que entrega los de cada paso. Si se est grabando,
+             * se graban.
+             */
+            if(Step == 0 || creEventFunc != NULL)
+                CRE_UpdateEList();
+            else
+                creEList.Size = 0;
+            CRE_RecordStep();
+            ProfTime = CRE_ProfilerMark(CRE_PROF_EVENTS, ProfTime);
+
+            /* La fuente de eventos puede haber acabado el bucle */
+            if(!creAnyLoop || creProcessCount == 0)
+                break;
+
+            /* Eliminamos los huecos que han dejado los procesos eliminados */
+            CRE_CompactLayers();
+            CRE_ProfilerMark(CRE_PROF_REAP, ProfTime);
+
+            /* Avanzamos el reloj virtual */
+            CRE_TickClock();
+
+            /*
+             * Ejecutamos los procesos, eliminando los muertos. Solo el ltimo
+             * paso dibuja, y solo si el frame se dibuja completo; en el modo
+             * de rectngulos sucios se dibuja despus.
+             */
+            CRE_RunProcesses(!creHeadless && !Dirty && Step == Steps - 1);
+
+            /* Comprobamos si algn proceso ha indicado que el bucle acabe */
+            if(!creAnyLoop || creProcessCount == 0)
+                break;
         }
 
-        /* Obtenemos la velocidad de proceso real para informar */
-        creRealFPS = 1.0f/((SDL_GetTicks() - CurrentTime) / 1000.0f);
+        /* Actualizamos la pantalla, si la hay */
+        if(!Dirty && !creHeadless) {
+            /*
+             * Dibujamos el almacn de dibujado, salvo si el bucle ha acabado,
+             * ya que los grficos pueden haberse liberado
+             */
+            if(creAnyLoop && creProcessCount != 0)
+                CRE_RenderStore(creScreen);
+            else
+                CRE_ClearRenderStore();
+            ProfTime = CRE_ProfilerBegin();
+            SDL_Flip(creScreen);
+            CRE_ProfilerMark(CRE_PROF_FLIP, ProfTime);
+        /* O solo las zonas que han cambiado */
+        } else if(Dirty && creAnyLoop && creProcessCount != 0)
+            CRE_RenderDirty(CRE_FirstProcess(), creScreen, creClearColor);
+
+        /* Cerramos las medidas del frame antes de la espera */
+        CRE_ProfilerMark(CRE_PROF_FRAME, ProfFrame);
+        CRE_ProfilerEndFrame();
+
+        /*
+         * Obtenemos la velocidad de proceso real para informar. Se promedia
+         * la duracin de los frames, y no los FPS, para que un frame aislado
+         * muy corto (al recuperar pasos) no la haga oscilar.
+         */
+        Frame = CRE_GetTime();
+        if(LastFrame != 0) {
+            if(FrameTime == 0)
+                FrameTime = (float) (Frame - LastFrame);
+            else
+                FrameTime += ((float) (Frame - LastFrame) - FrameTime) / 8;
+            if(FrameTime > 0)
+                creRealFPS = 1e9f / FrameTime;
+        }
+        LastFrame = Frame;
     }
 
     return 0;
@@ -369,11 +854,18 @@ Sint32 CRE_MainLoop(void)
 Sint32 CRE_StartLoop(void)
 {
     /* Si ya hay un bucle ejecutandose */
-    if(creAnyLoop != 0 || creScreen == NULL || creFirstProcess == NULL)
+    if(creAnyLoop != 0 || (creScreen == NULL && !creHeadless) ||
+      creProcessCount == 0)
         return -1;
     /* Si todo es correcto ejecutamos el bucle */
     creAnyLoop = 1;
     CRE_MainLoop();
+    /*
+     * Si el bucle ha acabado por quedarse sin procesos nadie lo ha cerrado, y
+     * el mundo no podra volver a ejecutarse ni liberarse
+     */
+    if(creAnyLoop)
+        CRE_EndLoop();
     return 0;
 }
 
@@ -385,8 +877,8 @@ Sint32 CRE_StartLoop(void)
  */
 Sint32 CRE_EndLoop(void)
 {
-    creProcess * Current = creFirstProcess;
-    creProcess * Tmp;
+    creProcess * Current;
+    Uint32 z, i;
 
     /* Comprobamos que exite algn bucle en ejecucin */
     if(!creAnyLoop)
@@ -394,21 +886,33 @@ Sint32 CRE_EndLoop(void)
 
 
     /* Eliminamos todas las instancias */
-    while(Current != NULL) {
-        /* Guardamos la dirccin del siguiente */
-        Tmp = Current->Next;
-        /* Eliminamos la instancia actual */
-        if(Current->Free != NULL)
-            Current->Free(Current);
-        /* Continuamos la lista */
-        Current = Tmp;
-    }
+    for(z = 0; z < LAYERS; z++)
+        for(i = 0; i < creLayers[z].Count; i++) {
+            Current = creLayers[z].Items[i];
+            if(Current == NULL)
+                continue;
+            /* Eliminamos la instancia actual */
+            CRE_FreeHandle(Current);
+            if(Current->Free != NULL)
+                Current->Free(Current);
+        }
 
     /* Reinicializamos la lista */
     creAnyLoop = 0;
-    creFirstProcess = NULL;
+    CRE_ClearLayers();
     creEList.Size = 0;
 
+    /*
+     * Vaciamos la cach de lienzos, ya que los grficos de las instancias
+     * eliminadas pueden haber sido liberados. Sin pantalla no se ha dibujado
+     * nada, y el estado del dibujado lo pueden estar usando otros mundos.
+     */
+    if(!creHeadless) {
+        CRE_FlushCanvasCache(NULL);
+        /* El siguiente bucle debe dibujar la pantalla completa */
+        CRE_RefreshScreen();
+    }
+
     return 0;
 }
 
@@ -420,9 +924,9 @@ Sint32 CRE_EndLoop(void)
 void CRE_SetFPS(Uint32 FPS)
 {
     if(FPS == 0)
-        creSPF = 0;
+        creStep = 0;
     else
-        creSPF = 1000/FPS;
+        creStep = 1000000000 / FPS;
 }
 
 
@@ -436,6 +940,389 @@ float CRE_GetFPS(void)
 }
 
 
+/*
+ * CRE_SetTimestep
+ * Selecciona el modo de control de la velocidad del bucle.
+ */
+void CRE_SetTimestep(Uint8 Mode)
+{
+    creTimestep = Mode;
+}
+
+
+/*
+ * CRE_GetTimestep
+ * Devuelve el modo de control de la velocidad del bucle.
+ */
+Uint8 CRE_GetTimestep(void)
+{
+    return creTimestep;
+}
+
+
+/*
+ * CRE_GetTime
+ * Reloj montono en nanosegundos. SDL_GetTicks solo llega a milisegundos, lo
+ * que redondea la duracin de los frames.
+ */
+Uint64 CRE_GetTime(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER Freq;
+    LARGE_INTEGER Now;
+
+    if(Freq.QuadPart == 0)
+        QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Now);
+    /* Se separa en segundos y resto para no desbordar */
+    return (Uint64) (Now.QuadPart / Freq.QuadPart) * 1000000000 +
+        (Uint64) (Now.QuadPart % Freq.QuadPart) * 1000000000 / Freq.QuadPart;
+#else
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (Uint64) Now.tv_sec * 1000000000 + Now.tv_nsec;
+#endif
+}
+
+
+/*
+ * CRE_WaitUntil
+ * Duerme mientras quede tiempo de sobra y espera activamente el final, ya que
+ * SDL_Delay puede despertar un milisegundo o ms tarde de lo pedido.
+ */
+void CRE_WaitUntil(Uint64 Time)
+{
+    Uint64 Now = CRE_GetTime();
+
+    while(Now + CRE_SPIN_TIME < Time) {
+        SDL_Delay((Uint32) ((Time - Now - CRE_SPIN_TIME) / 1000000));
+        Now = CRE_GetTime();
+    }
+    while(Now < Time)
+        Now = CRE_GetTime();
+}
+
+
+/*
+ * CRE_SetHeadless
+ * Activa o desactiva el modo sin pantalla.
+ */
+void CRE_SetHeadless(Uint8 Enable)
+{
+    creHeadless = Enable ? 1 : 0;
+}
+
+
+/*
+ * CRE_IsHeadless
+ * Indica si est activo el modo sin pantalla.
+ */
+Uint8 CRE_IsHeadless(void)
+{
+    return creHeadless;
+}
+
+
+/*
+ * CRE_SetEventSource
+ * Cambia el origen de los eventos del bucle de procesos.
+ */
+void CRE_SetEventSource(creEventSource Source, void * Arg)
+{
+    creEventFunc = Source;
+    creEventArg = Arg;
+}
+
+
+/*
+ * CRE_GetTicks
+ * Devuelve el reloj virtual en milisegundos.
+ */
+Uint32 CRE_GetTicks(void)
+{
+    return (Uint32) (creClock / 1000000);
+}
+
+
+/*
+ * CRE_SetTicks
+ * Cambia el reloj virtual.
+ */
+void CRE_SetTicks(Uint32 Ticks)
+{
+    creClock = (Uint64) Ticks * 1000000;
+}
+
+
+/*
+ * CRE_GetStepTime
+ * Devuelve la duracin de un paso del bucle en nanosegundos.
+ */
+Uint64 CRE_GetStepTime(void)
+{
+    return creStep;
+}
+
+
+/*
+ * CRE_SetFastForward
+ * Activa o desactiva el avance rpido.
+ */
+void CRE_SetFastForward(Uint8 Enable)
+{
+    creFastForward = Enable ? 1 : 0;
+}
+
+
+/*
+ * CRE_NewWorld
+ * Crea un mundo vaco con los mismos valores iniciales que el mundo por
+ * defecto.
+ */
+creWorld * CRE_NewWorld(void)
+{
+    creWorld * World;
+
+    World = (creWorld *) calloc(1, sizeof(creWorld));
+    if(World == NULL)
+        return NULL;
+    World->FreeFirst = World->FreeLast = HANDLE_NONE;
+    World->Timestep = CRE_TIMESTEP_VARIABLE;
+    World->Replay.Random = CRE_RANDOM_SEED;
+
+    return World;
+}
+
+
+/*
+ * CRE_FreeWorld
+ * Libera los procesos que queden en un mundo y toda su memoria. Mientras se
+ * libera, el mundo pasa a ser el actual, ya que los mtodos Free de los
+ * procesos devuelven sus bloques al almacn del mundo actual.
+ */
+void CRE_FreeWorld(creWorld * World)
+{
+    creWorld * Current = creWorldNow;
+    creTypeIndex * Index, * Next;
+    creProcess * Process;
+    Uint32 z, i;
+
+    /* Comprobamos los parametros */
+    if(World == NULL || World == &creDefaultWorld || World->AnyLoop)
+        return;
+
+    creWorldNow = World;
+
+    /* Eliminamos las instancias que no haya eliminado un bucle */
+    for(z = 0; z < LAYERS; z++)
+        for(i = 0; i < creLayers[z].Count; i++) {
+            Process = creLayers[z].Items[i];
+            if(Process == NULL)
+                continue;
+            CRE_FreeHandle(Process);
+            if(Process->Free != NULL)
+                Process->Free(Process);
+        }
+    CRE_StopRecord();
+    CRE_StopReplay();
+
+    /* Los datos del juego, que los procesos podan usar al liberarse */
+    if(World->DataFree != NULL)
+        World->DataFree(World->Data);
+
+    /* Y la memoria de las capas, los tipos, los almacenes y los Ids */
+    for(z = 0; z < LAYERS; z++)
+        free(creLayers[z].Items);
+    for(z = 0; z < TYPE_HASH_SIZE; z++)
+        for(Index = creTypes[z]; Index != NULL; Index = Next) {
+            Next = Index->Next;
+            free(Index);
+        }
+    for(z = 0; z <= POOL_CLASSES; z++) {
+        for(i = 0; i < crePools[z].SlabCount; i++)
+            free(crePools[z].Slabs[i]);
+        free(crePools[z].Slabs);
+    }
+    free(creHandles);
+
+    creWorldNow = Current;
+    free(World);
+}
+
+
+/*
+ * CRE_SetWorld
+ * Cambia el mundo actual del hilo.
+ */
+void CRE_SetWorld(creWorld * World)
+{
+    creWorldNow = World != NULL ? World : &creDefaultWorld;
+}
+
+
+/*
+ * CRE_GetWorld
+ * Devuelve el mundo actual del hilo.
+ */
+creWorld * CRE_GetWorld(void)
+{
+    return creWorldNow;
+}
+
+
+/*
+ * CRE_SetWorldData
+ * Asocia datos propios del juego al mundo actual.
+ */
+void CRE_SetWorldData(void * Data, creDataFree Free)
+{
+    creWorldNow->Data = Data;
+    creWorldNow->DataFree = Free;
+}
+
+
+/*
+ * CRE_GetWorldData
+ * Devuelve los datos propios del juego del mundo actual.
+ */
+void * CRE_GetWorldData(void)
+{
+    return creWorldNow->Data;
+}
+
+
+/*
+ * CRE_IsDefaultWorld
+ * Indica si el mundo actual del hilo es el mundo por defecto.
+ */
+Uint8 CRE_IsDefaultWorld(void)
+{
+    return creWorldNow == &creDefaultWorld;
+}
+
+
+/*
+ * CRE_WorldThread
+ * Hilo de CRE_RunWorlds. Ejecuta mundos hasta que no quede ninguno.
+ */
+int CRE_WorldThread(void * Data)
+{
+    creWorldRun * Run = (creWorldRun *) Data;
+    creWorld * World;
+    Uint32 i;
+
+    for(;;) {
+        SDL_mutexP(Run->Lock);
+        i = Run->Next++;
+        SDL_mutexV(Run->Lock);
+        if(i >= Run->Count)
+            break;
+
+        World = Run->Worlds[i];
+        if(World == NULL || !World->Headless)
+            continue;
+        creWorldNow = World;
+        if(Run->Entry != NULL)
+            Run->Entry(i, Run->Arg);
+        else if(CRE_StartLoop() != 0)
+            continue;
+        SDL_mutexP(Run->Lock);
+        Run->Ran++;
+        SDL_mutexV(Run->Lock);
+    }
+
+    return 0;
+}
+
+
+/*
+ * CRE_RunWorlds
+ * Reparte los mundos entre los hilos, que toman el siguiente al acabar uno.
+ */
+Sint32 CRE_RunWorlds(creWorld ** Worlds, Uint32 Count, Uint32 Threads,
+    creWorldEntry Entry, void * Arg)
+{
+    creWorld * Current = creWorldNow;
+    SDL_Thread ** Pool;
+    creWorldRun Run;
+    Uint32 i, n;
+
+    /* Comprobamos los parametros */
+    if(Worlds == NULL)
+        return -1;
+
+    /* Los kernels se eligen la primera vez que se usan; mejor antes de los
+       hilos */
+    CRE_GfxInitSIMD();
+
+    Run.Worlds = Worlds;
+    Run.Count = Count;
+    Run.Next = Run.Ran = 0;
+    Run.Entry = Entry;
+    Run.Arg = Arg;
+    if((Run.Lock = SDL_CreateMutex()) == NULL)
+        return -1;
+
+    if(Threads > Count)
+        Threads = Count;
+    if(Threads <= 1) {
+        CRE_WorldThread(&Run);
+        creWorldNow = Current;
+    } else {
+        Pool = (SDL_Thread **) malloc(Threads * sizeof(SDL_Thread *));
+        if(Pool == NULL) {
+            SDL_DestroyMutex(Run.Lock);
+            return -1;
+        }
+        /* Con los hilos que se hayan podido crear basta para todos */
+        for(n = 0; n < Threads; n++)
+            if((Pool[n] = SDL_CreateThread(CRE_WorldThread, &Run)) == NULL)
+                break;
+        for(i = 0; i < n; i++)
+            SDL_WaitThread(Pool[i], NULL);
+        free(Pool);
+        if(n == 0) {
+            SDL_DestroyMutex(Run.Lock);
+            return -1;
+        }
+    }
+
+    SDL_DestroyMutex(Run.Lock);
+    return (Sint32) Run.Ran;
+}
+
+
+/*
+ * CRE_WorldScreen
+ * Devuelve la pantalla del mundo actual.
+ */
+SDL_Surface ** CRE_WorldScreen(void)
+{
+    return &creWorldNow->Screen;
+}
+
+
+/*
+ * CRE_WorldEvents
+ * Devuelve la lista de eventos del mundo actual.
+ */
+creEventsList * CRE_WorldEvents(void)
+{
+    return &creWorldNow->EList;
+}
+
+
+/*
+ * CRE_WorldReplay
+ * Devuelve el estado del generador y de la grabacin del mundo actual.
+ */
+creReplayState * CRE_WorldReplay(void)
+{
+    return &creWorldNow->Replay;
+}
+
+
 /*
  * CRE_GetProcess
  * Dada un Id de proceso vlido y si el proceso est activo devuelve un puntero
@@ -443,24 +1330,30 @@ float CRE_GetFPS(void)
  */
 creProcess * CRE_GetProcess(Uint32 Id)
 {
-    creProcess * This;
+    creHandle * Handle;
 
     /* En caso de que el Id no sea vlido */
-    if(!Id ) return NULL;
+    if(!Id || (Id & HANDLE_MASK) >= creHandlesUsed) return NULL;
 
-    /* Inicializamos las variables para la bsqueda */
-    This = creFirstProcess;
-
-    /* Recorremos la lista de procesos */
-    while(This != NULL) {
-        /* Si el proceso es el buscado paramos de buscar */
-        if(This->Id == Id) break;
-        /* Avazamos al siguiente elemento de la lista */
-        This = This->Next;
-    }
+    /* La entrada debe estar ocupada y ser de la misma generacin */
+    Handle = creHandles + (Id & HANDLE_MASK);
+    if(Handle->Gen != Id >> HANDLE_BITS)
+        return NULL;
 
     /* Devolvemos el objeto buscado, o un puntero a NULL implcito */
-    return This;
+    return Handle->Process;
+}
+
+
+/*
+ * CRE_IsAlive
+ * Indica si el Id corresponde a un proceso que no esta muerto.
+ */
+Uint8 CRE_IsAlive(Uint32 Id)
+{
+    creProcess * This = CRE_GetProcess(Id);
+
+    return This != NULL && !(This->State & CRE_PS_DEAD);
 }
 
 
@@ -481,33 +1374,30 @@ Sint32 CRE_SetState(Uint32 Id, Uint8 State)
 }
 
 
+/*
+ * CRE_AddState
+ * Aade a un proceso el estado al que apunta Arg.
+ */
+void CRE_AddState(creProcess * Process, void * Arg)
+{
+    Process->State |= *((Uint8 *) Arg);
+}
+
+
 /*
  * CRE_TSetState
  * Establece un estado determinado a todos los procesos del mismo tipo.
  */
 Sint32 CRE_TSetState(Uint16 Type, Uint8 State)
 {
-    Sint32 Tmp = -1;
-    creProcess * This = creFirstProcess;
-
     /* Caso optimizado */
     if(Type == 0 && State == CRE_PS_DEAD) {
         CRE_EndLoop();
         return 0;
     }
 
-    /* Recorremos todos los procesos */
-    while(This != NULL) {
-        /* Si el tipo es el adecuado modificamos su estado */
-        if(Type == 0 || This->Type == Type) {
-            This->State |= State;
-            Tmp = 0;
-        }
-        /* Continuamos al siguiente */
-        This = This->Next;
-    }
-
-    return Tmp;
+    /* Recorremos los procesos del tipo */
+    return CRE_ForEachOfType(Type, CRE_AddState, &State) ? 0 : -1;
 }
 
 
@@ -517,7 +1407,7 @@ Sint32 CRE_TSetState(Uint16 Type, Uint8 State)
  */
 Sint32 CRE_LetPrcsAlone(Uint32 Id)
 {
-    creProcess * This = creFirstProcess;
+    creProcess * This = CRE_FirstProcess();
 
     /* Caso optimizado */
     if(Id == 0) {
@@ -531,7 +1421,7 @@ Sint32 CRE_LetPrcsAlone(Uint32 Id)
         if(This->Id != Id)
             This->State = CRE_PS_DEAD;
         /* Avanzamos en la lista */
-        This = This->Next;
+        This = CRE_NextProcess(This);
     }
 
     return 0;
@@ -541,12 +1431,10 @@ Sint32 CRE_LetPrcsAlone(Uint32 Id)
 /*
  * CRE_AddProcess
  * Aade una instancia de un proceso a la lista de procesos en ejecucin.
- * Los procesos se ordenan en funcin del valor de Z.
+ * Los procesos se guardan en la capa que corresponde a su Z.
  */
 Sint32 CRE_AddProcess(creProcess * Process)
 {
-    creProcess * This, * Last;
-
     /* Comprobamos que el proceso no es una clase */
     if((Process->State & CRE_PS_CLASS) >> 2)
         return -1;
@@ -555,38 +1443,26 @@ Sint32 CRE_AddProcess(creProcess * Process)
         return -1;
 
     /* Damos un ID vlido al proces */
-    Process->Id = CRE_GetNewPId();
+    Process->Id = CRE_NewHandle(Process);
+    if(Process->Id == 0)
+        return -1;
 
-    /* En caso de que este sea el primer porceso de la lista */
-    if(creFirstProcess == NULL) {
-        Process->Next = NULL;
-        creFirstProcess = Process;
-        return 0;
+    /* Lo aadimos a la lista de su tipo */
+    if(CRE_TypeLink(Process) != 0) {
+        CRE_FreeHandle(Process);
+        return -1;
     }
 
-    /* Preparamos variables para la bsqueda */
-    Last = NULL;
-    This = creFirstProcess;
-
-    /* Recorremos la lista de procesos en busca de la posicin correcta */
-    while(This != NULL) {
-        /* Observamos el valor de z, para introducir el proceso */
-        if(This->Z >= Process->Z)
-            break;
-        /* Incrementamos la posicin de la lista */
-        Last = This;
-        This = This->Next;
+    /* Y al final de la capa de su Z */
+    if(CRE_LayerAppend(Process, Process->Z) != 0) {
+        CRE_TypeUnlink(Process);
+        CRE_FreeHandle(Process);
+        return -1;
     }
+    creProcessCount++;
 
-    /* En caso de que el proceso deba estar el primero de la lista */
-    if(Last == NULL) {
-        Process->Next = This;
-        creFirstProcess = Process;
-    /* Si esta en cualquier otra posicin, actuamos de diferente forma */
-    } else {
-        Last->Next = Process;
-        Process->Next = This;
-    }
+    /* An no se ha ejecutado */
+    Process->Pass = 0;
 
     return 0;
 }
@@ -598,7 +1474,9 @@ Sint32 CRE_AddProcess(creProcess * Process)
  */
 void CRE_SetClearColor(Uint8 R, Uint8 G, Uint8 B)
 {
-    creClearColor = SDL_MapRGB(creScreen->format, R, G, B);
+    /* Sin pantalla no hay formato con el que calcular el color */
+    if(creScreen != NULL)
+        creClearColor = SDL_MapRGB(creScreen->format, R, G, B);
 }
 
 
@@ -608,18 +1486,213 @@ void CRE_SetClearColor(Uint8 R, Uint8 G, Uint8 B)
  */
 Uint32 CRE_CountProcesses(void)
 {
+    return creProcessCount;
+}
+
+
+/*
+ * CRE_FirstProcess
+ * Devuelve el primer proceso de la primera capa no vaca.
+ */
+creProcess * CRE_FirstProcess(void)
+{
+    return CRE_NextProcess(NULL);
+}
+
+
+/*
+ * CRE_NextProcess
+ * Busca hacia atrs en la capa del proceso y, al acabarla, en las capas
+ * siguientes, saltando los huecos.
+ */
+creProcess * CRE_NextProcess(creProcess * Process)
+{
+    Uint32 z, i;
+
+    if(Process == NULL) {
+        z = 0;
+        i = creLayers[0].Count;
+    } else {
+        z = Process->Layer;
+        i = Process->Slot;
+    }
+
+    for(;;) {
+        while(i-- > 0)
+            if(creLayers[z].Items[i] != NULL)
+                return creLayers[z].Items[i];
+        if(++z == LAYERS)
+            return NULL;
+        i = creLayers[z].Count;
+    }
+}
+
+
+/*
+ * CRE_ForEachOfType
+ * Recorre la lista del tipo indicado, o todos los procesos si es 0. Se guarda
+ * el siguiente antes de llamar a la funcin, ya que los procesos nuevos se
+ * aaden al principio de la lista.
+ */
+Uint32 CRE_ForEachOfType(Uint16 Type, creProcessFunc Func, void * Arg)
+{
+    creTypeIndex * Index;
+    creProcess * This, * Next;
     Uint32 Count = 0;
-    creProcess * This = creFirstProcess;
 
-    while(This != 0) {
+    if(Type == 0) {
+        for(This = CRE_FirstProcess(); This != NULL; This = Next) {
+            Next = CRE_NextProcess(This);
+            Func(This, Arg);
+            Count++;
+        }
+        return Count;
+    }
+
+    if((Index = CRE_GetTypeIndex(Type, 0)) == NULL)
+        return 0;
+
+    for(This = Index->First; This != NULL; This = Next) {
+        Next = This->TypeNext;
+        Func(This, Arg);
         Count++;
-        This = This->Next;
     }
 
     return Count;
 }
 
 
+/*
+ * CRE_CountType
+ * Devuelve el nmero de procesos de un tipo, o el total si es 0.
+ */
+Uint32 CRE_CountType(Uint16 Type)
+{
+    creTypeIndex * Index;
+
+    if(Type == 0)
+        return creProcessCount;
+
+    Index = CRE_GetTypeIndex(Type, 0);
+
+    return Index != NULL ? Index->Count : 0;
+}
+
+
+/*
+ * CRE_PoolGrow
+ * Aade una tira de bloques de Class unidades de POOL_ALIGN al almacn.
+ */
+Sint32 CRE_PoolGrow(crePool * Pool, Uint32 Class)
+{
+    Uint8 ** Slabs;
+    Uint8 * Slab;
+    Uint32 Size;
+
+    if(Pool->SlabCount == Pool->SlabSize) {
+        Size = Pool->SlabSize ? Pool->SlabSize * 2 : 4;
+        Slabs = (Uint8 **) realloc(Pool->Slabs, Size * sizeof(Uint8 *));
+        if(Slabs == NULL)
+            return -1;
+        Pool->Slabs = Slabs;
+        Pool->SlabSize = Size;
+    }
+
+    Slab = (Uint8 *) malloc(Class * POOL_ALIGN * POOL_SLAB_CHUNKS);
+    if(Slab == NULL)
+        return -1;
+    Pool->Slabs[Pool->SlabCount++] = Slab;
+
+    return 0;
+}
+
+
+/*
+ * CRE_AllocProcess
+ * Reserva un proceso y sus datos en un mismo bloque del almacn de su tamao.
+ */
+creProcess * CRE_AllocProcess(creProcess * Class, Uint32 DataSize)
+{
+    creProcess * Process;
+    crePool * Pool;
+    Uint32 c, Next;
+
+    /* Los bloques que no caben en ningn almacn se reservan aparte */
+    if(DataSize > POOL_CLASSES * POOL_ALIGN || POOL_CLASS(DataSize) >
+      POOL_CLASSES) {
+        Process = (creProcess *) malloc(POOL_HEADER + DataSize);
+        if(Process == NULL)
+            return NULL;
+        memset(Process, 0, POOL_HEADER + DataSize);
+        c = 0;
+    } else {
+        c = POOL_CLASS(DataSize);
+        Pool = &crePools[c];
+
+        /* Reutilizamos el ltimo bloque liberado */
+        if(Pool->FreeList != NULL) {
+            Process = (creProcess *) Pool->FreeList;
+            Pool->FreeList = *((void **) Process);
+        /* O el siguiente sin usar, pasando a otra tira si la actual acab */
+        } else {
+            if(Pool->SlabCount == 0 || Pool->Used == POOL_SLAB_CHUNKS) {
+                Next = Pool->SlabCount ? Pool->Slab + 1 : 0;
+                if(Next == Pool->SlabCount && CRE_PoolGrow(Pool, c) != 0)
+                    return NULL;
+                Pool->Slab = Next;
+                Pool->Used = 0;
+            }
+            Process = (creProcess *) (Pool->Slabs[Pool->Slab] +
+                Pool->Used++ * c * POOL_ALIGN);
+        }
+        Pool->Live++;
+        memset(Process, 0, c * POOL_ALIGN);
+    }
+
+    /* Copiamos la clase y enlazamos los datos, que van tras la cabecera */
+    if(Class != NULL)
+        *Process = *Class;
+    Process->Data = DataSize ? (Uint8 *) Process + POOL_HEADER : NULL;
+    Process->Pool = c;
+
+    return Process;
+}
+
+
+/*
+ * CRE_FreeProcess
+ * Devuelve el bloque de un proceso a su almacn.
+ */
+void CRE_FreeProcess(creProcess * Process)
+{
+    crePool * Pool;
+
+    if(Process == NULL)
+        return;
+
+    if(Process->Pool == 0) {
+        free(Process);
+        return;
+    }
+
+    Pool = &crePools[Process->Pool];
+    *((void **) Process) = Pool->FreeList;
+    Pool->FreeList = Process;
+
+    /*
+     * Cuando se liberan todos los bloques de un tamao (al acabar un bucle, o
+     * con CRE_LetPrcsAlone si el proceso que queda es de otro tamao) el
+     * almacn se rebobina entero: los procesos siguientes vuelven a
+     * reservarse seguidos desde la primera tira.
+     */
+    if(--Pool->Live == 0) {
+        Pool->FreeList = NULL;
+        Pool->Slab = 0;
+        Pool->Used = 0;
+    }
+}
+
+
 /*
  * CRE_GetProcessesInfo
  * Devuelve en el fichero indicado informacin sobre el estado actual de los
@@ -639,10 +1712,10 @@ void CRE_GetProcessesInfo(FILE * out)
         CRE_CountProcesses(), (SDL_GetTicks()/1000.0), CRE_GetFPS());
 
     /* Inicializamos valores */
-    This = creFirstProcess;
+    This = CRE_FirstProcess();
 
     /* En el caso de que no haya procesos en lista */
-    if(creFirstProcess == NULL) {
+    if(creProcessCount == 0) {
         fprintf(out, "+ NO PROCESSES RUNNING NOW +\n\n\n");
         return;
     }
@@ -673,6 +1746,6 @@ void CRE_GetProcessesInfo(FILE * out)
                 This->Angle / 1000.0);
 
         /* Avanzamos en la lista */
-        This = This->Next;
+        This = CRE_NextProcess(This);
     }
 }
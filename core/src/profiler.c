@@ -0,0 +1,417 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file profiler.c
+ * Implementacin de las medidas de tiempo del bucle de procesos. Ms
+ * informacin en el archivo de cabecera.
+ **/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include "process.h"
+#include "profiler.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Las medidas son del bucle del mundo por defecto. Se comprueba el mundo
+   antes que creProfOn para que los dems hilos no lean el estado. */
+#define CRE_PROF_ACTIVE() (CRE_IsDefaultWorld() && creProfOn)
+
+
+/*
+ * Definicin de tipos
+ */
+
+/*
+ * Coste por frame de un tipo de proceso: el del frame actual y el de los
+ * frames guardados, tanto de los mtodos loop como del dibujado.
+ */
+typedef struct creProfType {
+    Uint16 Type;
+    Uint32 Current[2];
+    Uint32 Frames[2][CRE_PROFILER_WINDOW];
+} creProfType;
+
+/*
+ * Resumen estadstico de una serie de medidas.
+ */
+typedef struct creProfStats {
+    Uint32 Min, P95, P99;
+    double Mean;
+} creProfStats;
+
+
+/*
+ * Variables globales al fichero
+ */
+
+/* Indica si las medidas estn activadas */
+Uint8 creProfOn = 0;
+/* Tiempo de cada fase en el frame actual y en los frames guardados */
+Uint32 creProfCurrent[CRE_PROF_PHASES];
+Uint32 creProfFrames[CRE_PROF_PHASES][CRE_PROFILER_WINDOW];
+/* Posicin del siguiente frame y nmero de frames guardados */
+Uint32 creProfPos = 0, creProfCount = 0;
+/* Tipos de proceso medidos y ltimo tipo utilizado */
+creProfType creProfTypes[CRE_PROFILER_TYPES];
+Uint32 creProfNTypes = 0, creProfLastType = 0;
+/* Nombre de cada fase */
+const char * creProfNames[CRE_PROF_PHASES] = {
+    "events", "reap", "loop", "transform", "blit", "flip", "frame"
+};
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * CRE_EnableProfiler
+ * Activa o desactiva las medidas, descartando las anteriores al activarlas.
+ */
+void CRE_EnableProfiler(Uint8 Enable)
+{
+    if(Enable && !creProfOn) {
+        memset(creProfCurrent, 0, sizeof(creProfCurrent));
+        creProfPos = creProfCount = 0;
+        creProfNTypes = creProfLastType = 0;
+    }
+    creProfOn = Enable ? 1 : 0;
+}
+
+
+/*
+ * CRE_IsProfilerEnabled
+ * Indica si las medidas estn activadas.
+ */
+Uint8 CRE_IsProfilerEnabled(void)
+{
+    return creProfOn;
+}
+
+
+/*
+ * CRE_ProfilerTime
+ * Reloj del bucle de procesos en microsegundos.
+ */
+Uint32 CRE_ProfilerTime(void)
+{
+    return (Uint32) (CRE_GetTime() / 1000);
+}
+
+
+/*
+ * CRE_ProfilerBegin
+ * Devuelve el tiempo actual si las medidas estn activadas.
+ */
+Uint32 CRE_ProfilerBegin(void)
+{
+    return CRE_PROF_ACTIVE() ? CRE_ProfilerTime() : 0;
+}
+
+
+/*
+ * CRE_ProfilerMark
+ * Suma a una fase el tiempo transcurrido desde Begin. Un Begin nulo indica
+ * que la medida empez con las medidas desactivadas y se descarta.
+ */
+Uint32 CRE_ProfilerMark(Uint8 Phase, Uint32 Begin)
+{
+    Uint32 Now;
+
+    if(!CRE_PROF_ACTIVE() || Begin == 0)
+        return 0;
+
+    Now = CRE_ProfilerTime();
+    creProfCurrent[Phase] += Now - Begin;
+
+    return Now;
+}
+
+
+/*
+ * CRE_ProfilerMarkType
+ * Suma un intervalo al coste de un tipo de proceso. Los tipos que no caben
+ * en la tabla no se miden.
+ */
+void CRE_ProfilerMarkType(Uint16 Type, Uint8 Phase, Uint32 Begin, Uint32 End)
+{
+    creProfType * t;
+    Uint32 i;
+
+    if(!CRE_PROF_ACTIVE() || Begin == 0 || End == 0)
+        return;
+
+    /* Normalmente se repite el tipo anterior */
+    if(creProfLastType < creProfNTypes &&
+       creProfTypes[creProfLastType].Type == Type) {
+        i = creProfLastType;
+    } else {
+        for(i = 0; i < creProfNTypes; i++)
+            if(creProfTypes[i].Type == Type)
+                break;
+        /* Tipo nuevo: no tiene coste en los frames anteriores */
+        if(i == creProfNTypes) {
+            if(i == CRE_PROFILER_TYPES)
+                return;
+            memset(creProfTypes + i, 0, sizeof(creProfType));
+            creProfTypes[i].Type = Type;
+            creProfNTypes++;
+        }
+        creProfLastType = i;
+    }
+
+    t = creProfTypes + i;
+    t->Current[Phase == CRE_PROF_LOOP ? 0 : 1] += End - Begin;
+}
+
+
+/*
+ * CRE_ProfilerEndFrame
+ * Guarda las medidas del frame actual en la ventana de frames. Un frame sin
+ * tiempo total es uno en el que se activaron las medidas y se descarta.
+ */
+void CRE_ProfilerEndFrame(void)
+{
+    creProfType * t;
+    Uint32 i;
+
+    if(!CRE_PROF_ACTIVE())
+        return;
+
+    if(creProfCurrent[CRE_PROF_FRAME] != 0) {
+        for(i = 0; i < CRE_PROF_PHASES; i++)
+            creProfFrames[i][creProfPos] = creProfCurrent[i];
+        for(i = 0; i < creProfNTypes; i++) {
+            t = creProfTypes + i;
+            t->Frames[0][creProfPos] = t->Current[0];
+            t->Frames[1][creProfPos] = t->Current[1];
+        }
+        creProfPos = (creProfPos + 1) % CRE_PROFILER_WINDOW;
+        if(creProfCount < CRE_PROFILER_WINDOW)
+            creProfCount++;
+    }
+
+    memset(creProfCurrent, 0, sizeof(creProfCurrent));
+    for(i = 0; i < creProfNTypes; i++)
+        creProfTypes[i].Current[0] = creProfTypes[i].Current[1] = 0;
+}
+
+
+/*
+ * CRE_ProfilerCompare
+ * Funcin de comparacin para qsort.
+ */
+int CRE_ProfilerCompare(const void * A, const void * B)
+{
+    Uint32 a = *(const Uint32 *) A, b = *(const Uint32 *) B;
+
+    return (a > b) - (a < b);
+}
+
+
+/*
+ * CRE_ProfilerStats
+ * Calcula el mnimo, la media y los percentiles 95 y 99 (por rango) de los
+ * frames guardados de una serie.
+ */
+void CRE_ProfilerStats(Uint32 * Values, creProfStats * Stats)
+{
+    Uint32 Sorted[CRE_PROFILER_WINDOW];
+    Uint32 i, n = creProfCount;
+    double Sum = 0;
+
+    memset(Stats, 0, sizeof(creProfStats));
+    if(n == 0)
+        return;
+
+    /* Mientras la ventana no se llena los frames estn al principio */
+    memcpy(Sorted, Values, n * sizeof(Uint32));
+    qsort(Sorted, n, sizeof(Uint32), CRE_ProfilerCompare);
+    for(i = 0; i < n; i++)
+        Sum += Sorted[i];
+
+    Stats->Min = Sorted[0];
+    Stats->Mean = Sum / n;
+    Stats->P95 = Sorted[(n * 95 + 99) / 100 - 1];
+    Stats->P99 = Sorted[(n * 99 + 99) / 100 - 1];
+}
+
+
+/*
+ * CRE_ProfilerReport
+ * Escribe una tabla con el resumen de cada fase y de cada tipo de proceso.
+ */
+void CRE_ProfilerReport(FILE * out)
+{
+    creProfStats s;
+    Uint32 i, j;
+
+    fprintf(out, ".--------------------------------------------------.\n"
+                 "| CORE PROFILER (%4u frames, us)                   |\n"
+                 "|                    min     mean      p95      p99 |\n",
+        creProfCount);
+
+    for(i = 0; i < CRE_PROF_PHASES; i++) {
+        CRE_ProfilerStats(creProfFrames[i], &s);
+        fprintf(out, "| %-12s %9u %8.1f %8u %8u |\n", creProfNames[i],
+            s.Min, s.Mean, s.P95, s.P99);
+    }
+
+    for(i = 0; i < creProfNTypes; i++)
+        for(j = 0; j < 2; j++) {
+            CRE_ProfilerStats(creProfTypes[i].Frames[j], &s);
+            fprintf(out, "| %4s #%-6u %9u %8.1f %8u %8u |\n",
+                j == 0 ? "loop" : "blit", creProfTypes[i].Type,
+                s.Min, s.Mean, s.P95, s.P99);
+        }
+
+    fprintf(out, "--------------------------------------------------\n\n");
+}
+
+
+/*
+ * CRE_ProfilerFrame
+ * Devuelve la posicin en la ventana del frame i-simo, del ms antiguo al
+ * ms reciente.
+ */
+Uint32 CRE_ProfilerFrame(Uint32 i)
+{
+    return (creProfPos + CRE_PROFILER_WINDOW - creProfCount + i) %
+        CRE_PROFILER_WINDOW;
+}
+
+
+/*
+ * CRE_ProfilerDumpCSV
+ * Escribe el resumen y, tras una lnea vaca, el tiempo de cada fase en cada
+ * frame.
+ */
+void CRE_ProfilerDumpCSV(FILE * out)
+{
+    creProfStats s;
+    Uint32 i, j;
+
+    fprintf(out, "section,name,type,min_us,mean_us,p95_us,p99_us\n");
+    for(i = 0; i < CRE_PROF_PHASES; i++) {
+        CRE_ProfilerStats(creProfFrames[i], &s);
+        fprintf(out, "phase,%s,,%u,%.1f,%u,%u\n", creProfNames[i],
+            s.Min, s.Mean, s.P95, s.P99);
+    }
+    for(i = 0; i < creProfNTypes; i++)
+        for(j = 0; j < 2; j++) {
+            CRE_ProfilerStats(creProfTypes[i].Frames[j], &s);
+            fprintf(out, "type,%s,%u,%u,%.1f,%u,%u\n",
+                j == 0 ? "loop" : "blit", creProfTypes[i].Type,
+                s.Min, s.Mean, s.P95, s.P99);
+        }
+
+    fprintf(out, "\nframe");
+    for(i = 0; i < CRE_PROF_PHASES; i++)
+        fprintf(out, ",%s_us", creProfNames[i]);
+    fprintf(out, "\n");
+    for(j = 0; j < creProfCount; j++) {
+        fprintf(out, "%u", j);
+        for(i = 0; i < CRE_PROF_PHASES; i++)
+            fprintf(out, ",%u", creProfFrames[i][CRE_ProfilerFrame(j)]);
+        fprintf(out, "\n");
+    }
+}
+
+
+/*
+ * CRE_ProfilerJSONStats
+ * Escribe un resumen como objeto JSON.
+ */
+void CRE_ProfilerJSONStats(FILE * out, Uint32 * Values)
+{
+    creProfStats s;
+
+    CRE_ProfilerStats(Values, &s);
+    fprintf(out, "{\"min\": %u, \"mean\": %.1f, \"p95\": %u, \"p99\": %u}",
+        s.Min, s.Mean, s.P95, s.P99);
+}
+
+
+/*
+ * CRE_ProfilerDumpJSON
+ * Escribe el resumen de fases y tipos y el tiempo de cada fase en cada frame.
+ */
+void CRE_ProfilerDumpJSON(FILE * out)
+{
+    Uint32 i, j;
+
+    fprintf(out, "{\n  \"frames\": %u,\n  \"phases\": {", creProfCount);
+    for(i = 0; i < CRE_PROF_PHASES; i++) {
+        fprintf(out, "%s\n    \"%s\": ", i ? "," : "", creProfNames[i]);
+        CRE_ProfilerJSONStats(out, creProfFrames[i]);
+    }
+
+    fprintf(out, "\n  },\n  \"types\": [");
+    for(i = 0; i < creProfNTypes; i++) {
+        fprintf(out, "%s\n    {\"type\": %u, \"loop\": ", i ? "," : "",
+            creProfTypes[i].Type);
+        CRE_ProfilerJSONStats(out, creProfTypes[i].Frames[0]);
+        fprintf(out, ", \"blit\": ");
+        CRE_ProfilerJSONStats(out, creProfTypes[i].Frames[1]);
+        fprintf(out, "}");
+    }
+
+    fprintf(out, "\n  ],\n  \"samples\": {");
+    for(i = 0; i < CRE_PROF_PHASES; i++) {
+        fprintf(out, "%s\n    \"%s\": [", i ? "," : "", creProfNames[i]);
+        for(j = 0; j < creProfCount; j++)
+            fprintf(out, "%s%u", j ? ", " : "",
+                creProfFrames[i][CRE_ProfilerFrame(j)]);
+        fprintf(out, "]");
+    }
+    fprintf(out, "\n  }\n}\n");
+}
+
+
+/*
+ * CRE_ProfilerDump
+ * Vuelca las medidas en CSV o, si el nombre acaba en ".json", en JSON.
+ */
+Sint32 CRE_ProfilerDump(const char * FileName)
+{
+    FILE * out;
+    size_t Len;
+
+    if(FileName == NULL || (out = fopen(FileName, "w")) == NULL)
+        return -1;
+
+    Len = strlen(FileName);
+    if(Len >= 5 && strcmp(FileName + Len - 5, ".json") == 0)
+        CRE_ProfilerDumpJSON(out);
+    else
+        CRE_ProfilerDumpCSV(out);
+
+    fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,1096 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file render.c
+ * Implementacin de las funciones de apoyo al dibujado de procesos. Ms
+ * informacin en el archivo de cabecera.
+ **/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include "process.h"
+#include "gfx.h"
+#include "render.h"
+#include "profiler.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Nmero de listas de la tabla hash de la cach (potencia de 2) */
+#define CANVAS_HASH_SIZE 64
+
+/* Indica una posicin vaca en las listas de la cach */
+#define CANVAS_NONE -1
+
+/* Nmero mximo de rotaciones precalculadas de un grfico */
+#define ROTATIONS_MAX 3600
+
+/* Tamao inicial del almacn de dibujado */
+#define STORE_MIN_SIZE 256
+
+/* Nmero de listas de la tabla hash de grficos del almacn (potencia de 2) */
+#define STORE_HASH_SIZE 256
+
+/* Ampla un vector del almacn de dibujado a Size elementos */
+#define STORE_GROW(Field, Type) \
+    if((Block = realloc(creStore.Field, Size * sizeof(Type))) == NULL) \
+        return -1; \
+    creStore.Field = (Type *) Block;
+
+/* Indica si la entrada i del almacn de dibujado est rotada o escalada */
+#define STORE_TRANSFORMED(i) (creStore.Angle[i] != 0 || \
+    creStore.SizeW[i] != 100 || creStore.SizeH[i] != 100)
+
+/* Posicin en pantalla del centro de un proceso, segn la cmara */
+#define SCREEN_X(P) ((P)->X - (creFixedLayers[(P)->Z] ? 0 : creCameraX))
+#define SCREEN_Y(P) ((P)->Y - (creFixedLayers[(P)->Z] ? 0 : creCameraY))
+
+/* Estados de un proceso que afectan a su dibujado */
+#define DRAW_STATE (CRE_PS_GHOST | CRE_PS_FREEZE | CRE_PS_HIGHGFX)
+
+#ifndef MAX
+    #define MAX(A, B) (((A) > (B)) ? (A) : (B))
+#endif
+
+#ifndef MIN
+    #define MIN(A, B) (((A) < (B)) ? (A) : (B))
+#endif
+
+
+/*
+ * Definicin de tipos
+ */
+
+/*
+ * Entrada de la cach de lienzos. Las entradas se enlazan en una lista
+ * doblemente enlazada por orden de uso (LRU) y en las listas de la tabla hash.
+ */
+typedef struct creCanvasEntry {
+    /* Clave: grfico original y transformacin aplicada */
+    SDL_Surface * Graph;
+    Sint32 Angle;
+    Sint16 SizeW, SizeH;
+    Uint8 Smooth;
+    /* Lienzo transformado, NULL si la entrada esta libre */
+    SDL_Surface * Canvas;
+    /* Memoria que ocupan los pixels del lienzo */
+    Uint32 Bytes;
+    /* Enlaces de la lista LRU y de la tabla hash */
+    Sint32 Prev, Next, HNext;
+} creCanvasEntry;
+
+/*
+ * Conjunto de rotaciones precalculadas de un grfico.
+ */
+typedef struct creRotations {
+    /* Grfico original y escalado aplicado */
+    SDL_Surface * Graph;
+    Sint16 Zoom;
+    /* Nmero de rotaciones y vector con stas */
+    Uint32 Steps;
+    SDL_Surface ** Frames;
+    /* Siguiente conjunto de la lista */
+    struct creRotations * Next;
+} creRotations;
+
+/*
+ * Rectngulo sucio, definido por sus esquinas (la segunda no incluida) para
+ * poder unirlos sin los lmites de SDL_Rect.
+ */
+typedef struct creDirtyRect {
+    Sint32 X1, Y1, X2, Y2;
+} creDirtyRect;
+
+/*
+ * Almacn de dibujado por componentes. Guarda, en el orden en que deben
+ * dibujarse, una entrada por cada proceso visible del frame, con cada campo
+ * en su propio vector para que el dibujado los recorra seguidos.
+ */
+typedef struct creRenderStore {
+    /* Entradas guardadas y memoria reservada */
+    Uint32 Count, Size;
+    /* Centro y transformacin */
+    Sint32 * X, * Y, * Angle;
+    Sint16 * SizeW, * SizeH;
+    /* Capa, transparencia, modo de mezcla y calidad del escalado */
+    Uint8 * Z, * Alpha, * Blend, * Smooth;
+    /* ndice del grfico en Graphs */
+    Uint32 * Graph;
+    /* Tipo (para el profiler) y proceso (para la cach de lienzos) */
+    Uint16 * Type;
+    creProcess ** Process;
+    /* Entradas que quedan dentro de la pantalla, en el orden de dibujado */
+    Uint32 * Visible;
+    /* Rectngulos de destino del lote que se est dibujando */
+    SDL_Rect * Rects;
+    /* Vectores auxiliares de la ordenacin por grfico */
+    Uint32 * Order, * Counts;
+    /* Grficos distintos del frame y tabla hash para buscarlos (ndice + 1) */
+    SDL_Surface ** Graphs;
+    Uint32 * GraphNext;
+    Uint32 GraphCount;
+    Uint32 GraphHash[STORE_HASH_SIZE];
+} creRenderStore;
+
+
+/*
+ * Variables globales al fichero
+ */
+
+/* Entradas de la cach */
+creCanvasEntry creCanvas[CRE_CANVAS_CACHE_ENTRIES];
+/* Tabla hash de la cach */
+Sint32 creCanvasHash[CANVAS_HASH_SIZE];
+/* Extremos de la lista LRU (primero el ms reciente) */
+Sint32 creCanvasFirst = CANVAS_NONE, creCanvasLast = CANVAS_NONE;
+/* Memoria ocupada y memoria mxima de la cach */
+Uint32 creCanvasBytes = 0, creCanvasMaxBytes = CRE_CANVAS_CACHE_SIZE;
+/* Indica si la cach ha sido inicializada */
+Uint8 creCanvasInit = 0;
+/* Lista de grficos con rotaciones precalculadas */
+creRotations * creFirstRotations = NULL;
+/* Modo de dibujado del bucle de procesos */
+Uint8 creRenderMode = CRE_RENDER_FULL;
+/* Rectngulos sucios del frame actual */
+creDirtyRect creDirty[CRE_MAX_DIRTY_RECTS];
+Uint32 creDirtyCount = 0;
+/* Indica que el siguiente frame debe redibujarse completo */
+Uint8 creDirtyAll = 1;
+/* Almacn de dibujado del modo CRE_RENDER_STORE */
+creRenderStore creStore;
+/* Capas cuyos procesos pueden dibujarse en cualquier orden */
+Uint8 creBatchLayers[256];
+/* Posicin de la cmara y capas que no se mueven con ella */
+Sint32 creCameraX = 0, creCameraY = 0;
+Uint8 creFixedLayers[256];
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * CRE_CanvasInit
+ * Inicializa las listas de la cach la primera vez que se utiliza.
+ */
+void CRE_CanvasInit(void)
+{
+    int i;
+
+    for(i = 0; i < CANVAS_HASH_SIZE; i++)
+        creCanvasHash[i] = CANVAS_NONE;
+    for(i = 0; i < CRE_CANVAS_CACHE_ENTRIES; i++)
+        creCanvas[i].Canvas = NULL;
+
+    creCanvasInit = 1;
+}
+
+
+/*
+ * CRE_CanvasHashKey
+ * Calcula la posicin en la tabla hash de una clave.
+ */
+Uint32 CRE_CanvasHashKey(SDL_Surface * Graph, Sint32 Angle,
+    Sint16 SizeW, Sint16 SizeH)
+{
+    Uint32 h = (Uint32) ((size_t) Graph >> 4);
+
+    h = h * 31 + (Uint32) Angle;
+    h = h * 31 + (Uint32) SizeW;
+    h = h * 31 + (Uint32) SizeH;
+
+    return (h ^ (h >> 16)) & (CANVAS_HASH_SIZE - 1);
+}
+
+
+/*
+ * CRE_CanvasUnlink
+ * Saca una entrada de la lista LRU.
+ */
+void CRE_CanvasUnlink(Sint32 i)
+{
+    if(creCanvas[i].Prev != CANVAS_NONE)
+        creCanvas[creCanvas[i].Prev].Next = creCanvas[i].Next;
+    else
+        creCanvasFirst = creCanvas[i].Next;
+
+    if(creCanvas[i].Next != CANVAS_NONE)
+        creCanvas[creCanvas[i].Next].Prev = creCanvas[i].Prev;
+    else
+        creCanvasLast = creCanvas[i].Prev;
+}
+
+
+/*
+ * CRE_CanvasLinkFirst
+ * Coloca una entrada al principio de la lista LRU (la ms reciente).
+ */
+void CRE_CanvasLinkFirst(Sint32 i)
+{
+    creCanvas[i].Prev = CANVAS_NONE;
+    creCanvas[i].Next = creCanvasFirst;
+
+    if(creCanvasFirst != CANVAS_NONE)
+        creCanvas[creCanvasFirst].Prev = i;
+    else
+        creCanvasLast = i;
+
+    creCanvasFirst = i;
+}
+
+
+/*
+ * CRE_CanvasRemove
+ * Elimina una entrada de la cach y libera su lienzo.
+ */
+void CRE_CanvasRemove(Sint32 i)
+{
+    Sint32 * Link;
+    Uint32 h;
+
+    /* La sacamos de su lista de la tabla hash */
+    h = CRE_CanvasHashKey(creCanvas[i].Graph, creCanvas[i].Angle,
+        creCanvas[i].SizeW, creCanvas[i].SizeH);
+    for(Link = creCanvasHash + h; *Link != CANVAS_NONE;
+      Link = &creCanvas[*Link].HNext)
+        if(*Link == i) {
+            *Link = creCanvas[i].HNext;
+            break;
+        }
+
+    /* La sacamos de la lista LRU y liberamos el lienzo */
+    CRE_CanvasUnlink(i);
+    creCanvasBytes -= creCanvas[i].Bytes;
+    SDL_FreeSurface(creCanvas[i].Canvas);
+    creCanvas[i].Canvas = NULL;
+}
+
+
+/*
+ * CRE_CanvasTrim
+ * Elimina los lienzos menos usados hasta que la cach ocupe como mximo la
+ * memoria establecida. Nunca elimina la entrada indicada en Keep.
+ */
+void CRE_CanvasTrim(Sint32 Keep)
+{
+    Sint32 i = creCanvasLast;
+
+    while(creCanvasBytes > creCanvasMaxBytes && i != CANVAS_NONE) {
+        if(i == Keep) {
+            i = creCanvas[i].Prev;
+            continue;
+        }
+        CRE_CanvasRemove(i);
+        i = creCanvasLast;
+    }
+}
+
+
+/*
+ * CRE_FindCanvas
+ * Devuelve un grfico transformado, usando la cach si es posible. Hint guarda
+ * la ltima entrada de la cach usada (+1) y se comprueba la primera.
+ */
+SDL_Surface * CRE_FindCanvas(SDL_Surface * Graph, Sint32 Angle, Sint16 SizeW,
+    Sint16 SizeH, Uint8 Smooth, Uint32 * Hint)
+{
+    SDL_Surface * Canvas;
+    creRotations * Rot;
+    Sint32 i;
+    Uint32 h;
+
+    if(Graph == NULL)
+        return NULL;
+
+    if(!creCanvasInit)
+        CRE_CanvasInit();
+
+    /* Normalizamos el ngulo para aprovechar los giros completos */
+    Angle = Angle % 360000;
+    if(Angle < 0) Angle += 360000;
+
+    /* Si el grfico tiene las rotaciones precalculadas usamos la ms cercana */
+    if(creFirstRotations != NULL && SizeW == SizeH) {
+        for(Rot = creFirstRotations; Rot != NULL; Rot = Rot->Next)
+            if(Rot->Graph == Graph && Rot->Zoom == SizeW)
+                return Rot->Frames[((Angle * Rot->Steps + 180000) / 360000) %
+                    Rot->Steps];
+    }
+
+    /*
+     * Comprobamos primero el ltimo lienzo utilizado, ya que lo habitual es
+     * que el de un proceso no cambie de un frame a otro.
+     */
+    i = (Sint32) *Hint - 1;
+    if(i < 0 || creCanvas[i].Canvas == NULL ||
+       creCanvas[i].Graph != Graph || creCanvas[i].Angle != Angle ||
+       creCanvas[i].SizeW != SizeW || creCanvas[i].SizeH != SizeH ||
+       creCanvas[i].Smooth != Smooth) {
+        /* Buscamos en la tabla hash */
+        h = CRE_CanvasHashKey(Graph, Angle, SizeW, SizeH);
+        for(i = creCanvasHash[h]; i != CANVAS_NONE; i = creCanvas[i].HNext)
+            if(creCanvas[i].Graph == Graph &&
+               creCanvas[i].Angle == Angle &&
+               creCanvas[i].SizeW == SizeW &&
+               creCanvas[i].SizeH == SizeH &&
+               creCanvas[i].Smooth == Smooth)
+                break;
+    }
+
+    /* Si lo hemos encontrado, lo marcamos como el ms reciente */
+    if(i != CANVAS_NONE) {
+        if(creCanvasFirst != i) {
+            CRE_CanvasUnlink(i);
+            CRE_CanvasLinkFirst(i);
+        }
+        *Hint = i + 1;
+        return creCanvas[i].Canvas;
+    }
+
+    /* Si no estaba, aplicamos la transformacin */
+    Canvas = CRE_GfxRZSurfaceXY(Graph, Angle / 1000.0f, SizeW / 100.0f,
+        SizeH / 100.0f, Smooth);
+    if(Canvas == NULL)
+        return NULL;
+
+    /* Buscamos una entrada libre, o reutilizamos la menos usada */
+    for(i = 0; i < CRE_CANVAS_CACHE_ENTRIES; i++)
+        if(creCanvas[i].Canvas == NULL)
+            break;
+    if(i == CRE_CANVAS_CACHE_ENTRIES) {
+        i = creCanvasLast;
+        CRE_CanvasRemove(i);
+    }
+
+    /* Guardamos el lienzo en la entrada */
+    creCanvas[i].Graph = Graph;
+    creCanvas[i].Angle = Angle;
+    creCanvas[i].SizeW = SizeW;
+    creCanvas[i].SizeH = SizeH;
+    creCanvas[i].Smooth = Smooth;
+    creCanvas[i].Canvas = Canvas;
+    creCanvas[i].Bytes = Canvas->pitch * Canvas->h;
+    creCanvas[i].HNext = creCanvasHash[h];
+    creCanvasHash[h] = i;
+    CRE_CanvasLinkFirst(i);
+    creCanvasBytes += creCanvas[i].Bytes;
+
+    /* Ajustamos la cach a la memoria establecida */
+    CRE_CanvasTrim(i);
+
+    *Hint = i + 1;
+    return Canvas;
+}
+
+
+/*
+ * CRE_GetCanvas
+ * Devuelve el lienzo transformado de un proceso, usando la cach si es posible.
+ */
+SDL_Surface * CRE_GetCanvas(creProcess * Process)
+{
+    if(Process == NULL)
+        return NULL;
+
+    return CRE_FindCanvas(Process->Graph, Process->Angle, Process->SizeW,
+        Process->SizeH, (Process->State & CRE_PS_HIGHGFX) >> 1,
+        &Process->Canvas);
+}
+
+
+/*
+ * CRE_SetCanvasCacheSize
+ * Establece la memoria mxima de la cach de lienzos.
+ */
+void CRE_SetCanvasCacheSize(Uint32 Bytes)
+{
+    creCanvasMaxBytes = Bytes;
+    CRE_CanvasTrim(creCanvasFirst);
+}
+
+
+/*
+ * CRE_FlushCanvasCache
+ * Elimina de la cach los lienzos de un grfico, o todos si es NULL.
+ */
+void CRE_FlushCanvasCache(SDL_Surface * Graph)
+{
+    Sint32 i;
+
+    if(!creCanvasInit)
+        return;
+
+    for(i = 0; i < CRE_CANVAS_CACHE_ENTRIES; i++)
+        if(creCanvas[i].Canvas != NULL &&
+           (Graph == NULL || creCanvas[i].Graph == Graph))
+            CRE_CanvasRemove(i);
+}
+
+
+/*
+ * CRE_PrebakeRotations
+ * Genera las rotaciones de un grfico para ser usadas por CRE_GetCanvas.
+ */
+int CRE_PrebakeRotations(SDL_Surface * Graph, Uint32 Steps, Sint16 Zoom)
+{
+    creRotations * Rot;
+    Uint32 i;
+
+    if(Graph == NULL || Steps == 0 || Steps > ROTATIONS_MAX || Zoom <= 0)
+        return -1;
+
+    /* Si ya existan rotaciones de este grfico las sustituimos */
+    CRE_FreeRotations(Graph);
+
+    Rot = (creRotations *) malloc(sizeof(creRotations));
+    if(Rot == NULL)
+        return -1;
+    Rot->Frames = (SDL_Surface **) malloc(sizeof(SDL_Surface *) * Steps);
+    if(Rot->Frames == NULL) {
+        free(Rot);
+        return -1;
+    }
+
+    /* Generamos todas las rotaciones */
+    for(i = 0; i < Steps; i++) {
+        Rot->Frames[i] = CRE_GfxRZSurfaceXY(Graph, (360.0 * i) / Steps,
+            Zoom / 100.0f, Zoom / 100.0f, CRE_GFX_SMOOTH_ON);
+        if(Rot->Frames[i] == NULL) {
+            while(i > 0)
+                SDL_FreeSurface(Rot->Frames[--i]);
+            free(Rot->Frames);
+            free(Rot);
+            return -1;
+        }
+    }
+
+    /* Aadimos el conjunto a la lista */
+    Rot->Graph = Graph;
+    Rot->Zoom = Zoom;
+    Rot->Steps = Steps;
+    Rot->Next = creFirstRotations;
+    creFirstRotations = Rot;
+
+    return 0;
+}
+
+
+/*
+ * CRE_FreeRotations
+ * Elimina las rotaciones precalculadas de un grfico, o todas si es NULL.
+ */
+void CRE_FreeRotations(SDL_Surface * Graph)
+{
+    creRotations ** Link = &creFirstRotations;
+    creRotations * Rot;
+    Uint32 i;
+
+    while(*Link != NULL) {
+        Rot = *Link;
+        if(Graph == NULL || Rot->Graph == Graph) {
+            *Link = Rot->Next;
+            for(i = 0; i < Rot->Steps; i++)
+                SDL_FreeSurface(Rot->Frames[i]);
+            free(Rot->Frames);
+            free(Rot);
+        } else
+            Link = &Rot->Next;
+    }
+}
+
+
+/*
+ * CRE_IsOutside
+ * Indica si un grfico centrado en (X, Y) queda seguro fuera de Clip. Si est
+ * rotado o escalado se usa como tamao la suma de los lados escalada, que
+ * acota la diagonal y por tanto cualquier rotacin, sin transformarlo.
+ */
+Uint8 CRE_IsOutside(SDL_Surface * Graph, Sint32 X, Sint32 Y, Sint32 Angle,
+    Sint16 SizeW, Sint16 SizeH, SDL_Rect * Clip)
+{
+    Sint32 w = Graph->w, h = Graph->h, Scale;
+
+    if(Angle != 0 || SizeW != 100 || SizeH != 100) {
+        Scale = MAX(abs(SizeW), abs(SizeH));
+        w = h = (Graph->w + Graph->h) * Scale / 100 + 2;
+    }
+
+    return X - w / 2 >= Clip->x + Clip->w || X + w / 2 + 1 <= Clip->x ||
+        Y - h / 2 >= Clip->y + Clip->h || Y + h / 2 + 1 <= Clip->y;
+}
+
+
+/*
+ * CRE_DrawProcess
+ * Dibuja el lienzo de un proceso en la superficie indicada.
+ */
+Sint32 CRE_DrawProcess(creProcess * Process, SDL_Surface * Screen)
+{
+    /* Superficie de dibujo, lienzo (grfico transformado o el original) */
+    SDL_Surface * Canvas;
+    /* Rectngulo usado temporalmente para el blit grfico */
+    SDL_Rect GfxRect;
+    /* Posicin en pantalla del centro */
+    Sint32 X, Y;
+    /* Inicio del dibujado y de la fase que se est midiendo */
+    Uint32 ProfBegin, ProfTime;
+
+    /* Solo se dibujan los procesos con grfico y que no estn ocultos */
+    if(Process->Graph == NULL ||
+       (Process->State & (CRE_PS_GHOST | CRE_PS_FREEZE)))
+        return -1;
+
+    /* Ni los que quedan fuera del rea de recorte, antes de transformarlos */
+    X = SCREEN_X(Process);
+    Y = SCREEN_Y(Process);
+    if(CRE_IsOutside(Process->Graph, X, Y, Process->Angle, Process->SizeW,
+       Process->SizeH, &Screen->clip_rect))
+        return -1;
+
+    /*
+     * Dependiendo de las caracterias del proceso: tamao y ngulo
+     * Aplicamos las transformaciones necesarias o no. Los lienzos
+     * transformados se obtienen de la cach, de modo que solo se
+     * vuelven a calcular si el aspecto del proceso ha cambiado.
+     */
+    ProfBegin = ProfTime = CRE_ProfilerBegin();
+    if(Process->Angle != 0 || Process->SizeW != 100 || Process->SizeH != 100) {
+        Canvas = CRE_GetCanvas(Process);
+        ProfTime = CRE_ProfilerMark(CRE_PROF_TRANSFORM, ProfTime);
+    /* Si no hay que aplicar ningn cambio, dibujamos tal cual */
+    } else
+        Canvas = Process->Graph;
+
+    if(Canvas == NULL)
+        return -1;
+
+    /* Preparamos las coordenadas para el blit */
+    GfxRect.x = X - (Canvas->w / 2);
+    GfxRect.y = Y - (Canvas->h / 2);
+
+    /*
+     * Dibujamos el lienzo. Si ambas superficies son de 32 bits lo mezclan
+     * directamente los kernels del core.
+     */
+    if(CRE_GfxBlendBlit(Canvas, Screen, &GfxRect, Process->Alpha,
+        Process->Blend) != 0)
+        CRE_GfxAlphaBlit(Canvas, Screen, &GfxRect, Process->Alpha);
+
+    /* El coste del tipo incluye la transformacin */
+    CRE_ProfilerMarkType(Process->Type, CRE_PROF_BLIT, ProfBegin,
+        CRE_ProfilerMark(CRE_PROF_BLIT, ProfTime));
+
+    return 0;
+}
+
+
+/*
+ * CRE_StoreGrow
+ * Duplica la memoria de todos los vectores del almacn de dibujado.
+ */
+Sint32 CRE_StoreGrow(void)
+{
+    void * Block;
+    Uint32 Size = creStore.Size ? creStore.Size * 2 : STORE_MIN_SIZE;
+
+    STORE_GROW(X, Sint32);
+    STORE_GROW(Y, Sint32);
+    STORE_GROW(Angle, Sint32);
+    STORE_GROW(SizeW, Sint16);
+    STORE_GROW(SizeH, Sint16);
+    STORE_GROW(Z, Uint8);
+    STORE_GROW(Alpha, Uint8);
+    STORE_GROW(Blend, Uint8);
+    STORE_GROW(Smooth, Uint8);
+    STORE_GROW(Graph, Uint32);
+    STORE_GROW(Type, Uint16);
+    STORE_GROW(Process, creProcess *);
+    STORE_GROW(Visible, Uint32);
+    STORE_GROW(Rects, SDL_Rect);
+    STORE_GROW(Order, Uint32);
+    STORE_GROW(Counts, Uint32);
+    STORE_GROW(Graphs, SDL_Surface *);
+    STORE_GROW(GraphNext, Uint32);
+    creStore.Size = Size;
+
+    return 0;
+}
+
+
+/*
+ * CRE_StoreProcess
+ * Aade una entrada al final del almacn de dibujado con el estado actual del
+ * proceso.
+ */
+Sint32 CRE_StoreProcess(creProcess * Process, SDL_Surface * Screen)
+{
+    Uint32 i, g, h;
+
+    if(Process->Graph == NULL ||
+       (Process->State & (CRE_PS_GHOST | CRE_PS_FREEZE)))
+        return -1;
+
+    /*
+     * Si no se puede ampliar el almacn, dibujamos lo que ya contiene y
+     * despus el proceso, de modo que se respeta el orden.
+     */
+    if(creStore.Count == creStore.Size && CRE_StoreGrow() != 0) {
+        CRE_RenderStore(Screen);
+        return CRE_DrawProcess(Process, Screen);
+    }
+
+    /*
+     * Buscamos el ndice del grfico, o se lo asignamos si es nuevo. Lo
+     * habitual es que coincida con el de la entrada anterior.
+     */
+    i = creStore.Count;
+    if(i != 0 && creStore.Graphs[creStore.Graph[i - 1]] == Process->Graph)
+        g = creStore.Graph[i - 1] + 1;
+    else {
+        h = ((Uint32) (size_t) Process->Graph >> 4) & (STORE_HASH_SIZE - 1);
+        for(g = creStore.GraphHash[h]; g != 0; g = creStore.GraphNext[g - 1])
+            if(creStore.Graphs[g - 1] == Process->Graph)
+                break;
+    }
+    if(g == 0) {
+        g = ++creStore.GraphCount;
+        creStore.Graphs[g - 1] = Process->Graph;
+        creStore.GraphNext[g - 1] = creStore.GraphHash[h];
+        creStore.GraphHash[h] = g;
+    }
+
+    i = creStore.Count++;
+    creStore.X[i] = SCREEN_X(Process);
+    creStore.Y[i] = SCREEN_Y(Process);
+    creStore.Angle[i] = Process->Angle;
+    creStore.SizeW[i] = Process->SizeW;
+    creStore.SizeH[i] = Process->SizeH;
+    creStore.Z[i] = Process->Z;
+    creStore.Alpha[i] = Process->Alpha;
+    creStore.Blend[i] = Process->Blend;
+    creStore.Smooth[i] = (Process->State & CRE_PS_HIGHGFX) >> 1;
+    creStore.Graph[i] = g - 1;
+    creStore.Type[i] = Process->Type;
+    creStore.Process[i] = Process;
+
+    return 0;
+}
+
+
+/*
+ * CRE_ClearRenderStore
+ * Vaca el almacn de dibujado.
+ */
+void CRE_ClearRenderStore(void)
+{
+    creStore.Count = 0;
+    creStore.GraphCount = 0;
+    memset(creStore.GraphHash, 0, sizeof(creStore.GraphHash));
+}
+
+
+/*
+ * CRE_StoreSort
+ * Ordena por grfico las entradas visibles de First a Last (no incluida),
+ * contando las de cada grfico. Las entradas con el mismo grfico conservan
+ * su orden.
+ */
+void CRE_StoreSort(Uint32 First, Uint32 Last)
+{
+    Uint32 * Visible = creStore.Visible, * Counts = creStore.Counts;
+    Uint32 i, g, Sum, Tmp;
+
+    memset(Counts, 0, creStore.GraphCount * sizeof(Uint32));
+    for(i = First; i < Last; i++)
+        Counts[creStore.Graph[Visible[i]]]++;
+
+    /* Cada cuenta pasa a ser la posicin de la primera entrada del grfico */
+    for(g = Sum = 0; g < creStore.GraphCount; g++) {
+        Tmp = Counts[g];
+        Counts[g] = Sum;
+        Sum += Tmp;
+    }
+
+    for(i = First; i < Last; i++)
+        creStore.Order[Counts[creStore.Graph[Visible[i]]]++] = Visible[i];
+    memcpy(Visible + First, creStore.Order, (Last - First) * sizeof(Uint32));
+}
+
+
+/*
+ * CRE_RenderStore
+ * Descarta primero, de una pasada, las entradas que quedan fuera del rea de
+ * recorte. Las transformadas se descartan con una cota de su tamao, para no
+ * transformar grficos que no se ven. En las capas que lo permiten, ordena
+ * las entradas por grfico. Despus dibuja las visibles agrupando las
+ * entradas seguidas con el mismo grfico, mezcla y transparencia en un solo
+ * lote, y vaca el almacn.
+ */
+void CRE_RenderStore(SDL_Surface * Screen)
+{
+    SDL_Surface * Canvas;
+    Uint32 i, j, k, m, n;
+    /* Inicio del dibujado y de la fase que se est midiendo */
+    Uint32 ProfBegin, ProfTime;
+
+    if(creStore.Count == 0)
+        return;
+
+    /* Recorte de las entradas fuera del rea visible */
+    ProfTime = CRE_ProfilerBegin();
+    for(i = n = 0; i < creStore.Count; i++)
+        if(!CRE_IsOutside(creStore.Graphs[creStore.Graph[i]], creStore.X[i],
+           creStore.Y[i], creStore.Angle[i], creStore.SizeW[i],
+           creStore.SizeH[i], &Screen->clip_rect))
+            creStore.Visible[n++] = i;
+
+    /* Ordenamos por grfico los tramos de las capas que lo permiten */
+    for(j = 0; j < n; j = k) {
+        for(k = j + 1; k < n && creStore.Z[creStore.Visible[k]] ==
+          creStore.Z[creStore.Visible[j]]; k++);
+        if(k - j > 1 && creBatchLayers[creStore.Z[creStore.Visible[j]]])
+            CRE_StoreSort(j, k);
+    }
+    CRE_ProfilerMark(CRE_PROF_BLIT, ProfTime);
+
+    /* Dibujado de las entradas visibles, por lotes */
+    for(j = 0; j < n; j = k) {
+        i = creStore.Visible[j];
+        Canvas = creStore.Graphs[creStore.Graph[i]];
+        ProfBegin = ProfTime = CRE_ProfilerBegin();
+
+        /* Las entradas transformadas se dibujan de una en una */
+        if(STORE_TRANSFORMED(i)) {
+            k = j + 1;
+            Canvas = CRE_FindCanvas(Canvas, creStore.Angle[i],
+                creStore.SizeW[i], creStore.SizeH[i], creStore.Smooth[i],
+                &creStore.Process[i]->Canvas);
+            ProfTime = CRE_ProfilerMark(CRE_PROF_TRANSFORM, ProfTime);
+            if(Canvas == NULL)
+                continue;
+            creStore.Rects[0].x = creStore.X[i] - (Canvas->w / 2);
+            creStore.Rects[0].y = creStore.Y[i] - (Canvas->h / 2);
+        /* El resto se junta con las siguientes que coinciden con ella */
+        } else
+            for(k = j; k < n; k++) {
+                m = creStore.Visible[k];
+                if(k > j && (creStore.Graph[m] != creStore.Graph[i] ||
+                   creStore.Blend[m] != creStore.Blend[i] ||
+                   creStore.Alpha[m] != creStore.Alpha[i] ||
+                   STORE_TRANSFORMED(m)))
+                    break;
+                creStore.Rects[k - j].x = creStore.X[m] - (Canvas->w / 2);
+                creStore.Rects[k - j].y = creStore.Y[m] - (Canvas->h / 2);
+            }
+
+        /*
+         * Dibujamos el lote. Si los formatos no permiten la mezcla directa,
+         * cada entrada se dibuja por separado.
+         */
+        if(CRE_GfxBlendBlitBatch(Canvas, Screen, creStore.Rects, k - j,
+            creStore.Alpha[i], creStore.Blend[i]) != 0)
+            for(m = 0; m < k - j; m++)
+                CRE_GfxAlphaBlit(Canvas, Screen, creStore.Rects + m,
+                    creStore.Alpha[i]);
+
+        /* El coste del lote se atribuye al tipo de su primera entrada */
+        CRE_ProfilerMarkType(creStore.Type[i], CRE_PROF_BLIT, ProfBegin,
+            CRE_ProfilerMark(CRE_PROF_BLIT, ProfTime));
+    }
+
+    CRE_ClearRenderStore();
+}
+
+
+/*
+ * CRE_SetLayerBatching
+ * Indica si los procesos de una capa pueden dibujarse en cualquier orden.
+ */
+void CRE_SetLayerBatching(Uint8 Z, Uint8 Enable)
+{
+    creBatchLayers[Z] = Enable != 0;
+}
+
+
+/*
+ * CRE_SetCamera
+ * Establece la posicin de la cmara.
+ */
+void CRE_SetCamera(Sint32 X, Sint32 Y)
+{
+    creCameraX = X;
+    creCameraY = Y;
+}
+
+
+/*
+ * CRE_GetCamera
+ * Devuelve la posicin de la cmara.
+ */
+void CRE_GetCamera(Sint32 * X, Sint32 * Y)
+{
+    if(X != NULL)
+        *X = creCameraX;
+    if(Y != NULL)
+        *Y = creCameraY;
+}
+
+
+/*
+ * CRE_SetLayerFixed
+ * Indica si los procesos de una capa se dibujan sin tener en cuenta la
+ * cmara.
+ */
+void CRE_SetLayerFixed(Uint8 Z, Uint8 Fixed)
+{
+    creFixedLayers[Z] = Fixed != 0;
+}
+
+
+/*
+ * CRE_SetRenderMode
+ * Selecciona el modo de dibujado del bucle de procesos.
+ */
+void CRE_SetRenderMode(Uint8 Mode)
+{
+    if(Mode != creRenderMode)
+        CRE_RefreshScreen();
+    creRenderMode = Mode;
+}
+
+
+/*
+ * CRE_GetRenderMode
+ * Devuelve el modo de dibujado del bucle de procesos.
+ */
+Uint8 CRE_GetRenderMode(void)
+{
+    return creRenderMode;
+}
+
+
+/*
+ * CRE_AddDirtyRect
+ * Aade una zona a la lista de rectngulos sucios. Si se solapa con alguno de
+ * los rectngulos de la lista, o si unirlos no cuesta ms que dibujarlos por
+ * separado, se unen, de modo que los rectngulos de la lista nunca se solapan
+ * y ningn pixel se dibuja dos veces.
+ */
+void CRE_AddDirtyRect(Sint32 X, Sint32 Y, Sint32 W, Sint32 H)
+{
+    creDirtyRect r, u, * d;
+    Uint32 i;
+
+    if(creRenderMode != CRE_RENDER_DIRTY || creDirtyAll || W <= 0 || H <= 0)
+        return;
+
+    r.X1 = X; r.Y1 = Y; r.X2 = X + W; r.Y2 = Y + H;
+
+    for(i = 0; i < creDirtyCount; ) {
+        d = creDirty + i;
+        u.X1 = MIN(r.X1, d->X1); u.Y1 = MIN(r.Y1, d->Y1);
+        u.X2 = MAX(r.X2, d->X2); u.Y2 = MAX(r.Y2, d->Y2);
+        if((r.X1 < d->X2 && d->X1 < r.X2 && r.Y1 < d->Y2 && d->Y1 < r.Y2) ||
+           (double) (u.X2 - u.X1) * (u.Y2 - u.Y1) <=
+           (double) (r.X2 - r.X1) * (r.Y2 - r.Y1) +
+           (double) (d->X2 - d->X1) * (d->Y2 - d->Y1)) {
+            /* Sacamos el rectngulo de la lista y volvemos a empezar */
+            r = u;
+            creDirty[i] = creDirty[--creDirtyCount];
+            i = 0;
+        }
+        else
+            i++;
+    }
+
+    /* Si no caben ms rectngulos, redibujamos todo el frame */
+    if(creDirtyCount == CRE_MAX_DIRTY_RECTS)
+        CRE_RefreshScreen();
+    else
+        creDirty[creDirtyCount++] = r;
+}
+
+
+/*
+ * CRE_DirtyProcess
+ * Marca como sucia la zona de pantalla en la que se dibuj un proceso.
+ */
+void CRE_DirtyProcess(creProcess * Process)
+{
+    SDL_Rect * Rect = &Process->Drawn.Rect;
+
+    if(Rect->w != 0)
+        CRE_AddDirtyRect(Rect->x, Rect->y, Rect->w, Rect->h);
+}
+
+
+/*
+ * CRE_RefreshScreen
+ * Fuerza que el siguiente frame se redibuje completo.
+ */
+void CRE_RefreshScreen(void)
+{
+    creDirtyAll = 1;
+    creDirtyCount = 0;
+}
+
+
+/*
+ * CRE_UpdateDrawState
+ * Compara el estado de un proceso con el que tena al dibujarse en el frame
+ * anterior. Si ha cambiado, marca como sucias la zona que ocupaba y la que
+ * ocupa ahora, y guarda el nuevo estado. La posicin se compara en pantalla,
+ * de modo que mover la cmara tambin cambia el estado.
+ */
+void CRE_UpdateDrawState(creProcess * Process, SDL_Surface * Screen)
+{
+    creDrawState * d = &Process->Drawn;
+    Uint8 State = Process->State & DRAW_STATE;
+    SDL_Surface * Canvas = NULL;
+    SDL_Rect Full;
+    Sint32 X = SCREEN_X(Process), Y = SCREEN_Y(Process);
+
+    if(!(Process->State & CRE_PS_CHANGED) && d->Graph == Process->Graph &&
+       d->X == X && d->Y == Y &&
+       d->Angle == Process->Angle && d->SizeW == Process->SizeW &&
+       d->SizeH == Process->SizeH && d->Z == Process->Z &&
+       d->Alpha == Process->Alpha && d->Blend == Process->Blend &&
+       d->State == State)
+        return;
+
+    Process->State &= ~CRE_PS_CHANGED;
+
+    /* La zona que ocupaba debe redibujarse */
+    CRE_DirtyProcess(Process);
+
+    d->Graph = Process->Graph;
+    d->X = X; d->Y = Y; d->Angle = Process->Angle;
+    d->SizeW = Process->SizeW; d->SizeH = Process->SizeH;
+    d->Z = Process->Z; d->Alpha = Process->Alpha; d->Blend = Process->Blend;
+    d->State = State;
+    d->Rect.w = d->Rect.h = 0;
+
+    /* Calculamos la zona que ocupa ahora si es visible */
+    if(Process->Graph == NULL || (State & (CRE_PS_GHOST | CRE_PS_FREEZE)))
+        return;
+    /* Si queda fuera de la pantalla no hace falta transformarlo */
+    Full.x = Full.y = 0; Full.w = Screen->w; Full.h = Screen->h;
+    if(CRE_IsOutside(Process->Graph, X, Y, Process->Angle, Process->SizeW,
+       Process->SizeH, &Full))
+        return;
+    if(Process->Angle != 0 || Process->SizeW != 100 || Process->SizeH != 100)
+        Canvas = CRE_GetCanvas(Process);
+    else
+        Canvas = Process->Graph;
+    if(Canvas == NULL)
+        return;
+
+    d->Rect.x = X - (Canvas->w / 2);
+    d->Rect.y = Y - (Canvas->h / 2);
+    d->Rect.w = Canvas->w;
+    d->Rect.h = Canvas->h;
+    CRE_DirtyProcess(Process);
+}
+
+
+/*
+ * CRE_RenderDirty
+ * Dibuja un frame en el modo de rectngulos sucios: limpia cada zona sucia,
+ * redibuja en orden de Z los procesos que la tocan y actualiza solo esas
+ * zonas de la pantalla.
+ */
+void CRE_RenderDirty(creProcess * First, SDL_Surface * Screen, Uint32 Clear)
+{
+    /* Zonas sucias recortadas con la pantalla */
+    SDL_Rect Rects[CRE_MAX_DIRTY_RECTS];
+    creProcess * Process;
+    creDirtyRect * d;
+    SDL_Rect * r;
+    Uint32 i, n;
+    /* Inicio de la fase que se est midiendo */
+    Uint32 ProfTime;
+
+    /*
+     * Comparamos el estado de cada proceso con el del frame anterior. Los
+     * procesos que han cambiado obtienen aqu su lienzo transformado.
+     */
+    ProfTime = CRE_ProfilerBegin();
+    for(Process = First; Process != NULL; Process = CRE_NextProcess(Process))
+        CRE_UpdateDrawState(Process, Screen);
+    ProfTime = CRE_ProfilerMark(CRE_PROF_TRANSFORM, ProfTime);
+
+    /* Si hay que redibujar todo, la nica zona sucia es la pantalla */
+    if(creDirtyAll) {
+        creDirty[0].X1 = creDirty[0].Y1 = 0;
+        creDirty[0].X2 = Screen->w;
+        creDirty[0].Y2 = Screen->h;
+        creDirtyCount = 1;
+        creDirtyAll = 0;
+    }
+
+    /* Recortamos las zonas con la pantalla */
+    for(i = n = 0; i < creDirtyCount; i++) {
+        d = creDirty + i;
+        d->X1 = MAX(d->X1, 0); d->Y1 = MAX(d->Y1, 0);
+        d->X2 = MIN(d->X2, Screen->w); d->Y2 = MIN(d->Y2, Screen->h);
+        if(d->X1 >= d->X2 || d->Y1 >= d->Y2)
+            continue;
+        Rects[n].x = d->X1; Rects[n].y = d->Y1;
+        Rects[n].w = d->X2 - d->X1; Rects[n].h = d->Y2 - d->Y1;
+        SDL_FillRect(Screen, Rects + n, Clear);
+        n++;
+    }
+    creDirtyCount = 0;
+    CRE_ProfilerMark(CRE_PROF_BLIT, ProfTime);
+
+    if(n == 0)
+        return;
+
+    /*
+     * Redibujamos, en orden de Z, los procesos que tocan cada zona. Como las
+     * zonas no se solapan, cada una se dibuja por separado, a travs del
+     * almacn de dibujado para agrupar los grficos iguales en lotes.
+     */
+    for(i = 0; i < n; i++) {
+        r = Rects + i;
+        SDL_SetClipRect(Screen, r);
+        for(Process = First; Process != NULL;
+          Process = CRE_NextProcess(Process))
+            if(Process->Drawn.Rect.w != 0 &&
+               Process->Drawn.Rect.x < r->x + r->w &&
+               r->x < Process->Drawn.Rect.x + Process->Drawn.Rect.w &&
+               Process->Drawn.Rect.y < r->y + r->h &&
+               r->y < Process->Drawn.Rect.y + Process->Drawn.Rect.h)
+                CRE_StoreProcess(Process, Screen);
+        CRE_RenderStore(Screen);
+    }
+    SDL_SetClipRect(Screen, NULL);
+
+    /* Presentamos solo las zonas redibujadas */
+    ProfTime = CRE_ProfilerBegin();
+    SDL_UpdateRects(Screen, n, Rects);
+    CRE_ProfilerMark(CRE_PROF_FLIP, ProfTime);
+}
@@ -0,0 +1,395 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file replay.c
+ * Implementacin del generador de nmeros aleatorios y de la grabacin y
+ * reproduccin de partidas. Ms informacin en el archivo de cabecera.
+ **/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include <zlib.h>
+#include "process.h"
+#include "replay.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Marca de fin de la grabacin en el nmero de eventos de un paso */
+#define REPLAY_END 0xFF
+
+
+/*
+ * Estado del mundo actual. El generador y la grabacin son propios de cada
+ * mundo de procesos, por lo que se guardan en l (ver creReplayState). Los
+ * ficheros se guardan como void * para no incluir zlib en la cabecera.
+ */
+#define creRandom (CRE_WorldReplay()->Random)
+#define creRecordFile (*(gzFile *) &CRE_WorldReplay()->RecordFile)
+#define creReplayFile (*(gzFile *) &CRE_WorldReplay()->ReplayFile)
+#define creRecordStep (CRE_WorldReplay()->RecordStep)
+#define creRecordLast (CRE_WorldReplay()->RecordLast)
+#define creReplayStep (CRE_WorldReplay()->ReplayStep)
+#define creReplayLast (CRE_WorldReplay()->ReplayLast)
+#define creReplayNext (CRE_WorldReplay()->ReplayNext)
+#define creReplayFast (CRE_WorldReplay()->ReplayFast)
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * CRE_SeedRandom
+ * Inicializa el generador de nmeros aleatorios.
+ */
+void CRE_SeedRandom(Uint32 Seed)
+{
+    /* El estado 0 no sale nunca de 0 */
+    creRandom = Seed ? Seed : CRE_RANDOM_SEED;
+}
+
+
+/*
+ * CRE_Random
+ * Generador xorshift de 32 bits. Se descarta el bit alto para devolver
+ * siempre un nmero positivo, como random().
+ */
+Sint32 CRE_Random(void)
+{
+    Uint32 * Random = &creRandom;
+
+    *Random ^= *Random << 13;
+    *Random ^= *Random >> 17;
+    *Random ^= *Random << 5;
+
+    return (Sint32) (*Random >> 1);
+}
+
+
+/*
+ * CRE_ReplayPut
+ * Escribe un entero sin signo en little endian de los bytes indicados.
+ */
+void CRE_ReplayPut(gzFile File, Uint32 Value, Uint8 Bytes)
+{
+    while(Bytes-- > 0) {
+        gzputc(File, Value & 0xFF);
+        Value >>= 8;
+    }
+}
+
+
+/*
+ * CRE_ReplayGet
+ * Lee un entero sin signo en little endian de los bytes indicados. Devuelve
+ * -1 si se acaba el fichero.
+ */
+Sint32 CRE_ReplayGet(gzFile File, Uint8 Bytes, Uint32 * Value)
+{
+    Uint8 i;
+    int c;
+
+    *Value = 0;
+    for(i = 0; i < Bytes; i++) {
+        if((c = gzgetc(File)) == -1) return -1;
+        *Value |= (Uint32) c << (8 * i);
+    }
+
+    return 0;
+}
+
+
+/*
+ * CRE_ReplayPutCount
+ * Escribe un nmero de pasos en 7 bits por byte, con el bit alto indicando
+ * que sigue otro byte: la mayora de registros ocupan uno solo.
+ */
+void CRE_ReplayPutCount(gzFile File, Uint32 Value)
+{
+    while(Value >= 0x80) {
+        gzputc(File, (Value & 0x7F) | 0x80);
+        Value >>= 7;
+    }
+    gzputc(File, Value);
+}
+
+
+/*
+ * CRE_ReplayGetCount
+ * Lee un nmero de pasos escrito con CRE_ReplayPutCount.
+ */
+Sint32 CRE_ReplayGetCount(gzFile File, Uint32 * Value)
+{
+    Uint8 Shift = 0;
+    int c;
+
+    *Value = 0;
+    do {
+        if((c = gzgetc(File)) == -1 || Shift > 28) return -1;
+        *Value |= (Uint32) (c & 0x7F) << Shift;
+        Shift += 7;
+    } while(c & 0x80);
+
+    return 0;
+}
+
+
+/*
+ * CRE_StartRecord
+ * Abre el fichero de grabacin y escribe la cabecera.
+ */
+Sint32 CRE_StartRecord(const char * FileName, Uint32 Seed)
+{
+    /* Comprobamos los parametros */
+    if(FileName == NULL || creRecordFile != NULL) return -1;
+
+    creRecordFile = gzopen(FileName, "wb");
+    if(creRecordFile == NULL) return -1;
+
+    /* La grabacin empieza en un milisegundo exacto del reloj virtual */
+    CRE_SeedRandom(Seed);
+    CRE_SetTicks(CRE_GetTicks());
+
+    /* Cabecera: identificador, versin, semilla, reloj y duracin del paso */
+    gzwrite(creRecordFile, CRE_REPLAY_MAGIC, 4);
+    gzputc(creRecordFile, CRE_REPLAY_VERSION);
+    CRE_ReplayPut(creRecordFile, Seed, 4);
+    CRE_ReplayPut(creRecordFile, CRE_GetTicks(), 4);
+    CRE_ReplayPut(creRecordFile, (Uint32) CRE_GetStepTime(), 4);
+
+    creRecordStep = creRecordLast = 0;
+
+    return 0;
+}
+
+
+/*
+ * CRE_StopRecord
+ * Escribe la marca de fin y cierra el fichero de grabacin.
+ */
+void CRE_StopRecord(void)
+{
+    if(creRecordFile == NULL) return;
+
+    CRE_ReplayPutCount(creRecordFile, creRecordStep - creRecordLast);
+    gzputc(creRecordFile, REPLAY_END);
+    gzclose(creRecordFile);
+    creRecordFile = NULL;
+}
+
+
+/*
+ * CRE_RecordStep
+ * Graba los eventos de teclado y de salida del paso actual. Cada registro
+ * guarda los pasos desde el anterior, el nmero de eventos y los eventos.
+ */
+void CRE_RecordStep(void)
+{
+    SDL_Event * Event;
+    Uint8 i, Count = 0;
+
+    if(creRecordFile == NULL) return;
+
+    /* Contamos los eventos que se graban */
+    for(i = 0; i < creEList.Size; i++)
+        if(creEList.Events[i].type == SDL_KEYDOWN ||
+           creEList.Events[i].type == SDL_KEYUP ||
+           creEList.Events[i].type == SDL_QUIT)
+            Count++;
+
+    if(Count > 0) {
+        CRE_ReplayPutCount(creRecordFile, creRecordStep - creRecordLast);
+        gzputc(creRecordFile, Count);
+        for(i = 0; i < creEList.Size; i++) {
+            Event = creEList.Events + i;
+            if(Event->type == SDL_QUIT)
+                gzputc(creRecordFile, SDL_QUIT);
+            else if(Event->type == SDL_KEYDOWN || Event->type == SDL_KEYUP) {
+                gzputc(creRecordFile, Event->type);
+                CRE_ReplayPut(creRecordFile, Event->key.keysym.scancode, 1);
+                CRE_ReplayPut(creRecordFile, Event->key.keysym.sym, 2);
+                CRE_ReplayPut(creRecordFile, Event->key.keysym.mod, 2);
+                CRE_ReplayPut(creRecordFile, Event->key.keysym.unicode, 2);
+            }
+        }
+        creRecordLast = creRecordStep;
+    }
+
+    creRecordStep++;
+}
+
+
+/*
+ * CRE_ReplayNext
+ * Lee los pasos hasta el siguiente registro. Devuelve -1 si se acaba el
+ * fichero.
+ */
+Sint32 CRE_ReplayNext(void)
+{
+    Uint32 Delta;
+
+    if(CRE_ReplayGetCount(creReplayFile, &Delta) == -1) return -1;
+    creReplayNext = creReplayLast + Delta;
+
+    return 0;
+}
+
+
+/*
+ * CRE_ReplaySource
+ * Fuente de eventos de la reproduccin: entrega los eventos grabados en cada
+ * paso y termina la reproduccin al llegar a la marca de fin.
+ */
+Uint32 CRE_ReplaySource(SDL_Event * Events, Uint32 Max, void * Arg)
+{
+    SDL_Event Discard;
+    Uint32 Count, Value, i, n = 0;
+    int Type;
+
+    /* Descartamos los eventos reales para que la ventana siga respondiendo */
+    if(!CRE_IsHeadless())
+        while(SDL_PollEvent(&Discard));
+
+    if(creReplayStep++ != creReplayNext) return 0;
+    creReplayLast = creReplayNext;
+
+    /* Registro del paso actual, o fin de la grabacin */
+    if((Type = gzgetc(creReplayFile)) == -1 || Type == REPLAY_END) {
+        CRE_StopReplay();
+        return 0;
+    }
+    Count = (Uint32) Type;
+    for(i = 0; i < Count; i++) {
+        if((Type = gzgetc(creReplayFile)) == -1) break;
+        if(n < Max) {
+            memset(Events + n, 0, sizeof(SDL_Event));
+            Events[n].type = (Uint8) Type;
+        }
+        if(Type == SDL_KEYDOWN || Type == SDL_KEYUP) {
+            if(n < Max) {
+                Events[n].key.state = Type == SDL_KEYDOWN ? SDL_PRESSED :
+                    SDL_RELEASED;
+                CRE_ReplayGet(creReplayFile, 1, &Value);
+                Events[n].key.keysym.scancode = (Uint8) Value;
+                CRE_ReplayGet(creReplayFile, 2, &Value);
+                Events[n].key.keysym.sym = (SDLKey) Value;
+                CRE_ReplayGet(creReplayFile, 2, &Value);
+                Events[n].key.keysym.mod = (SDLMod) Value;
+                CRE_ReplayGet(creReplayFile, 2, &Value);
+                Events[n].key.keysym.unicode = (Uint16) Value;
+            } else {
+                /* Las teclas que no caben se saltan sin leerlas */
+                gzseek(creReplayFile, 7, SEEK_CUR);
+            }
+        }
+        if(n < Max)
+            n++;
+    }
+
+    /* Pasos hasta el siguiente registro */
+    if(CRE_ReplayNext() == -1)
+        CRE_StopReplay();
+
+    return n;
+}
+
+
+/*
+ * CRE_StartReplay
+ * Abre una partida grabada, restablece la semilla y el reloj, y pone sus
+ * eventos como fuente de eventos del bucle.
+ */
+Sint32 CRE_StartReplay(const char * FileName, Uint8 Fast)
+{
+    char Magic[4];
+    Uint32 Seed, Ticks, Step;
+
+    /* Comprobamos los parametros */
+    if(FileName == NULL || creReplayFile != NULL) return -1;
+
+    creReplayFile = gzopen(FileName, "rb");
+    if(creReplayFile == NULL) return -1;
+
+    /* Comprobamos la cabecera; los FPS deben ser los de la grabacin */
+    if(gzread(creReplayFile, Magic, 4) != 4 ||
+       memcmp(Magic, CRE_REPLAY_MAGIC, 4) != 0 ||
+       gzgetc(creReplayFile) != CRE_REPLAY_VERSION ||
+       CRE_ReplayGet(creReplayFile, 4, &Seed) == -1 ||
+       CRE_ReplayGet(creReplayFile, 4, &Ticks) == -1 ||
+       CRE_ReplayGet(creReplayFile, 4, &Step) == -1 ||
+       Step != (Uint32) CRE_GetStepTime()) {
+        gzclose(creReplayFile);
+        creReplayFile = NULL;
+        return -1;
+    }
+
+    creReplayStep = creReplayLast = 0;
+    if(CRE_ReplayNext() == -1) {
+        gzclose(creReplayFile);
+        creReplayFile = NULL;
+        return -1;
+    }
+
+    CRE_SeedRandom(Seed);
+    CRE_SetTicks(Ticks);
+    CRE_SetEventSource(CRE_ReplaySource, NULL);
+    creReplayFast = Fast;
+    if(Fast)
+        CRE_SetFastForward(1);
+
+    return 0;
+}
+
+
+/*
+ * CRE_StopReplay
+ * Termina la reproduccin y devuelve los eventos a SDL. Sin pantalla no hay
+ * eventos de SDL, por lo que el bucle se quedara esperando: lo acabamos.
+ */
+void CRE_StopReplay(void)
+{
+    if(creReplayFile == NULL) return;
+
+    gzclose(creReplayFile);
+    creReplayFile = NULL;
+    CRE_SetEventSource(NULL, NULL);
+    if(creReplayFast)
+        CRE_SetFastForward(0);
+    creReplayFast = 0;
+
+    if(CRE_IsHeadless())
+        CRE_EndLoop();
+}
+
+
+/*
+ * CRE_IsReplaying
+ * Indica si se est reproduciendo una partida.
+ */
+Uint8 CRE_IsReplaying(void)
+{
+    return creReplayFile != NULL;
+}
@@ -38,6 +38,8 @@
 
 /* Define los bits constantes de las cabeceras de los archivos */
 #define MSC_MAGIC "MSc\x69\xFF\x2D"
+/* Marca de la seccin opcional de tiles animados, tras los puntos clave */
+#define MSC_ANIM_MAGIC "MScA"
 
 
 /*
@@ -74,6 +76,7 @@ creMSc * CRE_LoadMSc(char * FileName) {
     gzFile * File;
     creMSc * MSc;
     creMScHeader Header;
+    char Magic[4];
     int m;
 
     /* Abrimos el fichero */
@@ -100,6 +103,18 @@ creMSc * CRE_LoadMSc(char * FileName) {
     MSc->KeyPoints = (crePoint *) malloc(sizeof(crePoint) * MSc->KPCount);
     gzread(File, MSc->KeyPoints, sizeof(crePoint) * MSc->KPCount);
 
+    /* Leemos los tiles animados, si los hay (los archivos antiguos no los
+       tienen) */
+    MSc->AnimCount = 0;
+    MSc->Anims = NULL;
+    if(gzread(File, Magic, 4) == 4 && memcmp(Magic, MSC_ANIM_MAGIC, 4) == 0 &&
+       gzread(File, &m, sizeof(int)) == sizeof(int) && m > 0) {
+        MSc->Anims = (creTileAnim *) malloc(sizeof(creTileAnim) * m);
+        if(MSc->Anims != NULL && gzread(File, MSc->Anims,
+           sizeof(creTileAnim) * m) == (int) (sizeof(creTileAnim) * m))
+            MSc->AnimCount = m;
+    }
+
     /* Cerramos el archivo y devolvemos */
     gzclose(File);
     return MSc;
@@ -128,6 +143,14 @@ int CRE_SaveMSc(creMSc * Src, char * FileName)
     gzwrite(File, Src->Map, Header.W * Header.H);
     gzwrite(File, Src->KeyPoints, Header.KPCount * sizeof(crePoint));
 
+    /* Los tiles animados van al final, para que los archivos sin ellos sigan
+       siendo iguales */
+    if(Src->AnimCount > 0) {
+        gzwrite(File, MSC_ANIM_MAGIC, 4);
+        gzwrite(File, &Src->AnimCount, sizeof(int));
+        gzwrite(File, Src->Anims, Src->AnimCount * sizeof(creTileAnim));
+    }
+
     gzclose(File);
     return 0;
 }
@@ -141,6 +164,7 @@ void CRE_FreeMSc(creMSc * Src)
 {
     free(Src->Map);
     free(Src->KeyPoints);
+    free(Src->Anims);
     free(Src);
 }
 
@@ -203,3 +227,571 @@ int CRE_DrawMScToSurface(creMSc * Src, SDL_Surface * Trg, creMGf * Gfxs)
  }
 
 
+/*
+ * CRE_NewTileMap
+ * Crea un mapa de tiles por trozos de un escenario.
+ */
+creTileMap * CRE_NewTileMap(creMSc * Src, Uint32 MaxChunks)
+{
+    creTileMap * Map;
+    creTileAnim * Anim;
+    Sint32 i;
+
+    /* Comprobamos los parametros */
+    if(Src == NULL) return NULL;
+
+    Map = (creTileMap *) calloc(1, sizeof(creTileMap));
+    if(Map == NULL) return NULL;
+    Map->MSc = Src;
+    Map->ChunksW = (Src->W + CRE_TILE_CHUNK - 1) / CRE_TILE_CHUNK;
+    Map->ChunksH = (Src->H + CRE_TILE_CHUNK - 1) / CRE_TILE_CHUNK;
+    Map->Built = 0;
+    Map->MaxBuilt = MaxChunks ? MaxChunks : CRE_TILE_CHUNKS;
+    Map->First = Map->Last = -1;
+
+    /*
+     * Cargamos los grficos y creamos los trozos, an sin construir. Sin
+     * pantalla no se dibuja nada: el mapa solo guarda el escenario.
+     */
+    if(!CRE_IsHeadless())
+        Map->Gfxs = CRE_LoadMGf(Src->Skin);
+    Map->Chunks = (creTileChunk *) calloc(Map->ChunksW * Map->ChunksH,
+        sizeof(creTileChunk));
+    if(Src->AnimCount > 0) {
+        Map->AnimFrame = (Uint8 *) calloc(Src->AnimCount, sizeof(Uint8));
+        Map->AnimChanged = (Uint8 *) calloc(Src->AnimCount, sizeof(Uint8));
+    }
+    if((Map->Gfxs == NULL && !CRE_IsHeadless()) || Map->Chunks == NULL ||
+       (Src->AnimCount > 0 &&
+       (Map->AnimFrame == NULL || Map->AnimChanged == NULL))) {
+        if(Map->Gfxs != NULL) CRE_FreeMGf(Map->Gfxs);
+        free(Map->Chunks);
+        free(Map->AnimFrame);
+        free(Map->AnimChanged);
+        free(Map);
+        return NULL;
+    }
+    for(i = 0; i < Map->ChunksW * Map->ChunksH; i++)
+        Map->Chunks[i].Prev = Map->Chunks[i].Next = -1;
+
+    /* Asociamos cada animacin a su tile, ignorando las que se salen del
+       skin (sin grficos no hay nada que animar) */
+    for(i = 0; Map->Gfxs != NULL && i < Src->AnimCount; i++) {
+        Anim = Src->Anims + i;
+        if(Anim->Frames > 0 && Anim->Period > 0 &&
+           Anim->Tile + Anim->Frames <= Map->Gfxs->Size)
+            Map->AnimOf[Anim->Tile] = i + 1;
+    }
+
+    return Map;
+}
+
+
+/*
+ * CRE_TileChunkUnlink
+ * Saca un trozo de la lista de trozos construidos.
+ */
+void CRE_TileChunkUnlink(creTileMap * Map, Sint32 c)
+{
+    creTileChunk * Chunk = Map->Chunks + c;
+
+    if(Chunk->Prev != -1) Map->Chunks[Chunk->Prev].Next = Chunk->Next;
+    else Map->First = Chunk->Next;
+    if(Chunk->Next != -1) Map->Chunks[Chunk->Next].Prev = Chunk->Prev;
+    else Map->Last = Chunk->Prev;
+    Chunk->Prev = Chunk->Next = -1;
+}
+
+
+/*
+ * CRE_TileChunkLinkFirst
+ * Coloca un trozo al principio de la lista de trozos construidos.
+ */
+void CRE_TileChunkLinkFirst(creTileMap * Map, Sint32 c)
+{
+    creTileChunk * Chunk = Map->Chunks + c;
+
+    Chunk->Prev = -1;
+    Chunk->Next = Map->First;
+    if(Map->First != -1) Map->Chunks[Map->First].Prev = c;
+    else Map->Last = c;
+    Map->First = c;
+}
+
+
+/*
+ * CRE_TileChunkFree
+ * Elimina el grfico de un trozo construido.
+ */
+void CRE_TileChunkFree(creTileMap * Map, Sint32 c)
+{
+    creTileChunk * Chunk = Map->Chunks + c;
+
+    CRE_TileChunkUnlink(Map, c);
+    SDL_FreeSurface(Chunk->Surface);
+    Chunk->Surface = NULL;
+    free(Chunk->Anims);
+    Chunk->Anims = NULL;
+    Chunk->AnimCount = 0;
+    Map->Built--;
+}
+
+
+/*
+ * CRE_TileChunkDrawTile
+ * Dibuja en el grfico de su trozo el grfico actual de un tile y, encima, el
+ * del objeto recogible que haya en l.
+ */
+void CRE_TileChunkDrawTile(creTileMap * Map, SDL_Surface * Chunk, Sint32 X,
+    Sint32 Y)
+{
+    creMSc * Src = Map->MSc;
+    crePickupLayer * Layer = Map->Pickups;
+    Uint8 Tile = (Uint8) Src->Map[X + Y * Src->W], Item;
+    SDL_Surface * Graph;
+    SDL_Rect Dst;
+
+    if(Map->AnimOf[Tile])
+        Tile += Map->AnimFrame[Map->AnimOf[Tile] - 1];
+
+    Dst.x = (X % CRE_TILE_CHUNK) * Src->Size;
+    Dst.y = (Y % CRE_TILE_CHUNK) * Src->Size;
+    Dst.w = Dst.h = Src->Size;
+    SDL_FillRect(Chunk, &Dst, 0xFF);
+    SDL_BlitSurface(Map->Gfxs->Gfx[Tile], NULL, Chunk, &Dst);
+
+    /* El objeto se dibuja centrado en la casilla */
+    if(Layer == NULL || (Item = Layer->Items[X + Y * Src->W]) == 0 ||
+       Layer->Kinds[Item - 1].Frames == 0)
+        return;
+    Graph = Layer->Gfxs->Gfx[Layer->Kinds[Item - 1].Tile +
+        Layer->Frame[Item - 1]];
+    Dst.x = (X % CRE_TILE_CHUNK) * Src->Size + (Src->Size - Graph->w) / 2;
+    Dst.y = (Y % CRE_TILE_CHUNK) * Src->Size + (Src->Size - Graph->h) / 2;
+    SDL_BlitSurface(Graph, NULL, Chunk, &Dst);
+}
+
+
+/*
+ * CRE_TileIsAnimated
+ * Indica si una casilla tiene un tile animado o un objeto animado.
+ */
+Uint8 CRE_TileIsAnimated(creTileMap * Map, Sint32 X, Sint32 Y)
+{
+    crePickupLayer * Layer = Map->Pickups;
+    Sint32 k = X + Y * Map->MSc->W;
+
+    if(Map->AnimOf[(Uint8) Map->MSc->Map[k]])
+        return 1;
+    return Layer != NULL && Layer->Items[k] != 0 &&
+        Layer->Kinds[Layer->Items[k] - 1].Frames > 1;
+}
+
+
+/*
+ * CRE_TileHasChanged
+ * Indica si el grfico de una casilla ha cambiado en el ltimo paso de las
+ * animaciones.
+ */
+Uint8 CRE_TileHasChanged(creTileMap * Map, Sint32 X, Sint32 Y)
+{
+    crePickupLayer * Layer = Map->Pickups;
+    Sint32 k = X + Y * Map->MSc->W;
+    Uint16 a = Map->AnimOf[(Uint8) Map->MSc->Map[k]];
+
+    if(a && Map->AnimChanged[a - 1])
+        return 1;
+    return Layer != NULL && Layer->Items[k] != 0 &&
+        Layer->Changed[Layer->Items[k] - 1];
+}
+
+
+/*
+ * CRE_TileChunkAnims
+ * Rehace la lista de casillas animadas de un trozo construido.
+ */
+void CRE_TileChunkAnims(creTileMap * Map, Sint32 c)
+{
+    creMSc * Src = Map->MSc;
+    creTileChunk * Chunk = Map->Chunks + c;
+    Uint16 Cells[CRE_TILE_CHUNK * CRE_TILE_CHUNK];
+    Sint32 i, j, i0, j0, i1, j1, n = 0;
+
+    free(Chunk->Anims);
+    Chunk->Anims = NULL;
+    Chunk->AnimCount = 0;
+    if(Src->AnimCount == 0 && Map->Pickups == NULL) return;
+
+    i0 = (c % Map->ChunksW) * CRE_TILE_CHUNK;
+    j0 = (c / Map->ChunksW) * CRE_TILE_CHUNK;
+    i1 = MIN(i0 + CRE_TILE_CHUNK, Src->W);
+    j1 = MIN(j0 + CRE_TILE_CHUNK, Src->H);
+    for(j = j0; j < j1; j++)
+        for(i = i0; i < i1; i++)
+            if(CRE_TileIsAnimated(Map, i, j))
+                Cells[n++] = (i - i0) + (j - j0) * CRE_TILE_CHUNK;
+
+    if(n == 0) return;
+    Chunk->Anims = (Uint16 *) malloc(sizeof(Uint16) * n);
+    if(Chunk->Anims == NULL) return;
+    memcpy(Chunk->Anims, Cells, sizeof(Uint16) * n);
+    Chunk->AnimCount = n;
+}
+
+
+/*
+ * CRE_TileChunkBuild
+ * Construye el grfico de un trozo dibujando sus tiles. Si hay demasiados
+ * trozos construidos, elimina el usado hace ms tiempo.
+ */
+SDL_Surface * CRE_TileChunkBuild(creTileMap * Map, Sint32 c)
+{
+    creMSc * Src = Map->MSc;
+    SDL_PixelFormat * f = creScreen->format;
+    SDL_Surface * Trg;
+    Sint32 i, j, i0, j0, i1, j1;
+
+    /* Tiles que ocupa el trozo (los del borde pueden ser ms pequeos) */
+    i0 = (c % Map->ChunksW) * CRE_TILE_CHUNK;
+    j0 = (c / Map->ChunksW) * CRE_TILE_CHUNK;
+    i1 = i0 + CRE_TILE_CHUNK; if(i1 > Src->W) i1 = Src->W;
+    j1 = j0 + CRE_TILE_CHUNK; if(j1 > Src->H) j1 = Src->H;
+
+    if(Map->Built >= Map->MaxBuilt && Map->Last != -1)
+        CRE_TileChunkFree(Map, Map->Last);
+
+    /* Creamos el grfico con el formato de la pantalla */
+    Trg = SDL_CreateRGBSurface(SDL_SWSURFACE, (i1 - i0) * Src->Size,
+        (j1 - j0) * Src->Size, f->BitsPerPixel, f->Rmask, f->Gmask, f->Bmask,
+        f->Amask);
+    if(Trg == NULL) return NULL;
+
+    /* Dibujamos sus tiles, los animados con su grfico actual */
+    for(j = j0; j < j1; j++)
+        for(i = i0; i < i1; i++)
+            CRE_TileChunkDrawTile(Map, Trg, i, j);
+
+    Map->Chunks[c].Surface = Trg;
+    CRE_TileChunkAnims(Map, c);
+    CRE_TileChunkLinkFirst(Map, c);
+    Map->Built++;
+
+    return Trg;
+}
+
+
+/*
+ * CRE_DrawTileMap
+ * Dibuja los trozos del mapa que se ven desde la cmara indicada.
+ */
+int CRE_DrawTileMap(creTileMap * Map, SDL_Surface * Trg, Sint32 X, Sint32 Y)
+{
+    SDL_Rect * Clip, Dst;
+    SDL_Surface * Chunk;
+    Sint32 cx0, cy0, cx1, cy1, cx, cy, c, Side;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL || Trg == NULL || Map->Gfxs == NULL) return -1;
+
+    Clip = &Trg->clip_rect;
+    Side = CRE_TILE_CHUNK * Map->MSc->Size;
+
+    /* Si la cmara sale del escenario, limpiamos la zona visible */
+    if(X + Clip->x < 0 || Y + Clip->y < 0 ||
+       X + Clip->x + Clip->w > Map->MSc->W * Map->MSc->Size ||
+       Y + Clip->y + Clip->h > Map->MSc->H * Map->MSc->Size)
+        SDL_FillRect(Trg, Clip, 0);
+
+    /* Trozos que tocan el rea de recorte */
+    cx0 = X + Clip->x; cy0 = Y + Clip->y;
+    cx1 = cx0 + Clip->w - 1; cy1 = cy0 + Clip->h - 1;
+    cx0 = cx0 < 0 ? 0 : cx0 / Side; cy0 = cy0 < 0 ? 0 : cy0 / Side;
+    cx1 = cx1 < 0 ? -1 : cx1 / Side; cy1 = cy1 < 0 ? -1 : cy1 / Side;
+    if(cx1 >= Map->ChunksW) cx1 = Map->ChunksW - 1;
+    if(cy1 >= Map->ChunksH) cy1 = Map->ChunksH - 1;
+
+    for(cy = cy0; cy <= cy1; cy++)
+        for(cx = cx0; cx <= cx1; cx++) {
+            c = cx + cy * Map->ChunksW;
+            Chunk = Map->Chunks[c].Surface;
+            /* Lo construimos si es necesario, o lo marcamos como reciente */
+            if(Chunk == NULL) {
+                Chunk = CRE_TileChunkBuild(Map, c);
+                if(Chunk == NULL) return -1;
+            } else if(Map->First != c) {
+                CRE_TileChunkUnlink(Map, c);
+                CRE_TileChunkLinkFirst(Map, c);
+            }
+            Dst.x = cx * Side - X;
+            Dst.y = cy * Side - Y;
+            SDL_BlitSurface(Chunk, NULL, Trg, &Dst);
+        }
+
+    return 0;
+}
+
+
+/*
+ * CRE_FlushTileMap
+ * Elimina todos los trozos construidos del mapa.
+ */
+void CRE_FlushTileMap(creTileMap * Map)
+{
+    if(Map == NULL) return;
+
+    while(Map->First != -1)
+        CRE_TileChunkFree(Map, Map->First);
+}
+
+
+/*
+ * CRE_SetTile
+ * Cambia un tile del escenario y lo redibuja en su trozo si est construido.
+ */
+int CRE_SetTile(creTileMap * Map, Sint32 X, Sint32 Y, char Tile)
+{
+    creMSc * Src;
+    Sint32 c;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL) return -1;
+    Src = Map->MSc;
+    if(X < 0 || Y < 0 || X >= Src->W || Y >= Src->H || Tile < 0 ||
+       (Map->Gfxs != NULL && (Uint32) Tile >= Map->Gfxs->Size))
+        return -1;
+
+    Src->Map[X + Y * Src->W] = Tile;
+
+    /* Redibujamos solo ese tile en su trozo, igual que al construirlo */
+    c = X / CRE_TILE_CHUNK + (Y / CRE_TILE_CHUNK) * Map->ChunksW;
+    if(Map->Chunks[c].Surface != NULL) {
+        CRE_TileChunkDrawTile(Map, Map->Chunks[c].Surface, X, Y);
+        CRE_TileChunkAnims(Map, c);
+    }
+
+    return 0;
+}
+
+
+/*
+ * CRE_AnimateTileMap
+ * Avanza los tiles animados y redibuja las casillas que cambian de grfico.
+ */
+Uint32 CRE_AnimateTileMap(creTileMap * Map, Uint32 Time, SDL_Surface * Trg,
+    Sint32 X, Sint32 Y)
+{
+    creMSc * Src;
+    crePickupLayer * Layer;
+    creTileChunk * Chunk;
+    creTileAnim * Anim;
+    SDL_Rect * Clip, Rect, Dst;
+    Sint32 a, c, k, i, j, x0, y0, x1, y1, n = 0, Changed = 0;
+    Uint8 Frame;
+
+    if(Map == NULL) return 0;
+    Src = Map->MSc;
+    Map->ChangedCount = 0;
+
+    /* Calculamos el grfico actual de cada animacin */
+    for(a = 0; a < Src->AnimCount; a++) {
+        Anim = Src->Anims + a;
+        Map->AnimChanged[a] = 0;
+        if(Map->AnimOf[Anim->Tile] != a + 1) continue;
+        Frame = (Time / Anim->Period) % Anim->Frames;
+        if(Frame != Map->AnimFrame[a]) {
+            Map->AnimFrame[a] = Frame;
+            Map->AnimChanged[a] = Changed = 1;
+        }
+    }
+
+    /* Y el de cada tipo de objeto recogible */
+    Layer = Map->Pickups;
+    for(a = 0; Layer != NULL && a < (Sint32) Layer->KindCount; a++) {
+        Anim = Layer->Kinds + a;
+        Layer->Changed[a] = 0;
+        if(Anim->Frames < 2) continue;
+        Frame = (Time / Anim->Period) % Anim->Frames;
+        if(Frame != Layer->Frame[a]) {
+            Layer->Frame[a] = Frame;
+            Layer->Changed[a] = Changed = 1;
+        }
+    }
+    if(!Changed) return 0;
+
+    /* Recorremos las casillas animadas de los trozos construidos */
+    for(c = Map->First; c != -1; c = Chunk->Next) {
+        Chunk = Map->Chunks + c;
+        for(k = 0; k < Chunk->AnimCount; k++) {
+            i = (c % Map->ChunksW) * CRE_TILE_CHUNK +
+                Chunk->Anims[k] % CRE_TILE_CHUNK;
+            j = (c / Map->ChunksW) * CRE_TILE_CHUNK +
+                Chunk->Anims[k] / CRE_TILE_CHUNK;
+            if(!CRE_TileHasChanged(Map, i, j)) continue;
+            CRE_TileChunkDrawTile(Map, Chunk->Surface, i, j);
+            n++;
+
+            if(Trg == NULL) continue;
+
+            /* Copiamos la casilla a Trg si se ve en su rea de recorte */
+            Clip = &Trg->clip_rect;
+            x0 = MAX(i * Src->Size - X, Clip->x);
+            y0 = MAX(j * Src->Size - Y, Clip->y);
+            x1 = MIN(i * Src->Size - X + Src->Size, Clip->x + Clip->w);
+            y1 = MIN(j * Src->Size - Y + Src->Size, Clip->y + Clip->h);
+            if(x0 >= x1 || y0 >= y1) continue;
+            Rect.x = x0 + X - (c % Map->ChunksW) * CRE_TILE_CHUNK * Src->Size;
+            Rect.y = y0 + Y - (c / Map->ChunksW) * CRE_TILE_CHUNK * Src->Size;
+            Rect.w = Dst.w = x1 - x0;
+            Rect.h = Dst.h = y1 - y0;
+            Dst.x = x0; Dst.y = y0;
+            SDL_BlitSurface(Chunk->Surface, &Rect, Trg, &Dst);
+
+            /* Y guardamos la zona para que la aplicacin la marque */
+            if(Map->ChangedCount == Map->ChangedSize) {
+                SDL_Rect * Tmp = (SDL_Rect *) realloc(Map->Changed,
+                    sizeof(SDL_Rect) * (Map->ChangedSize ?
+                    Map->ChangedSize * 2 : 64));
+                if(Tmp == NULL) continue;
+                Map->Changed = Tmp;
+                Map->ChangedSize = Map->ChangedSize ? Map->ChangedSize * 2 : 64;
+            }
+            Map->Changed[Map->ChangedCount++] = Dst;
+        }
+    }
+
+    return n;
+}
+
+
+/*
+ * CRE_FreePickupLayer
+ * Elimina una capa de objetos recogibles.
+ */
+void CRE_FreePickupLayer(crePickupLayer * Layer)
+{
+    if(Layer == NULL) return;
+
+    free(Layer->Items);
+    free(Layer->Kinds);
+    free(Layer->Frame);
+    free(Layer->Changed);
+    free(Layer);
+}
+
+
+/*
+ * CRE_NewPickupLayer
+ * Crea la capa de objetos recogibles de un mapa de tiles.
+ */
+crePickupLayer * CRE_NewPickupLayer(creTileMap * Map, creMGf * Gfxs,
+    creTileAnim * Kinds, Uint32 KindCount)
+{
+    crePickupLayer * Layer;
+    Uint32 i;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL || (Gfxs == NULL && !CRE_IsHeadless()) || Kinds == NULL ||
+       KindCount == 0 || KindCount > 255)
+        return NULL;
+
+    Layer = (crePickupLayer *) calloc(1, sizeof(crePickupLayer));
+    if(Layer == NULL) return NULL;
+    Layer->Gfxs = Gfxs;
+    Layer->KindCount = KindCount;
+    Layer->Items = (Uint8 *) calloc(Map->MSc->W * Map->MSc->H, sizeof(Uint8));
+    Layer->Kinds = (creTileAnim *) malloc(sizeof(creTileAnim) * KindCount);
+    Layer->Frame = (Uint8 *) calloc(KindCount, sizeof(Uint8));
+    Layer->Changed = (Uint8 *) calloc(KindCount, sizeof(Uint8));
+    if(Layer->Items == NULL || Layer->Kinds == NULL || Layer->Frame == NULL ||
+       Layer->Changed == NULL) {
+        CRE_FreePickupLayer(Layer);
+        return NULL;
+    }
+
+    /* Los tipos que se salen de los grficos (o todos, si no hay) no se
+       dibujan */
+    memcpy(Layer->Kinds, Kinds, sizeof(creTileAnim) * KindCount);
+    for(i = 0; i < KindCount; i++)
+        if(Gfxs == NULL || Kinds[i].Period == 0 ||
+           Kinds[i].Tile + Kinds[i].Frames > Gfxs->Size)
+            Layer->Kinds[i].Frames = 0;
+
+    /* Los trozos construidos no tienen la capa: los descartamos */
+    CRE_FlushTileMap(Map);
+    CRE_FreePickupLayer(Map->Pickups);
+    Map->Pickups = Layer;
+
+    return Layer;
+}
+
+
+/*
+ * CRE_SetPickup
+ * Coloca o quita un objeto de una casilla.
+ */
+int CRE_SetPickup(creTileMap * Map, Sint32 X, Sint32 Y, Uint8 Item)
+{
+    crePickupLayer * Layer;
+    Uint8 * Cell;
+    Sint32 c;
+
+    /* Comprobamos los parametros */
+    if(Map == NULL || (Layer = Map->Pickups) == NULL) return -1;
+    if(X < 0 || Y < 0 || X >= Map->MSc->W || Y >= Map->MSc->H ||
+       Item > Layer->KindCount)
+        return -1;
+
+    Cell = Layer->Items + X + Y * Map->MSc->W;
+    if(*Cell == Item) return 0;
+    if(*Cell == 0) Layer->Count++;
+    if(Item == 0) Layer->Count--;
+    *Cell = Item;
+
+    /* Redibujamos la casilla en su trozo */
+    c = X / CRE_TILE_CHUNK + (Y / CRE_TILE_CHUNK) * Map->ChunksW;
+    if(Map->Chunks[c].Surface != NULL) {
+        CRE_TileChunkDrawTile(Map, Map->Chunks[c].Surface, X, Y);
+        CRE_TileChunkAnims(Map, c);
+    }
+
+    return 0;
+}
+
+
+/*
+ * CRE_TakePickup
+ * Recoge el objeto de una casilla, si lo hay.
+ */
+Uint8 CRE_TakePickup(creTileMap * Map, Sint32 X, Sint32 Y)
+{
+    Uint8 Item;
+
+    if(Map == NULL || Map->Pickups == NULL || X < 0 || Y < 0 ||
+       X >= Map->MSc->W || Y >= Map->MSc->H)
+        return 0;
+
+    Item = Map->Pickups->Items[X + Y * Map->MSc->W];
+    if(Item != 0)
+        CRE_SetPickup(Map, X, Y, 0);
+
+    return Item;
+}
+
+
+/*
+ * CRE_FreeTileMap
+ * Elimina un mapa de tiles por trozos.
+ */
+void CRE_FreeTileMap(creTileMap * Map)
+{
+    if(Map == NULL) return;
+
+    CRE_FlushTileMap(Map);
+    CRE_FreeMGf(Map->Gfxs);
+    free(Map->Chunks);
+    free(Map->AnimFrame);
+    free(Map->AnimChanged);
+    free(Map->Changed);
+    CRE_FreePickupLayer(Map->Pickups);
+    free(Map);
+}
@@ -0,0 +1,375 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file nav.c
+ * Prueba de la bsqueda de caminos de nav.c. Compara la bsqueda por saltos
+ * y el A* casilla a casilla con una bsqueda en anchura, tanto si se llega al
+ * destino como si se pide la casilla alcanzable ms cercana. Tambin resuelve
+ * lotes de consultas con un grupo de hilos y los compara con las consultas
+ * sueltas. Devuelve 0 si no hay diferencias.
+ **/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include "nav.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Tamao mximo de los mapas aleatorios */
+#define MAP_MAX 40
+
+/* Nmero de mapas aleatorios y de caminos que se buscan en cada uno */
+#define MAPS 200
+#define PATHS 100
+
+/* Agente de la prueba */
+#define AGENT 0x01
+
+/* Consultas de cada lote y nmero de hilos del grupo con hilos */
+#define BATCH 64
+#define POOL_THREADS 4
+
+
+/*
+ * Variables globales al fichero
+ */
+
+/* Estado del generador de nmeros aleatorios de la prueba */
+Uint32 Seed = 0x2545F491;
+
+/* Agentes que pueden pasar por cada tile: 0 libre, 1 muro */
+Uint8 Masks[256] = {AGENT};
+
+/* Distancias de la bsqueda en anchura y cola de casillas */
+Sint32 Dist[MAP_MAX * MAP_MAX], Queue[MAP_MAX * MAP_MAX];
+
+/* Camino devuelto */
+Sint32 Path[MAP_MAX * MAP_MAX];
+
+/* Caminos de las consultas de un lote */
+Sint32 BatchPaths[BATCH][MAP_MAX * MAP_MAX];
+
+/* Nmero de comprobaciones y de fallos */
+Uint32 Checks = 0, Failures = 0;
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * TestRandom
+ * Generador xorshift de 32 bits, para que la prueba no dependa de la
+ * biblioteca de C.
+ */
+Uint32 TestRandom(void)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+
+    return Seed;
+}
+
+
+/*
+ * Fail
+ * Cuenta un fallo y lo describe.
+ */
+void Fail(const char * What, Sint32 FromX, Sint32 FromY, Sint32 ToX,
+    Sint32 ToY, Sint32 Found, Sint32 Expected)
+{
+    Failures++;
+    fprintf(stderr, "%s: (%d,%d) -> (%d,%d) da %d, se esperaba %d\n", What,
+        FromX, FromY, ToX, ToY, Found, Expected);
+}
+
+
+/*
+ * Distances
+ * Bsqueda en anchura desde una casilla. Deja en Dist los pasos hasta cada
+ * casilla, o -1 si no se puede llegar.
+ */
+void Distances(creNavMap * Map, Sint32 Start)
+{
+    static const Sint32 DX[4] = {-1, 1, 0, 0}, DY[4] = {0, 0, -1, 1};
+    Sint32 Head = 0, Tail = 0, c, n, x, y;
+
+    for(c = 0; c < Map->W * Map->H; c++)
+        Dist[c] = -1;
+    Dist[Start] = 0;
+    Queue[Tail++] = Start;
+
+    while(Head < Tail) {
+        c = Queue[Head++];
+        for(n = 0; n < 4; n++) {
+            x = c % Map->W + DX[n];
+            y = c / Map->W + DY[n];
+            if(!CRE_NavWalkable(Map, AGENT, x, y) ||
+              Dist[x + y * Map->W] != -1)
+                continue;
+            Dist[x + y * Map->W] = Dist[c] + 1;
+            Queue[Tail++] = x + y * Map->W;
+        }
+    }
+}
+
+
+/*
+ * Nearest
+ * Casilla alcanzable ms cercana al destino y, a igual distancia, la que
+ * est a menos pasos del origen.
+ */
+Sint32 Nearest(creNavMap * Map, Sint32 Goal)
+{
+    Sint32 Best = -1, c, h, BestH = 0;
+
+    for(c = 0; c < Map->W * Map->H; c++) {
+        if(Dist[c] == -1)
+            continue;
+        h = abs(c % Map->W - Goal % Map->W) + abs(c / Map->W - Goal / Map->W);
+        if(Best == -1 || h < BestH || (h == BestH && Dist[c] < Dist[Best])) {
+            Best = c;
+            BestH = h;
+        }
+    }
+
+    return Best;
+}
+
+
+/*
+ * TestPath
+ * Busca un camino con las opciones indicadas y comprueba su longitud, que
+ * cada paso sea a una casilla vecina libre y que acabe a EndH casillas del
+ * destino (puede haber varias casillas igual de cercanas).
+ */
+void TestPath(creNavSearch * Search, Sint32 FromX, Sint32 FromY, Sint32 ToX,
+    Sint32 ToY, Uint8 Flags, Sint32 Expected, Sint32 EndH)
+{
+    creNavMap * Map = Search->Map;
+    Sint32 Length, x = FromX, y = FromY, i;
+
+    Checks++;
+    Length = CRE_PathFind(Search, AGENT, FromX, FromY, ToX, ToY, Flags, Path,
+        MAP_MAX * MAP_MAX);
+    if(Length != Expected) {
+        Fail(Flags & CRE_PATH_PLAIN ? "A*" : "saltos", FromX, FromY, ToX, ToY,
+            Length, Expected);
+        return;
+    }
+
+    for(i = 0; i < Length; i++) {
+        if(abs(Path[i] % Map->W - x) + abs(Path[i] / Map->W - y) != 1 ||
+          !CRE_NavWalkable(Map, AGENT, Path[i] % Map->W, Path[i] / Map->W)) {
+            Fail("paso", FromX, FromY, ToX, ToY, i, -1);
+            return;
+        }
+        x = Path[i] % Map->W;
+        y = Path[i] / Map->W;
+    }
+    if(Length >= 0 && abs(x - ToX) + abs(y - ToY) != EndH)
+        Fail("final", FromX, FromY, ToX, ToY, abs(x - ToX) + abs(y - ToY),
+            EndH);
+}
+
+
+/*
+ * TestMap
+ * Busca caminos entre casillas libres al azar de un mapa, con y sin saltos
+ * y con y sin CRE_PATH_NEAREST.
+ */
+void TestMap(creNavMap * Map, Uint32 Count)
+{
+    creNavSearch * Search;
+    Sint32 FromX, FromY, ToX, ToY, Goal, Best, BestH;
+    Uint8 Plain;
+
+    Search = CRE_NewNavSearch(Map);
+    if(Search == NULL) {
+        fprintf(stderr, "No se ha podido crear la memoria de bsqueda\n");
+        exit(2);
+    }
+
+    while(Count-- > 0) {
+        FromX = TestRandom() % Map->W;
+        FromY = TestRandom() % Map->H;
+        ToX = TestRandom() % Map->W;
+        ToY = TestRandom() % Map->H;
+        if(!CRE_NavWalkable(Map, AGENT, FromX, FromY))
+            continue;
+
+        Distances(Map, FromX + FromY * Map->W);
+        Goal = ToX + ToY * Map->W;
+        Best = Nearest(Map, Goal);
+        BestH = abs(Best % Map->W - ToX) + abs(Best / Map->W - ToY);
+        for(Plain = 0; Plain <= CRE_PATH_PLAIN; Plain += CRE_PATH_PLAIN) {
+            TestPath(Search, FromX, FromY, ToX, ToY, Plain, Dist[Goal], 0);
+            TestPath(Search, FromX, FromY, ToX, ToY, Plain | CRE_PATH_NEAREST,
+                Dist[Best], BestH);
+        }
+    }
+
+    CRE_FreeNavSearch(Search);
+}
+
+
+/*
+ * TestCorridor
+ * Pasillo de 8x1 con un muro en x = 6. Sin camino a (7, 0), la casilla ms
+ * cercana es (5, 0), que no es un punto de salto.
+ */
+void TestCorridor(void)
+{
+    char Tiles[8] = {0, 0, 0, 0, 0, 0, 1, 0};
+    creNavSearch * Search;
+    creNavMap * Map;
+
+    Map = CRE_NewNavMap(8, 1, Tiles, Masks);
+    Search = CRE_NewNavSearch(Map);
+    if(Search == NULL) {
+        fprintf(stderr, "No se ha podido crear el pasillo\n");
+        exit(2);
+    }
+
+    TestPath(Search, 0, 0, 7, 0, 0, -1, 0);
+    TestPath(Search, 0, 0, 7, 0, CRE_PATH_NEAREST, 5, 2);
+    TestPath(Search, 0, 0, 7, 0, CRE_PATH_NEAREST | CRE_PATH_PLAIN, 5, 2);
+
+    CRE_FreeNavSearch(Search);
+    CRE_FreeNavMap(Map);
+}
+
+
+/*
+ * TestBatch
+ * Resuelve un lote de consultas al azar con un grupo sin hilos y con
+ * POOL_THREADS hilos. El resultado y el camino de cada consulta deben ser los
+ * de CRE_PathFind, y su longitud la de la bsqueda en anchura.
+ */
+void TestBatch(creNavMap * Map)
+{
+    creNavQuery Queries[BATCH], * q;
+    Sint32 Expected[BATCH];
+    creNavSearch * Search;
+    creNavPool * Pool;
+    Sint32 Threads, Goal, Length, i, j, n = 0;
+
+    Search = CRE_NewNavSearch(Map);
+    if(Search == NULL) {
+        fprintf(stderr, "No se ha podido crear la memoria de bsqueda\n");
+        exit(2);
+    }
+
+    /* Consultas desde casillas libres, con todas las combinaciones de
+       opciones */
+    for(i = 0; i < BATCH; i++) {
+        q = Queries + n;
+        q->FromX = TestRandom() % Map->W;
+        q->FromY = TestRandom() % Map->H;
+        q->ToX = TestRandom() % Map->W;
+        q->ToY = TestRandom() % Map->H;
+        if(!CRE_NavWalkable(Map, AGENT, q->FromX, q->FromY))
+            continue;
+        q->Agents = AGENT;
+        q->Flags = (n & 1 ? CRE_PATH_NEAREST : 0) |
+            (n & 2 ? CRE_PATH_PLAIN : 0);
+        q->Path = BatchPaths[n];
+        q->MaxPath = MAP_MAX * MAP_MAX;
+
+        Distances(Map, q->FromX + q->FromY * Map->W);
+        Goal = q->ToX + q->ToY * Map->W;
+        if(q->Flags & CRE_PATH_NEAREST)
+            Goal = Nearest(Map, Goal);
+        Expected[n++] = Dist[Goal];
+    }
+
+    for(Threads = 0; Threads <= POOL_THREADS; Threads += POOL_THREADS) {
+        Pool = CRE_NewNavPool(Map, Threads);
+        if(Pool == NULL) {
+            fprintf(stderr, "No se ha podido crear un grupo de %d hilos\n",
+                Threads);
+            exit(2);
+        }
+
+        for(i = 0; i < n; i++)
+            Queries[i].Result = -2;
+        CRE_PathFindBatch(Pool, Queries, n);
+
+        for(i = 0; i < n; i++) {
+            q = Queries + i;
+            Checks++;
+            Length = CRE_PathFind(Search, AGENT, q->FromX, q->FromY, q->ToX,
+                q->ToY, q->Flags, Path, MAP_MAX * MAP_MAX);
+            if(q->Result != Length || q->Result != Expected[i]) {
+                Fail(Threads ? "lote con hilos" : "lote", q->FromX, q->FromY,
+                    q->ToX, q->ToY, q->Result, Expected[i]);
+                continue;
+            }
+            for(j = 0; j < Length; j++)
+                if(q->Path[j] != Path[j]) {
+                    Fail("camino del lote", q->FromX, q->FromY, q->ToX,
+                        q->ToY, q->Path[j], Path[j]);
+                    break;
+                }
+        }
+
+        /* Con hilos, elimina tambin el grupo mientras esperan trabajo */
+        CRE_FreeNavPool(Pool);
+    }
+
+    CRE_FreeNavSearch(Search);
+}
+
+
+int main(int argc, char * argv[])
+{
+    char Tiles[MAP_MAX * MAP_MAX];
+    creNavMap * Map;
+    Sint32 W, H, i, m;
+
+    TestCorridor();
+
+    /* Mapas aleatorios con distintas densidades de muros */
+    for(m = 0; m < MAPS; m++) {
+        W = 1 + TestRandom() % MAP_MAX;
+        H = 1 + TestRandom() % MAP_MAX;
+        for(i = 0; i < W * H; i++)
+            Tiles[i] = TestRandom() % 100 < (Uint32) (m % 5) * 10;
+        Map = CRE_NewNavMap(W, H, Tiles, Masks);
+        if(Map == NULL) {
+            fprintf(stderr, "No se ha podido crear un mapa de %dx%d\n", W, H);
+            return 2;
+        }
+        TestMap(Map, PATHS);
+        TestBatch(Map);
+        CRE_FreeNavMap(Map);
+    }
+
+    printf("%u comprobaciones, %u fallos\n", Checks, Failures);
+    return Failures != 0;
+}
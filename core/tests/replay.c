@@ -0,0 +1,508 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file replay.c
+ * Prueba de la grabacin y reproduccin de partidas de replay.c. Graba, sin
+ * pantalla, una partida guiada por eventos guionizados y la reproduce: el
+ * reloj virtual, el estado del generador y el resultado de la partida deben
+ * ser los de la grabacin. Tambin reproduce una grabacin hecha a mano con
+ * un paso de ms de CRE_MAX_SIM_EVENTS eventos, cuyos eventos sobrantes se
+ * descartan. Devuelve 0 si no hay diferencias.
+ **/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include <zlib.h>
+#include "process.h"
+#include "replay.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Ficheros de las grabaciones de la prueba */
+#define RECORD_FILE "replaytest.rec"
+#define SKIP_FILE "replayskip.rec"
+
+/* Velocidad del bucle, pasos de la partida y semilla de la grabacin */
+#define FPS 50
+#define STEPS 3000
+#define SEED 0x1234567
+
+/* Eventos del paso largo de la grabacin hecha a mano y evento de salida
+   entre los que sobran */
+#define SKIP_EVENTS (CRE_MAX_SIM_EVENTS + 5)
+#define SKIP_QUIT (CRE_MAX_SIM_EVENTS + 2)
+
+/* Marca de fin de la grabacin (REPLAY_END en replay.c) */
+#define SKIP_END 0xFF
+
+/* Tipos de proceso de la prueba */
+#define TYPE_PLAYER 1
+#define TYPE_SPARK 2
+#define TYPE_PROBE 3
+
+
+/*
+ * Definicin de tipos
+ */
+
+/*
+ * Resultado de una partida: posicin final del jugador, chispas creadas y
+ * resumen de todo lo que han visto los procesos.
+ */
+typedef struct TestResult {
+    Sint32 X, Y;
+    Uint32 Sparks, Hash;
+} TestResult;
+
+/* Datos de una chispa: pasos que le quedan */
+typedef struct SparkData {
+    Uint32 Life;
+} SparkData;
+
+
+/*
+ * Declaracin de funciones
+ */
+
+creProcess * PPlayer_New();
+void PPlayer_Loop(creProcess * This);
+creProcess * PSpark_New(Sint32 X, Sint32 Y);
+void PSpark_Loop(creProcess * This);
+void PSpark_Free(creProcess * This);
+creProcess * PProbe_New();
+void PProbe_Loop(creProcess * This);
+void PTest_Free(creProcess * This);
+
+
+/*
+ * Variables globales al fichero
+ */
+
+/* Clases de proceso de la prueba */
+creProcess PPlayer = {0, TYPE_PLAYER, CRE_PS_CLASS, "Jugador", NULL,
+    PPlayer_New, PPlayer_Loop, PTest_Free, NULL, 0, 0, 0, 255, 0, 100, 100,
+    NULL};
+creProcess PSpark = {0, TYPE_SPARK, CRE_PS_CLASS, "Chispa", NULL, PSpark_New,
+    PSpark_Loop, PSpark_Free, NULL, 0, 0, 0, 255, 0, 100, 100, NULL};
+creProcess PProbe = {0, TYPE_PROBE, CRE_PS_CLASS, "Sonda", NULL, PProbe_New,
+    PProbe_Loop, PTest_Free, NULL, 0, 0, 0, 255, 0, 100, 100, NULL};
+
+/* Estado del generador del guion, que no usa el del core */
+Uint32 Seed = 0x2545F491;
+
+/* Pasos del guion ya entregados */
+Uint32 ScriptStep = 0;
+
+/* Resultado de la partida en marcha */
+TestResult Result;
+
+/* Pasos ejecutados por la sonda, y paso y tecla de cada pulsacin recibida */
+Uint32 ProbeSteps = 0, ProbeKeys = 0, ProbeQuits = 0;
+Uint32 KeyStep[SKIP_EVENTS + 1];
+SDLKey KeySym[SKIP_EVENTS + 1];
+
+/* Nmero de comprobaciones y de fallos */
+Uint32 Checks = 0, Failures = 0;
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * TestRandom
+ * Generador xorshift de 32 bits para el guion, de modo que los eventos no
+ * dependan del generador que se est probando.
+ */
+Uint32 TestRandom(void)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+
+    return Seed;
+}
+
+
+/*
+ * Check
+ * Cuenta una comprobacin y, si falla, la describe.
+ */
+void Check(const char * What, Uint32 Found, Uint32 Expected)
+{
+    Checks++;
+    if(Found == Expected)
+        return;
+    Failures++;
+    fprintf(stderr, "%s: da %u, se esperaba %u\n", What, Found, Expected);
+}
+
+
+/*
+ * Mix
+ * Aade un valor al resumen de la partida.
+ */
+void Mix(Uint32 Value)
+{
+    Result.Hash = (Result.Hash ^ Value) * 16777619;
+}
+
+
+/*
+ * PPlayer
+ * Se mueve con las flechas, crea chispas con el espacio y al azar, y acaba
+ * el bucle con el evento de salida. Resume todos los campos de los eventos
+ * de teclado y el reloj de cada paso.
+ */
+creProcess * PPlayer_New()
+{
+    creProcess * This;
+
+    This = CRE_AllocProcess(&PPlayer, 0);
+    This->State = CRE_PS_DEFAULT;
+    CRE_AddProcess(This);
+
+    return This;
+}
+
+void PPlayer_Loop(creProcess * This)
+{
+    SDL_Event * Event;
+    Uint32 i;
+
+    for(i = 0; i < creEList.Size; i++) {
+        Event = creEList.Events + i;
+        if(Event->type == SDL_QUIT) {
+            Mix(SDL_QUIT);
+            CRE_EndLoop();
+            return;
+        }
+        /* El resto de eventos no se graban, as que no cuentan */
+        if(Event->type != SDL_KEYDOWN && Event->type != SDL_KEYUP)
+            continue;
+        Mix(Event->type);
+        Mix(Event->key.state);
+        Mix(Event->key.keysym.scancode);
+        Mix(Event->key.keysym.sym);
+        Mix(Event->key.keysym.mod);
+        Mix(Event->key.keysym.unicode);
+        if(Event->type != SDL_KEYDOWN)
+            continue;
+        switch(Event->key.keysym.sym) {
+            case SDLK_LEFT:  This->X--; break;
+            case SDLK_RIGHT: This->X++; break;
+            case SDLK_UP:    This->Y--; break;
+            case SDLK_DOWN:  This->Y++; break;
+            case SDLK_SPACE: PSpark.New(This->X, This->Y); break;
+            default: break;
+        }
+    }
+
+    if(CRE_Random() % 16 == 0)
+        PSpark.New(This->X, This->Y);
+    Mix(CRE_GetTicks());
+    Result.X = This->X;
+    Result.Y = This->Y;
+}
+
+
+/*
+ * PSpark
+ * Se mueve al azar durante unos pasos tambin al azar.
+ */
+creProcess * PSpark_New(Sint32 X, Sint32 Y)
+{
+    creProcess * This;
+
+    This = CRE_AllocProcess(&PSpark, sizeof(SparkData));
+    This->State = CRE_PS_DEFAULT;
+    This->X = X;
+    This->Y = Y;
+    ((SparkData *) This->Data)->Life = 1 + CRE_Random() % 60;
+    CRE_AddProcess(This);
+    Result.Sparks++;
+
+    return This;
+}
+
+void PSpark_Loop(creProcess * This)
+{
+    SparkData * Info = (SparkData *) This->Data;
+
+    This->X += CRE_Random() % 3 - 1;
+    This->Y += CRE_Random() % 3 - 1;
+    if(--Info->Life == 0)
+        This->State = CRE_PS_DEAD;
+}
+
+void PSpark_Free(creProcess * This)
+{
+    Mix(This->X);
+    Mix(This->Y);
+    CRE_FreeProcess(This);
+}
+
+
+/*
+ * PProbe
+ * Anota el paso y la tecla de cada pulsacin que recibe.
+ */
+creProcess * PProbe_New()
+{
+    creProcess * This;
+
+    This = CRE_AllocProcess(&PProbe, 0);
+    This->State = CRE_PS_DEFAULT;
+    CRE_AddProcess(This);
+
+    return This;
+}
+
+void PProbe_Loop(creProcess * This)
+{
+    Uint32 i;
+
+    for(i = 0; i < creEList.Size; i++) {
+        if(creEList.Events[i].type == SDL_QUIT)
+            ProbeQuits++;
+        if(creEList.Events[i].type != SDL_KEYDOWN ||
+           ProbeKeys == SKIP_EVENTS + 1)
+            continue;
+        KeyStep[ProbeKeys] = ProbeSteps;
+        KeySym[ProbeKeys++] = creEList.Events[i].key.keysym.sym;
+    }
+    ProbeSteps++;
+}
+
+void PTest_Free(creProcess * This)
+{
+    CRE_FreeProcess(This);
+}
+
+
+/*
+ * Script
+ * Fuente de eventos de la grabacin. Algunos pasos tienen unas pocas teclas,
+ * otros llenan la lista y otros traen eventos que no se graban. El ltimo
+ * paso trae el evento de salida.
+ */
+Uint32 Script(SDL_Event * Events, Uint32 Max, void * Arg)
+{
+    static const SDLKey Keys[5] = {SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_DOWN,
+        SDLK_SPACE};
+    Uint32 Count, r, i;
+
+    memset(Events, 0, sizeof(SDL_Event) * Max);
+    if(++ScriptStep == STEPS) {
+        Events[0].type = SDL_QUIT;
+        return 1;
+    }
+
+    r = TestRandom();
+    if(r % 64 == 0)
+        Count = Max;
+    else if(r % 4 == 0)
+        Count = 1 + (r >> 8) % 3;
+    else
+        return 0;
+
+    for(i = 0; i < Count; i++) {
+        r = TestRandom();
+        if(r % 8 == 0) {
+            Events[i].type = SDL_MOUSEMOTION;
+            continue;
+        }
+        Events[i].type = r % 4 == 0 ? SDL_KEYUP : SDL_KEYDOWN;
+        Events[i].key.state = r % 4 == 0 ? SDL_RELEASED : SDL_PRESSED;
+        Events[i].key.keysym.scancode = (Uint8) (r >> 8);
+        Events[i].key.keysym.sym = Keys[(r >> 16) % 5];
+        Events[i].key.keysym.mod = (SDLMod) (TestRandom() & 0xFFFF);
+        Events[i].key.keysym.unicode = (Uint16) TestRandom();
+    }
+
+    return Count;
+}
+
+
+/*
+ * RunGame
+ * Juega una partida hasta que acaba el bucle y devuelve su resultado.
+ */
+void RunGame(TestResult * Out)
+{
+    memset(&Result, 0, sizeof(TestResult));
+    PPlayer.New();
+    CRE_StartLoop();
+    *Out = Result;
+}
+
+
+/*
+ * TestReplay
+ * Graba una partida guionizada y la reproduce desde otro reloj y otra
+ * semilla.
+ */
+void TestReplay(void)
+{
+    TestResult Recorded, Replayed;
+    Uint32 Ticks, Random;
+
+    CRE_SetTicks(1000);
+    if(CRE_StartRecord(RECORD_FILE, SEED) != 0) {
+        fprintf(stderr, "No se ha podido grabar en %s\n", RECORD_FILE);
+        exit(2);
+    }
+    CRE_SetEventSource(Script, NULL);
+    RunGame(&Recorded);
+    CRE_SetEventSource(NULL, NULL);
+    CRE_StopRecord();
+    Ticks = CRE_GetTicks();
+    Random = CRE_WorldReplay()->Random;
+
+    CRE_SetTicks(777777);
+    CRE_SeedRandom(~SEED);
+    if(CRE_StartReplay(RECORD_FILE, 0) != 0) {
+        fprintf(stderr, "No se ha podido reproducir %s\n", RECORD_FILE);
+        exit(2);
+    }
+    RunGame(&Replayed);
+
+    /* La partida acaba con su evento de salida, antes que la grabacin */
+    Check("reproduciendo al salir", CRE_IsReplaying(), 1);
+    CRE_StopReplay();
+
+    Check("reloj", CRE_GetTicks(), Ticks);
+    Check("generador", CRE_WorldReplay()->Random, Random);
+    Check("x", (Uint32) Replayed.X, (Uint32) Recorded.X);
+    Check("y", (Uint32) Replayed.Y, (Uint32) Recorded.Y);
+    Check("chispas", Replayed.Sparks, Recorded.Sparks);
+    Check("resumen", Replayed.Hash, Recorded.Hash);
+    Check("pasos del guion", ScriptStep, STEPS);
+
+    remove(RECORD_FILE);
+}
+
+
+/*
+ * SkipPut
+ * Escribe un entero sin signo en little endian, como en replay.c.
+ */
+void SkipPut(gzFile File, Uint32 Value, Uint8 Bytes)
+{
+    while(Bytes-- > 0) {
+        gzputc(File, Value & 0xFF);
+        Value >>= 8;
+    }
+}
+
+
+/*
+ * SkipKey
+ * Escribe una pulsacin de tecla con el formato de la grabacin.
+ */
+void SkipKey(gzFile File, SDLKey Sym)
+{
+    gzputc(File, SDL_KEYDOWN);
+    SkipPut(File, Sym, 1);
+    SkipPut(File, Sym, 2);
+    SkipPut(File, 0, 2);
+    SkipPut(File, Sym, 2);
+}
+
+
+/*
+ * TestSkip
+ * Reproduce una grabacin con SKIP_EVENTS eventos en el paso 2 y una tecla en
+ * el paso 5. Llegan los CRE_MAX_SIM_EVENTS primeros; los dems, tanto teclas
+ * (7 bytes) como la salida (ninguno), se descartan sin desordenar el resto.
+ */
+void TestSkip(void)
+{
+    gzFile File;
+    Uint32 i;
+
+    File = gzopen(SKIP_FILE, "wb");
+    if(File == NULL) {
+        fprintf(stderr, "No se ha podido crear %s\n", SKIP_FILE);
+        exit(2);
+    }
+    gzwrite(File, CRE_REPLAY_MAGIC, 4);
+    gzputc(File, CRE_REPLAY_VERSION);
+    SkipPut(File, SEED, 4);
+    SkipPut(File, 0, 4);
+    SkipPut(File, (Uint32) CRE_GetStepTime(), 4);
+    gzputc(File, 2);
+    gzputc(File, SKIP_EVENTS);
+    for(i = 0; i < SKIP_EVENTS; i++)
+        if(i == SKIP_QUIT)
+            gzputc(File, SDL_QUIT);
+        else
+            SkipKey(File, (SDLKey) (SDLK_a + i));
+    gzputc(File, 3);
+    gzputc(File, 1);
+    SkipKey(File, SDLK_z);
+    gzputc(File, 1);
+    gzputc(File, SKIP_END);
+    gzclose(File);
+
+    if(CRE_StartReplay(SKIP_FILE, 0) != 0) {
+        fprintf(stderr, "No se ha podido reproducir %s\n", SKIP_FILE);
+        exit(2);
+    }
+    PProbe.New();
+    CRE_StartLoop();
+
+    /* Sin pantalla, el fin de la grabacin acaba el bucle en el paso 6 */
+    Check("reproduciendo al acabar", CRE_IsReplaying(), 0);
+    Check("pasos", ProbeSteps, 6);
+    Check("salidas", ProbeQuits, 0);
+    Check("teclas", ProbeKeys, CRE_MAX_SIM_EVENTS + 1);
+    for(i = 0; i < ProbeKeys && i < CRE_MAX_SIM_EVENTS; i++) {
+        Check("paso de tecla", KeyStep[i], 2);
+        Check("tecla", KeySym[i], SDLK_a + i);
+    }
+    if(ProbeKeys == CRE_MAX_SIM_EVENTS + 1) {
+        Check("paso de la ltima tecla", KeyStep[i], 5);
+        Check("ltima tecla", KeySym[i], SDLK_z);
+    }
+
+    remove(SKIP_FILE);
+}
+
+
+int main(int argc, char * argv[])
+{
+    CRE_SetHeadless(1);
+    CRE_SetFPS(FPS);
+    CRE_SetTimestep(CRE_TIMESTEP_FIXED);
+
+    TestReplay();
+    TestSkip();
+
+    printf("%u comprobaciones, %u fallos\n", Checks, Failures);
+    return Failures != 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * core - Minimalist games engine
+ * Copyright (C) 2006 lvaro Vilanova Vidal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/**
+ * @file simd.c
+ * Prueba de regresin de los kernels SIMD de gfx.c. Todos los juegos de
+ * instrucciones deben dar exactamente el mismo resultado que los kernels en
+ * C, por lo que se comparan byte a byte con ellos. Devuelve 0 si no hay
+ * diferencias.
+ **/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include "gfx.h"
+
+
+/*
+ * Definicin de macros
+ */
+
+/* Tamaos de los grficos que se transforman */
+#define SIZE_MIN 2
+#define SIZE_MAX 37
+
+/* Paso en grados entre los ngulos de rotacin */
+#define ANGLE_STEP 17.3
+
+/* Nmero de niveles de zoom */
+#define ZOOMS 6
+
+/* Longitud mxima de las filas que se mezclan */
+#define ROW_MAX 67
+
+/* Nmero de valores de alpha global */
+#define ALPHAS 6
+
+
+/*
+ * Variables globales al fichero
+ */
+
+/* Niveles de zoom que se prueban, en X y en Y */
+double Zooms[ZOOMS] = {0.5, 0.75, 1.0, 1.5, 2.0, 3.0};
+
+/* Valores de alpha global que se prueban */
+Uint8 Alphas[ALPHAS] = {0, 1, 77, 128, 254, 255};
+
+/*
+ * Posicin del alpha y bits del destino que no son de color: ARGB con el
+ * alpha arriba y RGBA con el alpha abajo
+ */
+Uint32 Ashifts[2] = {24, 0};
+Uint32 Keeps[2] = {0xFF000000, 0x000000FF};
+
+/* Estado del generador de nmeros aleatorios de la prueba */
+Uint32 Seed = 0x2545F491;
+
+/* Nmero de comprobaciones y de fallos */
+Uint32 Checks = 0, Failures = 0;
+
+
+/*
+ * Implementacin de funciones
+ */
+
+/*
+ * TestRandom
+ * Generador xorshift de 32 bits, para que la prueba no dependa de la
+ * biblioteca de C.
+ */
+Uint32 TestRandom(void)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+
+    return Seed;
+}
+
+
+/*
+ * TestPixel
+ * Pixel aleatorio. Uno de cada cuatro es opaco y otro transparente, ya que
+ * los kernels los tratan aparte.
+ */
+Uint32 TestPixel(void)
+{
+    Uint32 Pixel = TestRandom();
+
+    switch(Pixel & 3) {
+        case 0: return Pixel | 0xFF000000;
+        case 1: return Pixel & 0x00FFFFFF;
+        default: return Pixel;
+    }
+}
+
+
+/*
+ * NewSprite
+ * Crea un grfico RGBA de 32 bits con pixels aleatorios.
+ */
+SDL_Surface * NewSprite(int W, int H)
+{
+    SDL_Surface * Sprite;
+    Uint32 * Row;
+    int x, y;
+
+    Sprite = SDL_CreateRGBSurface(SDL_SWSURFACE, W, H, 32, 0x00FF0000,
+        0x0000FF00, 0x000000FF, 0xFF000000);
+    if(Sprite == NULL) {
+        fprintf(stderr, "No se ha podido crear un grfico de %dx%d\n", W, H);
+        exit(2);
+    }
+
+    for(y = 0; y < H; y++) {
+        Row = (Uint32 *) ((Uint8 *) Sprite->pixels + y * Sprite->pitch);
+        for(x = 0; x < W; x++)
+            Row[x] = TestPixel();
+    }
+
+    return Sprite;
+}
+
+
+/*
+ * SameSurface
+ * Indica si dos grficos tienen el mismo tamao y los mismos pixels.
+ */
+int SameSurface(SDL_Surface * A, SDL_Surface * B)
+{
+    int y;
+
+    if(A == NULL || B == NULL)
+        return A == B;
+    if(A->w != B->w || A->h != B->h)
+        return 0;
+
+    for(y = 0; y < A->h; y++)
+        if(memcmp((Uint8 *) A->pixels + y * A->pitch,
+          (Uint8 *) B->pixels + y * B->pitch, A->w * 4) != 0)
+            return 0;
+
+    return 1;
+}
+
+
+/*
+ * TestBlend
+ * Compara los kernels de mezcla del juego de instrucciones indicado con los
+ * kernels en C, con filas de todas las longitudes hasta ROW_MAX para probar
+ * tambin los pixels sobrantes y filas que no empiezan alineadas.
+ */
+void TestBlend(int Level)
+{
+    Uint32 Src[ROW_MAX + 3], Dst[ROW_MAX + 3], Expected[ROW_MAX + 3],
+        Result[ROW_MAX + 3];
+    Uint8 Mode;
+    int Count, Offset, a, f, i;
+
+    for(Count = 0; Count <= ROW_MAX; Count++)
+        for(Offset = 0; Offset < 3; Offset++)
+            for(Mode = CRE_GFX_BLEND_OVER; Mode <= CRE_GFX_BLEND_ADD; Mode++)
+                for(a = 0; a < ALPHAS; a++)
+                    for(f = 0; f < 2; f++) {
+                        for(i = 0; i < ROW_MAX + 3; i++) {
+                            Src[i] = TestPixel();
+                            Dst[i] = TestRandom();
+                        }
+                        /* El alpha del origen en la posicin del formato */
+                        if(Ashifts[f] == 0)
+                            for(i = 0; i < ROW_MAX + 3; i++)
+                                Src[i] = (Src[i] << 8) | (Src[i] >> 24);
+
+                        memcpy(Expected, Dst, sizeof(Dst));
+                        memcpy(Result, Dst, sizeof(Dst));
+                        CRE_GfxSetSIMD(CRE_GFX_SIMD_NONE);
+                        CRE_GfxBlendRow(Expected + Offset, Src + 2 - Offset,
+                            Count, Alphas[a], Mode, Ashifts[f], Keeps[f]);
+                        CRE_GfxSetSIMD(Level);
+                        CRE_GfxBlendRow(Result + Offset, Src + 2 - Offset,
+                            Count, Alphas[a], Mode, Ashifts[f], Keeps[f]);
+
+                        Checks++;
+                        if(memcmp(Expected, Result, sizeof(Dst)) != 0) {
+                            Failures++;
+                            fprintf(stderr, "mezcla %d: modo %d, %d pixels, "
+                                "alpha %d, ashift %u\n", Level, Mode, Count,
+                                Alphas[a], Ashifts[f]);
+                        }
+                    }
+}
+
+
+/*
+ * TestRotozoom
+ * Compara el zoom y la rotacin con suavizado del juego de instrucciones
+ * indicado con los de los kernels en C.
+ */
+void TestRotozoom(int Level)
+{
+    SDL_Surface * Sprite, * Expected, * Result;
+    double Angle;
+    int Size, z;
+
+    for(Size = SIZE_MIN; Size <= SIZE_MAX; Size++) {
+        Sprite = NewSprite(Size, Size + (Size & 3));
+        for(Angle = 0; Angle < 360; Angle += ANGLE_STEP)
+            for(z = 0; z < ZOOMS * ZOOMS; z++) {
+                CRE_GfxSetSIMD(CRE_GFX_SIMD_NONE);
+                Expected = CRE_GfxRZSurfaceXY(Sprite, Angle, Zooms[z % ZOOMS],
+                    Zooms[z / ZOOMS], CRE_GFX_SMOOTH_ON);
+                CRE_GfxSetSIMD(Level);
+                Result = CRE_GfxRZSurfaceXY(Sprite, Angle, Zooms[z % ZOOMS],
+                    Zooms[z / ZOOMS], CRE_GFX_SMOOTH_ON);
+
+                Checks++;
+                if(!SameSurface(Expected, Result)) {
+                    Failures++;
+                    fprintf(stderr, "rotozoom %d: %dx%d, %.1f grados, "
+                        "zoom %.2fx%.2f\n", Level, Sprite->w, Sprite->h,
+                        Angle, Zooms[z % ZOOMS], Zooms[z / ZOOMS]);
+                }
+                if(Expected != NULL)
+                    SDL_FreeSurface(Expected);
+                if(Result != NULL)
+                    SDL_FreeSurface(Result);
+            }
+        SDL_FreeSurface(Sprite);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    int Level;
+
+    /* Probamos cada juego de instrucciones que soporte la CPU */
+    for(Level = CRE_GFX_SIMD_SSE2; Level <= CRE_GFX_SIMD_AVX2; Level++) {
+        if(CRE_GfxSetSIMD(Level) != Level) {
+            printf("simd %d: no soportado por la CPU\n", Level);
+            continue;
+        }
+        TestBlend(Level);
+        TestRotozoom(Level);
+        printf("simd %d: probado\n", Level);
+    }
+
+    printf("%u comprobaciones, %u fallos\n", Checks, Failures);
+    return Failures != 0;
+}